@@ -2,12 +2,39 @@
 #include "../Model/plant.h"
 #include "../Repository/plant_repository.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Heap bytes owned by a string; 0 while it fits in the inline buffer
+inline size_t stringHeapBytes(const string &text) {
+    const char *data = text.data();
+    bool small = data >= reinterpret_cast<const char*>(&text) && data < reinterpret_cast<const char*>(&text + 1);
+    return small ? 0 : text.capacity() + 1;
+}
+
+// Heap bytes owned by a plant (its name and species buffers)
+inline size_t plantHeapBytes(const Plant &plant) {
+    return stringHeapBytes(plant.getName()) + stringHeapBytes(plant.getSpecies());
+}
+
 // Abstract base class for Command pattern
 class Command {
 public:
     virtual void execute() = 0; // Executes the command
     virtual void undo() = 0; // Undoes the command
 
+    // Approximate bytes held by the command, for the undo history budget
+    virtual size_t memoryUsage() const = 0;
+
+    // Folds a command executed right after this one into it, so that one undo
+    // reverts both; false (and no change) if the two cannot be combined
+    virtual bool absorb(const Command &) { return false; }
+
     virtual ~Command() = default; // Destructor
 };
 
@@ -26,6 +53,9 @@ public:
     // Undoes the addition by removing the plant
     void undo() override { repository->removePlant(plant.getName()); }
 
+    // The command and its plant copy
+    size_t memoryUsage() const override { return sizeof(*this) + plantHeapBytes(plant); }
+
     // Destructor
     ~AddPlantCommand() override = default;
 };
@@ -45,26 +75,179 @@ public:
     // Undoes the removal by re-adding the plant
     void undo() override { repository->addPlant(plant); }
 
+    // The command and its plant copy
+    size_t memoryUsage() const override { return sizeof(*this) + plantHeapBytes(plant); }
+
     // Destructor
     ~RemovePlantCommand() override = default;
 };
 
-// Command for updating a plant
+// Command for updating a plant. Only the fields that changed are stored
+// (species only when it changed, behind a pointer), and both directions
+// rewrite just those fields of the stored plant.
 class UpdatePlantCommand : public Command {
+public:
+    enum Field : uint8_t { Species = 1, Quantity = 2, Price = 4 };
+
+private:
+    struct SpeciesChange {
+        string oldSpecies;
+        string newSpecies;
+    };
+
     PlantRepository* repository;
-    Plant oldPlant;
-    Plant newPlant;
+    string name;
+    unique_ptr<SpeciesChange> species;
+    int oldQuantity = 0;
+    int newQuantity = 0;
+    double oldPrice = 0;
+    double newPrice = 0;
+    uint8_t changed = 0;
+
+    // Rewrites the changed fields of the stored plant with the old or new values
+    void apply(bool forward) {
+        Plant current = repository->getPlantByName(name);
+        repository->updatePlant(Plant(name,
+            (changed & Species) ? (forward ? species->newSpecies : species->oldSpecies) : current.getSpecies(),
+            (changed & Quantity) ? (forward ? newQuantity : oldQuantity) : current.getQuantity(),
+            (changed & Price) ? (forward ? newPrice : oldPrice) : current.getPrice()));
+    }
+
 public:
-    // Constructor
+    // Constructor; keeps the difference between the two versions of the plant
     UpdatePlantCommand(PlantRepository* repository, const Plant &oldPlant, const Plant &newPlant)
-        : repository(repository), oldPlant(oldPlant), newPlant(newPlant) {}
+        : repository(repository), name(newPlant.getName()) {
+        if (oldPlant.getSpecies() != newPlant.getSpecies()) {
+            species = make_unique<SpeciesChange>(SpeciesChange{oldPlant.getSpecies(), newPlant.getSpecies()});
+            changed |= Species;
+        }
+        if (oldPlant.getQuantity() != newPlant.getQuantity()) {
+            oldQuantity = oldPlant.getQuantity();
+            newQuantity = newPlant.getQuantity();
+            changed |= Quantity;
+        }
+        // != is also true for NaN, so a NaN price is always restored
+        if (oldPlant.getPrice() != newPlant.getPrice()) {
+            oldPrice = oldPlant.getPrice();
+            newPrice = newPlant.getPrice();
+            changed |= Price;
+        }
+    }
+
+    // Executes the updating (applies the new field values)
+    void execute() override { apply(true); }
+
+    // Undoes the updating (restores the old field values)
+    void undo() override { apply(false); }
+
+    // Fields that differ between the old and new version (Field bits)
+    uint8_t changedFields() const { return changed; }
+
+    // The command, the name and the species pair if one is stored
+    size_t memoryUsage() const override {
+        size_t bytes = sizeof(*this) + stringHeapBytes(name);
+        if (species)
+            bytes += sizeof(SpeciesChange) + stringHeapBytes(species->oldSpecies) + stringHeapBytes(species->newSpecies);
+        return bytes;
+    }
 
-    // Executes the updating (applies newPlant)
-    void execute() override { repository->updatePlant(newPlant); }
+    // Merges a later update of the same plant: its new values win, the old
+    // values of this command stay
+    bool absorb(const Command &next) override {
+        auto *update = dynamic_cast<const UpdatePlantCommand*>(&next);
+        if (!update || update->name != name) return false;
 
-    // Undoes the updating (restores oldPlant)
-    void undo() override { repository->updatePlant(oldPlant); }
+        if (update->changed & Species) {
+            if (species) species->newSpecies = update->species->newSpecies;
+            else species = make_unique<SpeciesChange>(*update->species);
+            changed |= Species;
+        }
+        if (update->changed & Quantity) {
+            if (!(changed & Quantity)) oldQuantity = update->oldQuantity;
+            newQuantity = update->newQuantity;
+            changed |= Quantity;
+        }
+        if (update->changed & Price) {
+            if (!(changed & Price)) oldPrice = update->oldPrice;
+            newPrice = update->newPrice;
+            changed |= Price;
+        }
+        return true;
+    }
 
     // Destructor
     ~UpdatePlantCommand() override = default;
 };
+
+// Command made of several commands that act as one: execute runs them in
+// order and undo in reverse order. If one of them fails, the ones already
+// applied in that pass are reverted before the error is rethrown.
+class CompositeCommand : public Command {
+    vector<unique_ptr<Command>> commands;
+public:
+    // Appends a command that has already been executed
+    void append(unique_ptr<Command> command) { commands.push_back(move(command)); }
+
+    // Number of commands
+    size_t size() const { return commands.size(); }
+
+    // Executes the commands in order
+    void execute() override {
+        size_t done = 0;
+        try {
+            for (; done < commands.size(); ++done) commands[done]->execute();
+        } catch (...) {
+            while (done > 0) commands[--done]->undo();
+            throw;
+        }
+    }
+
+    // Undoes the commands in reverse order
+    void undo() override {
+        size_t remaining = commands.size();
+        try {
+            for (; remaining > 0; --remaining) commands[remaining - 1]->undo();
+        } catch (...) {
+            for (; remaining < commands.size(); ++remaining) commands[remaining]->execute();
+            throw;
+        }
+    }
+
+    // The command, its pointer array and every part
+    size_t memoryUsage() const override {
+        size_t bytes = sizeof(*this) + commands.capacity() * sizeof(unique_ptr<Command>);
+        for (const auto &command : commands) bytes += command->memoryUsage();
+        return bytes;
+    }
+
+    // Destructor
+    ~CompositeCommand() override = default;
+};
+
+// One operation of a bulk edit (see PlantController::applyEdits)
+struct PlantEdit {
+    enum class Kind { Add, Update, Remove };
+
+    Kind kind;
+    Plant plant; // Remove only uses the name
+
+    static PlantEdit add(Plant plant) { return {Kind::Add, move(plant)}; }
+    static PlantEdit update(Plant plant) { return {Kind::Update, move(plant)}; }
+    static PlantEdit remove(const string &name) { return {Kind::Remove, Plant(name, "", 0, 0)}; }
+};
+
+// Bounds of the controller's undo history; the oldest entries are dropped
+// first when either bound is exceeded
+struct UndoHistoryLimits {
+    size_t maxEntries = 1000;
+    size_t maxBytes = 4 << 20;
+    // Consecutive updates of the same plant share one undo entry
+    bool coalesceUpdates = true;
+};
+
+// Current size of the undo history, for monitoring
+struct UndoHistoryUsage {
+    size_t undoEntries = 0;
+    size_t redoEntries = 0;
+    size_t bytes = 0; // memoryUsage of all undo and redo entries
+};
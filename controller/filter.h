@@ -3,16 +3,30 @@
 
 #include <string>
 #include <memory>
+#include <sstream>
 #include <vector>
 
 using namespace std;
 
-// Abstract base class for plant filters
+// Abstract base class for plant filters.
+// matches() may be called from several threads at once (parallel scans, see
+// PlantController::enableParallelScans), so it must not modify shared state.
+// The filters below only read their own const members and the plant.
 class PlantFilter {
 public:
     // Checks if the given plant matches the filter criteria
     virtual bool matches(const Plant &plant) const = 0;
 
+    // Returns a short description of the criteria, used by query plans
+    virtual string describe() const { return "custom filter"; }
+
+    // Describes filters joined by separator, in parentheses
+    static string join(const vector<shared_ptr<PlantFilter>> &filters, const string &separator) {
+        string text = "(";
+        for (size_t i = 0; i < filters.size(); ++i) text += (i ? separator : "") + filters[i]->describe();
+        return text + ")";
+    }
+
     virtual ~PlantFilter() = default; // Destructor
 };
 
@@ -24,10 +38,20 @@ private:
 public:
     PricePlantFilter(double min, double max) : minPrice(min), maxPrice(max) {}
 
+    // Returns the bounds of the range
+    double getMinPrice() const { return minPrice; }
+    double getMaxPrice() const { return maxPrice; }
+
     // Returns true if plant price is within the range [minPrice, maxPrice]
     bool matches(const Plant &plant) const override {
         return plant.getPrice() >= minPrice && plant.getPrice() <= maxPrice;
     }
+
+    string describe() const override {
+        ostringstream out;
+        out << "price in [" << minPrice << ", " << maxPrice << "]";
+        return out.str();
+    }
 };
 
 // Filter for substring match in plant name
@@ -41,6 +65,11 @@ public:
     bool matches(const Plant &plant) const override {
         return plant.getName().find(substring) != string::npos;
     }
+
+    // Returns the substring
+    const string &getSubstring() const { return substring; }
+
+    string describe() const override { return "name contains \"" + substring + "\""; }
 };
 
 // Filter for exact species
@@ -50,10 +79,15 @@ private:
 public:
     explicit SpeciesPlantFilter(const string &species) : species(species) {}
 
+    // Returns the species this filter selects
+    const string &getSpecies() const { return species; }
+
     // Returns true if the plant's species matches the filter species
     bool matches(const Plant &plant) const override {
         return plant.getSpecies() == species;
     }
+
+    string describe() const override { return "species = \"" + species + "\""; }
 };
 
 // Filter for stock availability (in stock / out of stock)
@@ -67,6 +101,11 @@ public:
     bool matches(const Plant &plant) const override {
         return (plant.getQuantity() > 0) == shouldBeInStock;
     }
+
+    // Returns true if the filter selects plants in stock
+    bool getShouldBeInStock() const { return shouldBeInStock; }
+
+    string describe() const override { return shouldBeInStock ? "in stock" : "out of stock"; }
 };
 
 // Filter for minimum quantity
@@ -76,10 +115,15 @@ private:
 public:
     explicit MinQuantityPlantFilter(int minQuantity) : minQuantity(minQuantity) {}
 
+    // Returns the minimum quantity
+    int getMinQuantity() const { return minQuantity; }
+
     // Returns true if the plant's quantity is at least minQuantity
     bool matches(const Plant &plant) const override {
         return plant.getQuantity() >= minQuantity;
     }
+
+    string describe() const override { return "quantity >= " + to_string(minQuantity); }
 };
 
 // Composite filter for logical AND of multiple filters
@@ -96,6 +140,11 @@ public:
             if (!filter->matches(plant)) return false;
         return true;
     }
+
+    // Returns the subfilters
+    const vector<shared_ptr<PlantFilter>> &getFilters() const { return filters; }
+
+    string describe() const override { return join(filters, " AND "); }
 };
 
 // Composite filter for logical OR of multiple filters
@@ -112,4 +161,9 @@ public:
             if (filter->matches(plant)) return true;
         return false;
     }
+
+    // Returns the subfilters
+    const vector<shared_ptr<PlantFilter>> &getFilters() const { return filters; }
+
+    string describe() const override { return join(filters, " OR "); }
 };
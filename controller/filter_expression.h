@@ -0,0 +1,174 @@
+#pragma once
+#include "../Model/plant.h"
+#include "filter.h"
+
+#include <concepts>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+// Compile-time filters: the same criteria as filter.h, composed with &&, ||
+// and ! into one value type whose call operator the compiler can inline, e.g.
+//
+//     controller.filterPlants(priceBetween(5, 20) && speciesIs("Succulent") && !outOfStock());
+//
+// No allocation and no virtual call per plant or per child. The runtime
+// PlantFilter hierarchy stays for filters built at run time (UI, planner).
+
+// Marker base of every expression type
+struct FilterExpressionBase {};
+
+template <typename T>
+concept FilterExpression = derived_from<T, FilterExpressionBase>;
+
+// Price within [minPrice, maxPrice], as PricePlantFilter
+class PriceBetween : public FilterExpressionBase {
+private:
+    double minPrice;
+    double maxPrice;
+public:
+    PriceBetween(double minPrice, double maxPrice) : minPrice(minPrice), maxPrice(maxPrice) {}
+
+    bool operator()(const Plant &plant) const { return plant.getPrice() >= minPrice && plant.getPrice() <= maxPrice; }
+
+    string describe() const {
+        ostringstream out;
+        out << "price in [" << minPrice << ", " << maxPrice << "]";
+        return out.str();
+    }
+};
+
+// Exact species, as SpeciesPlantFilter
+class SpeciesIs : public FilterExpressionBase {
+private:
+    string species;
+public:
+    explicit SpeciesIs(string species) : species(move(species)) {}
+
+    bool operator()(const Plant &plant) const { return plant.getSpecies() == species; }
+
+    string describe() const { return "species = \"" + species + "\""; }
+};
+
+// Name substring, as NamePlantFilter
+class NameContains : public FilterExpressionBase {
+private:
+    string substring;
+public:
+    explicit NameContains(string substring) : substring(move(substring)) {}
+
+    bool operator()(const Plant &plant) const { return plant.getName().find(substring) != string::npos; }
+
+    string describe() const { return "name contains \"" + substring + "\""; }
+};
+
+// Stock availability, as StockAvailabilityPlantFilter
+class StockIs : public FilterExpressionBase {
+private:
+    bool shouldBeInStock;
+public:
+    explicit StockIs(bool shouldBeInStock) : shouldBeInStock(shouldBeInStock) {}
+
+    bool operator()(const Plant &plant) const { return (plant.getQuantity() > 0) == shouldBeInStock; }
+
+    string describe() const { return shouldBeInStock ? "in stock" : "out of stock"; }
+};
+
+// Minimum quantity, as MinQuantityPlantFilter
+class QuantityAtLeast : public FilterExpressionBase {
+private:
+    int minQuantity;
+public:
+    explicit QuantityAtLeast(int minQuantity) : minQuantity(minQuantity) {}
+
+    bool operator()(const Plant &plant) const { return plant.getQuantity() >= minQuantity; }
+
+    string describe() const { return "quantity >= " + to_string(minQuantity); }
+};
+
+// Both sides match; the right side is only evaluated when the left matches
+template <FilterExpression Left, FilterExpression Right>
+class AndExpression : public FilterExpressionBase {
+private:
+    Left left;
+    Right right;
+public:
+    AndExpression(Left left, Right right) : left(move(left)), right(move(right)) {}
+
+    bool operator()(const Plant &plant) const { return left(plant) && right(plant); }
+
+    string describe() const { return "(" + left.describe() + " AND " + right.describe() + ")"; }
+};
+
+// Either side matches; the right side is only evaluated when the left does not
+template <FilterExpression Left, FilterExpression Right>
+class OrExpression : public FilterExpressionBase {
+private:
+    Left left;
+    Right right;
+public:
+    OrExpression(Left left, Right right) : left(move(left)), right(move(right)) {}
+
+    bool operator()(const Plant &plant) const { return left(plant) || right(plant); }
+
+    string describe() const { return "(" + left.describe() + " OR " + right.describe() + ")"; }
+};
+
+// The operand does not match
+template <FilterExpression Operand>
+class NotExpression : public FilterExpressionBase {
+private:
+    Operand operand;
+public:
+    explicit NotExpression(Operand operand) : operand(move(operand)) {}
+
+    bool operator()(const Plant &plant) const { return !operand(plant); }
+
+    string describe() const { return "NOT " + operand.describe(); }
+};
+
+// Builders for the leaves
+inline PriceBetween priceBetween(double minPrice, double maxPrice) { return PriceBetween(minPrice, maxPrice); }
+inline SpeciesIs speciesIs(string species) { return SpeciesIs(move(species)); }
+inline NameContains nameContains(string substring) { return NameContains(move(substring)); }
+inline StockIs inStock() { return StockIs(true); }
+inline StockIs outOfStock() { return StockIs(false); }
+inline QuantityAtLeast quantityAtLeast(int minQuantity) { return QuantityAtLeast(minQuantity); }
+
+// Composition operators
+template <FilterExpression Left, FilterExpression Right>
+AndExpression<Left, Right> operator&&(Left left, Right right) {
+    return AndExpression<Left, Right>(move(left), move(right));
+}
+
+template <FilterExpression Left, FilterExpression Right>
+OrExpression<Left, Right> operator||(Left left, Right right) {
+    return OrExpression<Left, Right>(move(left), move(right));
+}
+
+template <FilterExpression Operand>
+NotExpression<Operand> operator!(Operand operand) {
+    return NotExpression<Operand>(move(operand));
+}
+
+// Runtime PlantFilter around an expression, for code that takes shared_ptr<PlantFilter>.
+// The planner sees it as a custom filter, so it is always checked by a scan.
+template <FilterExpression Expression>
+class ExpressionPlantFilter : public PlantFilter {
+private:
+    Expression expression;
+public:
+    explicit ExpressionPlantFilter(Expression expression) : expression(move(expression)) {}
+
+    bool matches(const Plant &plant) const override { return expression(plant); }
+
+    string describe() const override { return expression.describe(); }
+};
+
+// Wraps an expression into a shared PlantFilter
+template <FilterExpression Expression>
+shared_ptr<PlantFilter> toPlantFilter(Expression expression) {
+    return make_shared<ExpressionPlantFilter<Expression>>(move(expression));
+}
@@ -0,0 +1,270 @@
+#include "filter_planner.h"
+#include "parallel_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+// Guessed fraction of plants matched by filters no index can estimate
+static constexpr double broadSelectivity = 0.5;
+static constexpr double shortNameSelectivity = 0.25;
+
+// Relative costs of checking one plant
+static constexpr double numberCost = 1;
+static constexpr double speciesCost = 2;
+static constexpr double nameCost = 4;
+static constexpr double customCost = 8;
+
+// Estimates rows, cost and index support of one filter
+FilterPlan::Step FilterPlanner::analyze(const shared_ptr<PlantFilter> &filter) const {
+    FilterPlan::Step step;
+    step.filter = filter;
+    size_t cap = candidateLimit() + 1;
+
+    // A range counted up to the cap is exact below it and only known to be broad above
+    auto range = [&](size_t count) {
+        step.indexed = true;
+        step.estimatedRows = count < cap ? count : max<double>(count, plantCount * broadSelectivity);
+        step.cost = numberCost;
+    };
+
+    if (auto species = dynamic_cast<const SpeciesPlantFilter *>(filter.get())) {
+        step.indexed = true;
+        step.estimatedRows = index.countBySpecies(species->getSpecies());
+        step.cost = speciesCost;
+    } else if (auto price = dynamic_cast<const PricePlantFilter *>(filter.get())) {
+        range(index.countInPriceRange(price->getMinPrice(), price->getMaxPrice(), cap));
+    } else if (auto quantity = dynamic_cast<const MinQuantityPlantFilter *>(filter.get())) {
+        range(index.countInQuantityRange(quantity->getMinQuantity(), numeric_limits<int>::max(), cap));
+    } else if (auto stock = dynamic_cast<const StockAvailabilityPlantFilter *>(filter.get())) {
+        range(stock->getShouldBeInStock() ? index.countInQuantityRange(1, numeric_limits<int>::max(), cap)
+                                          : index.countInQuantityRange(numeric_limits<int>::min(), 0, cap));
+    } else if (auto name = dynamic_cast<const NamePlantFilter *>(filter.get())) {
+        auto estimate = index.estimateNameMatches(name->getSubstring());
+        step.indexed = estimate.has_value();
+        step.estimatedRows = estimate ? *estimate : plantCount * shortNameSelectivity;
+        step.cost = nameCost;
+    } else if (auto all = dynamic_cast<const AndPlantFilter *>(filter.get())) {
+        // Nested combinations are checked per plant; children are assumed independent
+        double matched = 1;
+        step.cost = 0;
+        for (const auto &child : all->getFilters()) {
+            auto childStep = analyze(child);
+            matched *= selectivity(childStep);
+            step.cost += childStep.cost;
+        }
+        step.estimatedRows = plantCount * matched;
+    } else if (auto any = dynamic_cast<const OrPlantFilter *>(filter.get())) {
+        double missed = 1;
+        step.cost = 0;
+        for (const auto &child : any->getFilters()) {
+            auto childStep = analyze(child);
+            missed *= 1 - selectivity(childStep);
+            step.cost += childStep.cost;
+        }
+        step.estimatedRows = plantCount * (1 - missed);
+    } else {
+        step.estimatedRows = plantCount * broadSelectivity;
+        step.cost = customCost;
+    }
+    return step;
+}
+
+// Row estimate as a fraction of all plants
+double FilterPlanner::selectivity(const FilterPlan::Step &step) const {
+    if (plantCount == 0) return 0;
+    return clamp(step.estimatedRows / plantCount, 0.0, 1.0);
+}
+
+// Picks the index lookups and orders the checks
+FilterPlan FilterPlanner::plan(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd) const {
+    FilterPlan plan;
+    plan.useAnd = useAnd;
+
+    vector<FilterPlan::Step> steps;
+    for (const auto &filter : filters) steps.push_back(analyze(filter));
+    ranges::stable_sort(steps, {}, &FilterPlan::Step::estimatedRows);
+    double limit = candidateLimit();
+
+    if (useAnd) {
+        // Every selective indexed filter narrows the candidates; the rest are checked
+        for (auto &step : steps) {
+            if (step.indexed && step.estimatedRows <= limit) plan.sources.push_back(step);
+            else plan.checks.push_back(step);
+        }
+        double rows = plantCount;
+        for (const auto &step : steps) rows *= selectivity(step);
+        plan.estimatedRows = rows;
+
+        // Rejecting cheaply is what matters for AND
+        auto rank = [this](const FilterPlan::Step &step) {
+            double rejects = 1 - selectivity(step);
+            return rejects > 0 ? step.cost / rejects : numeric_limits<double>::infinity();
+        };
+        ranges::stable_sort(plan.checks, {}, rank);
+    } else {
+        bool allIndexed = ranges::all_of(steps, &FilterPlan::Step::indexed);
+        double total = 0;
+        for (const auto &step : steps) total += step.estimatedRows;
+        if (allIndexed && total <= limit) plan.sources = steps;
+        else plan.checks = steps;
+
+        double missed = 1;
+        for (const auto &step : steps) missed *= 1 - selectivity(step);
+        plan.estimatedRows = plantCount * (1 - missed);
+
+        // Accepting cheaply is what matters for OR
+        auto rank = [this](const FilterPlan::Step &step) {
+            double accepts = selectivity(step);
+            return accepts > 0 ? step.cost / accepts : numeric_limits<double>::infinity();
+        };
+        ranges::stable_sort(plan.checks, {}, rank);
+    }
+    plan.scan = plan.sources.empty();
+    plan.columnar = plan.scan && ranges::all_of(plan.checks, [](const auto &step) { return hasKernel(*step.filter); });
+    return plan;
+}
+
+// Dispatches to the index that answers the filter
+vector<uint64_t> FilterPlanner::candidates(const PlantFilter &filter) const {
+    vector<uint64_t> ids;
+    auto collect = [&ids](uint64_t sequence) { ids.push_back(sequence); };
+
+    if (auto species = dynamic_cast<const SpeciesPlantFilter *>(&filter)) {
+        const auto &plants = index.plantsOfSpecies(species->getSpecies());
+        ids.assign(plants.begin(), plants.end());
+        return ids; // Already in repository order
+    }
+    if (auto name = dynamic_cast<const NamePlantFilter *>(&filter)) {
+        index.searchNames(name->getSubstring(), ids);
+        return ids;
+    }
+    if (auto price = dynamic_cast<const PricePlantFilter *>(&filter)) {
+        index.forEachInPriceRange(price->getMinPrice(), price->getMaxPrice(), collect);
+    } else if (auto quantity = dynamic_cast<const MinQuantityPlantFilter *>(&filter)) {
+        index.forEachWithMinQuantity(quantity->getMinQuantity(), collect);
+    } else if (auto stock = dynamic_cast<const StockAvailabilityPlantFilter *>(&filter)) {
+        if (stock->getShouldBeInStock()) index.forEachWithMinQuantity(1, collect);
+        else index.forEachInQuantityRange(numeric_limits<int>::min(), 0, collect);
+    }
+    ranges::sort(ids); // Range lookups come in value order
+    return ids;
+}
+
+// Type check only: nothing is evaluated
+bool FilterPlanner::hasKernel(const PlantFilter &filter) {
+    if (dynamic_cast<const PricePlantFilter *>(&filter) || dynamic_cast<const MinQuantityPlantFilter *>(&filter) ||
+        dynamic_cast<const StockAvailabilityPlantFilter *>(&filter) || dynamic_cast<const SpeciesPlantFilter *>(&filter))
+        return true;
+    auto childrenHaveKernels = [](const vector<shared_ptr<PlantFilter>> &children) {
+        return ranges::all_of(children, [](const auto &child) { return hasKernel(*child); });
+    };
+    if (auto all = dynamic_cast<const AndPlantFilter *>(&filter)) return childrenHaveKernels(all->getFilters());
+    if (auto any = dynamic_cast<const OrPlantFilter *>(&filter)) return childrenHaveKernels(any->getFilters());
+    return false;
+}
+
+// Maps a filter to its column kernel; combinations need kernels for every child
+optional<SelectionBitmap> FilterPlanner::select(const PlantFilter &filter) const {
+    if (auto price = dynamic_cast<const PricePlantFilter *>(&filter))
+        return columns.selectPriceRange(price->getMinPrice(), price->getMaxPrice());
+    if (auto quantity = dynamic_cast<const MinQuantityPlantFilter *>(&filter))
+        return columns.selectQuantityRange(quantity->getMinQuantity(), numeric_limits<int>::max());
+    if (auto stock = dynamic_cast<const StockAvailabilityPlantFilter *>(&filter))
+        return stock->getShouldBeInStock() ? columns.selectQuantityRange(1, numeric_limits<int>::max())
+                                           : columns.selectQuantityRange(numeric_limits<int>::min(), 0);
+    if (auto species = dynamic_cast<const SpeciesPlantFilter *>(&filter))
+        return columns.selectSpecies(species->getSpecies());
+    if (auto all = dynamic_cast<const AndPlantFilter *>(&filter))
+        return selectRows(all->getFilters(), true);
+    if (auto any = dynamic_cast<const OrPlantFilter *>(&filter))
+        return selectRows(any->getFilters(), false);
+    return nullopt;
+}
+
+// Combines the kernels' bitmaps; an empty AND keeps every live row. No kernel
+// runs unless every filter has one.
+optional<SelectionBitmap> FilterPlanner::selectRows(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd) const {
+    if (!ranges::all_of(filters, [](const auto &filter) { return hasKernel(*filter); })) return nullopt;
+    SelectionBitmap rows = useAnd ? columns.selectAll() : SelectionBitmap(columns.blocks());
+    for (const auto &filter : filters) {
+        if (useAnd) rows &= *select(*filter);
+        else rows |= *select(*filter);
+    }
+    return rows;
+}
+
+// Applies the checks in plan order
+bool FilterPlanner::passes(const FilterPlan &plan, const Plant &plant) {
+    if (plan.useAnd)
+        return ranges::all_of(plan.checks, [&plant](const auto &step) { return step.filter->matches(plant); });
+    return plan.checks.empty() ||
+           ranges::any_of(plan.checks, [&plant](const auto &step) { return step.filter->matches(plant); });
+}
+
+// Scans the columns or the plants, or fetches the candidates and checks them
+void FilterPlanner::visit(const FilterPlan &plan, const function<void(const Plant&)> &visitor) const {
+    if (plan.columnar) {
+        vector<shared_ptr<PlantFilter>> filters;
+        for (const auto &step : plan.checks) filters.push_back(step.filter);
+        selectRows(filters, plan.useAnd)->forEach([&](size_t row) { visitor(columns.plantAt(row)); });
+        return;
+    }
+    if (plan.scan) {
+        repository.forEachPlant([&](const Plant &plant) {
+            if (passes(plan, plant)) visitor(plant);
+        });
+        return;
+    }
+
+    vector<uint64_t> ids = candidates(*plan.sources.front().filter);
+    for (size_t i = 1; i < plan.sources.size(); ++i) {
+        if (plan.useAnd && ids.empty()) break;
+        vector<uint64_t> next = candidates(*plan.sources[i].filter), combined;
+        if (plan.useAnd) ranges::set_intersection(ids, next, back_inserter(combined));
+        else ranges::set_union(ids, next, back_inserter(combined));
+        ids = move(combined);
+    }
+    for (uint64_t sequence : ids) {
+        Plant plant = repository.getPlantByName(index.nameOf(sequence));
+        if (passes(plan, plant)) visitor(plant);
+    }
+}
+
+// Row scans go through ParallelScan; everything else is collected from visit
+vector<Plant> FilterPlanner::execute(const FilterPlan &plan) const {
+    if (plan.scan && !plan.columnar)
+        return ParallelScan::collect(repository, pool, [&plan](const Plant &plant) { return passes(plan, plant); });
+
+    vector<Plant> result;
+    visit(plan, [&result](const Plant &plant) { result.push_back(plant); });
+    return result;
+}
+
+// Formats a row estimate
+static string rows(double estimate) { return to_string(llround(estimate)); }
+
+// One line per step, e.g.
+//   AND of 3 filters, estimated 12 rows
+//     index species = "Flower" (est. 40 rows)
+//     intersect index price in [10, 12] (est. 30 rows)
+//     check name contains "Ro" (est. 250 rows, cost 4)
+string FilterPlan::describe() const {
+    ostringstream out;
+    out << (useAnd ? "AND" : "OR") << " of " << sources.size() + checks.size() << " filters, estimated "
+        << rows(estimatedRows) << " rows\n";
+    if (columnar) out << "  scan columns (vectorized)\n";
+    else if (scan) out << "  scan all plants\n";
+    for (size_t i = 0; i < sources.size(); ++i) {
+        out << "  " << (i == 0 ? "" : useAnd ? "intersect " : "union ") << "index " << sources[i].filter->describe()
+            << " (est. " << rows(sources[i].estimatedRows) << " rows)\n";
+    }
+    for (const auto &step : checks) {
+        out << "  check " << step.filter->describe() << " (est. " << rows(step.estimatedRows) << " rows, cost "
+            << step.cost << ")\n";
+    }
+    return out.str();
+}
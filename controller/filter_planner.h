@@ -0,0 +1,127 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+#include "../Repository/plant_columns.h"
+#include "filter.h"
+#include "plant_index.h"
+#include "work_stealing_pool.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// How a combination of filters will be evaluated
+struct FilterPlan {
+    // One filter as seen by the planner
+    struct Step {
+        shared_ptr<PlantFilter> filter;
+        bool indexed = false;      // Candidates can be read from an index
+        double estimatedRows = 0;  // Plants the filter alone is expected to match
+        double cost = 1;           // Relative cost of checking one plant
+    };
+
+    bool useAnd = true;
+
+    // Visit every plant (true) or only the candidates of the sources
+    bool scan = true;
+
+    // Scan: every check has a column kernel, so the scan runs on the columns
+    bool columnar = false;
+
+    // Index lookups, intersected (AND) or united (OR) into the candidates
+    vector<Step> sources;
+
+    // Filters checked on every visited plant, in evaluation order
+    vector<Step> checks;
+
+    double estimatedRows = 0;
+
+    // Returns the plan as indented text, one step per line
+    string describe() const;
+};
+
+// Result of PlantController::explainFilter
+struct FilterExplanation {
+    string plan;
+    double estimatedRows = 0;
+    size_t actualRows = 0;
+};
+
+// Result of PlantController::getFilterTotals
+struct FilterTotals {
+    size_t plants = 0;
+    long long quantity = 0;
+    double value = 0;
+};
+
+// Cost-based planner for filterPlants.
+//
+// Each filter gets a row estimate: exact for species (index counts), counted
+// up to a cap for price and quantity ranges, bounded by the trigram posting
+// lists for names, and fixed guesses otherwise. Fetching a candidate by name
+// costs several times more than visiting a plant during a scan, so indexes
+// are only used while the candidates stay under 1/16 of the inventory:
+//   - AND: the indexed filters under that limit are intersected, smallest
+//     first, and the remaining filters are checked on the candidates;
+//   - OR: if every filter is indexed and their sum is under the limit, the
+//     candidates are united and need no further checks.
+// Otherwise all plants are scanned; when every check has a column kernel
+// (price, quantity, stock, species and combinations of them) the scan runs on
+// the PlantColumns and only the selected rows are built. Checks run cheapest-per-rejection first
+// for AND (cost / (1 - selectivity)) and cheapest-per-match first for OR
+// (cost / selectivity), so the evaluation short-circuits as early as possible.
+class FilterPlanner {
+private:
+    const PlantRepository &repository;
+    const PlantIndex &index;
+    const PlantColumns &columns;
+    size_t plantCount;
+    WorkStealingPool *pool;
+
+    // Largest candidate set worth fetching by name instead of scanning
+    size_t candidateLimit() const { return plantCount / 16; }
+
+    // Estimates a single filter
+    FilterPlan::Step analyze(const shared_ptr<PlantFilter> &filter) const;
+
+    // Estimated fraction of plants a filter matches
+    double selectivity(const FilterPlan::Step &step) const;
+
+    // Reads the candidates of an indexed filter, in repository order
+    vector<uint64_t> candidates(const PlantFilter &filter) const;
+
+    // True if a plant passes the checks of a plan
+    static bool passes(const FilterPlan &plan, const Plant &plant);
+
+    // Checks if a filter (and every child of a combination) has a column kernel
+    static bool hasKernel(const PlantFilter &filter);
+
+    // Evaluates a filter on the columns, or returns nullopt if it has no kernel
+    optional<SelectionBitmap> select(const PlantFilter &filter) const;
+
+public:
+    // Constructor; plantCount is the current number of plants. Row scans run
+    // on pool when one is given (see ParallelScan).
+    FilterPlanner(const PlantRepository &repository, const PlantIndex &index, const PlantColumns &columns,
+                  size_t plantCount, WorkStealingPool *pool = nullptr)
+        : repository(repository), index(index), columns(columns), plantCount(plantCount), pool(pool) {}
+
+    // Chooses how to evaluate the filters (non-empty)
+    FilterPlan plan(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd) const;
+
+    // Runs a plan; results are in repository order
+    vector<Plant> execute(const FilterPlan &plan) const;
+
+    // Calls visitor for every match of a plan, in repository order, on the
+    // calling thread; nothing is collected
+    void visit(const FilterPlan &plan, const function<void(const Plant&)> &visitor) const;
+
+    // Selects the matching rows of the columns, or returns nullopt if some
+    // filter has no column kernel
+    optional<SelectionBitmap> selectRows(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd) const;
+};
@@ -0,0 +1,146 @@
+#include "group_stats.h"
+#include "parallel_scan.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+
+// Adds the plant to the counts, sums and price range
+void GroupAccumulator::add(const Plant &plant) {
+    ++plants;
+    quantity += plant.getQuantity();
+    value.add(plant.getQuantity() * plant.getPrice());
+    if (isnan(plant.getPrice())) return;
+    ++pricedPlants;
+    priceSum.add(plant.getPrice());
+    minPrice = min(minPrice, plant.getPrice());
+    maxPrice = max(maxPrice, plant.getPrice());
+}
+
+// Sums are added, ranges widened
+void GroupAccumulator::merge(const GroupAccumulator &other) {
+    plants += other.plants;
+    quantity += other.quantity;
+    value.add(other.value);
+    priceSum.add(other.priceSum);
+    pricedPlants += other.pricedPlants;
+    minPrice = min(minPrice, other.minPrice);
+    maxPrice = max(maxPrice, other.maxPrice);
+}
+
+// Builds the totals; price statistics stay NaN without priced plants
+GroupTotals GroupAccumulator::totals(const string &key) const {
+    GroupTotals result;
+    result.key = key;
+    result.plants = plants;
+    result.quantity = quantity;
+    result.value = value.value();
+    if (pricedPlants > 0) {
+        result.minPrice = minPrice;
+        result.maxPrice = maxPrice;
+        result.averagePrice = priceSum.value() / pricedPlants;
+    }
+    return result;
+}
+
+// Updates the species' sums and price counts; empty species are dropped
+void SpeciesStats::apply(const Plant &plant, int sign) {
+    Group &group = groups[plant.getSpecies()];
+    group.plants += sign;
+    group.quantity += sign * static_cast<long long>(plant.getQuantity());
+    group.value.add(sign * plant.getQuantity() * plant.getPrice());
+    if (!isnan(plant.getPrice())) {
+        group.priceSum.add(sign * plant.getPrice());
+        group.pricedPlants += sign;
+        if (sign > 0) {
+            ++group.prices[plant.getPrice()];
+        } else {
+            auto price = group.prices.find(plant.getPrice());
+            if (--price->second == 0) group.prices.erase(price);
+        }
+    }
+    if (group.plants == 0) groups.erase(plant.getSpecies());
+}
+
+// Clears the groups and adds every plant
+void SpeciesStats::rebuild() {
+    groups.clear();
+    repository.forEachPlant([this](const Plant &plant) { apply(plant, 1); });
+}
+
+// Reads min and max from the ends of the price map
+GroupTotals SpeciesStats::totalsOf(const string &species, const Group &group) {
+    GroupTotals result;
+    result.key = species;
+    result.plants = group.plants;
+    result.quantity = group.quantity;
+    result.value = group.value.value();
+    if (!group.prices.empty()) {
+        result.minPrice = group.prices.begin()->first;
+        result.maxPrice = group.prices.rbegin()->first;
+        result.averagePrice = group.priceSum.value() / group.pricedPlants;
+    }
+    return result;
+}
+
+// Every species, alphabetically
+vector<GroupTotals> SpeciesStats::all() const {
+    vector<GroupTotals> result;
+    result.reserve(groups.size());
+    for (const auto &[species, group] : groups) result.push_back(totalsOf(species, group));
+    return result;
+}
+
+// One species
+GroupTotals SpeciesStats::of(const string &species) const {
+    auto it = groups.find(species);
+    if (it == groups.end()) {
+        GroupTotals empty;
+        empty.key = species;
+        return empty;
+    }
+    return totalsOf(species, it->second);
+}
+
+// Recomputes the groups with a one-shot group-by and compares them
+void SpeciesStats::verify() const {
+    auto tracked = all();
+    auto scanned = groupBy(repository, nullptr, [](const Plant &plant) { return plant.getSpecies(); });
+    auto close = [](double a, double b) {
+        return (isnan(a) && isnan(b)) || fabs(a - b) <= 1e-9 * max(1.0, fabs(b));
+    };
+    if (tracked.size() != scanned.size()) {
+        throw logic_error("Species statistics out of sync: tracked " + to_string(tracked.size()) +
+                          " species, scanned " + to_string(scanned.size()));
+    }
+    for (size_t i = 0; i < tracked.size(); ++i) {
+        const GroupTotals &a = tracked[i], &b = scanned[i];
+        if (a.key != b.key || a.plants != b.plants || a.quantity != b.quantity || !close(a.value, b.value) ||
+            !close(a.minPrice, b.minPrice) || !close(a.maxPrice, b.maxPrice) || !close(a.averagePrice, b.averagePrice))
+            throw logic_error("Species statistics out of sync for \"" + b.key + "\"");
+    }
+}
+
+// Aggregates every slot range into its own map, then merges the maps
+vector<GroupTotals> SpeciesStats::groupBy(const PlantRepository &repository, WorkStealingPool *pool,
+                                          const function<string(const Plant&)> &key) {
+    auto slotRanges = ParallelScan::ranges(repository, pool);
+    vector<unordered_map<string, GroupAccumulator>> parts(slotRanges.size());
+    auto aggregate = [&](size_t part) {
+        repository.forEachPlantInSlots(slotRanges[part].first, slotRanges[part].second,
+                                       [&](const Plant &plant) { parts[part][key(plant)].add(plant); });
+    };
+    if (slotRanges.size() == 1) aggregate(0);
+    else pool->run(slotRanges.size(), aggregate);
+
+    map<string, GroupAccumulator> merged;
+    for (const auto &part : parts)
+        for (const auto &[groupKey, accumulator] : part) merged[groupKey].merge(accumulator);
+
+    vector<GroupTotals> result;
+    result.reserve(merged.size());
+    for (const auto &[groupKey, accumulator] : merged) result.push_back(accumulator.totals(groupKey));
+    return result;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+#include "inventory_stats.h"
+#include "work_stealing_pool.h"
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Aggregates of one group of plants. Price statistics only count plants with
+// a price (not NaN); they are NaN when the group has none.
+struct GroupTotals {
+    string key;
+    size_t plants = 0;
+    long long quantity = 0;
+    double value = 0; // Sum of quantity * price
+    double minPrice = numeric_limits<double>::quiet_NaN();
+    double maxPrice = numeric_limits<double>::quiet_NaN();
+    double averagePrice = numeric_limits<double>::quiet_NaN();
+};
+
+// Add-only accumulator for one group; two accumulators of disjoint plants
+// merge into the accumulator of their union, so partitions can be summed
+// separately and combined
+class GroupAccumulator {
+private:
+    size_t plants = 0;
+    long long quantity = 0;
+    CompensatedSum value;
+    CompensatedSum priceSum;
+    size_t pricedPlants = 0;
+    double minPrice = numeric_limits<double>::infinity();
+    double maxPrice = -numeric_limits<double>::infinity();
+
+public:
+    // Adds one plant
+    void add(const Plant &plant);
+
+    // Adds the plants of another accumulator
+    void merge(const GroupAccumulator &other);
+
+    // Returns the aggregates under the given key
+    GroupTotals totals(const string &key) const;
+};
+
+// Per-species aggregates of a repository, kept current through its change
+// notifications like InventoryStats, so a dashboard can read them at any
+// time without a scan.
+//
+// Removals and updates have to take a plant's price back out of the min and
+// max, so every species keeps its prices in an ordered map (price -> number
+// of plants); minimum and maximum are its first and last keys.
+class SpeciesStats : public PlantRepository::Listener {
+private:
+    struct Group {
+        size_t plants = 0;
+        long long quantity = 0;
+        CompensatedSum value;
+        CompensatedSum priceSum;
+        size_t pricedPlants = 0;
+        map<double, size_t> prices; // Non-NaN prices with their plant counts
+    };
+
+    const PlantRepository &repository;
+    map<string, Group> groups;
+
+    // Adds (sign = 1) or subtracts (sign = -1) a plant from its species
+    void apply(const Plant &plant, int sign);
+
+    // Returns the aggregates of a group
+    static GroupTotals totalsOf(const string &species, const Group &group);
+
+public:
+    // Constructor; computes the initial groups with one scan
+    explicit SpeciesStats(const PlantRepository &repository) : repository(repository) { rebuild(); }
+
+    // Recomputes every group from scratch
+    void rebuild();
+
+    // Listener callbacks
+    void plantAdded(const Plant &plant) override { apply(plant, 1); }
+    void plantRemoved(const Plant &plant) override { apply(plant, -1); }
+    void plantUpdated(const Plant &oldPlant, const Plant &newPlant) override {
+        apply(oldPlant, -1);
+        apply(newPlant, 1);
+    }
+    void plantsReset() override { rebuild(); }
+
+    // Aggregates of every species, in alphabetical order
+    vector<GroupTotals> all() const;
+
+    // Aggregates of one species (zero plants if it has none)
+    GroupTotals of(const string &species) const;
+
+    // Compares the groups against a full scan; throws logic_error on a mismatch
+    void verify() const;
+
+    // One-shot group-by over all plants with an arbitrary key (e.g. price
+    // bands). Slot ranges are aggregated on the pool when one is given and
+    // merged; groups are returned sorted by key.
+    static vector<GroupTotals> groupBy(const PlantRepository &repository, WorkStealingPool *pool,
+                                       const function<string(const Plant&)> &key);
+};
@@ -0,0 +1,151 @@
+#include "inventory_snapshot.h"
+#include "../Repository/repository_converter.h"
+
+using namespace std;
+
+// Walks the trie in slot order, skipping emptied slots
+static void visitNode(const SnapshotNode &node, unsigned level, const function<void(const Plant&)> &visitor) {
+    if (level == 0) {
+        for (size_t i = 0; i < node.plants.size(); ++i)
+            if (!(node.removed >> i & 1)) visitor(node.plants[i]);
+        return;
+    }
+    for (const auto &child : node.children) visitNode(*child, level - 1, visitor);
+}
+
+// Visits the plants of the version
+void InventorySnapshot::forEach(const function<void(const Plant&)> &visitor) const {
+    if (root) visitNode(*root, depth, visitor);
+}
+
+// Collects the plants of the version
+vector<Plant> InventorySnapshot::getAllPlants() const {
+    vector<Plant> plants;
+    plants.reserve(plantCount);
+    forEach([&plants](const Plant &plant) { plants.push_back(plant); });
+    return plants;
+}
+
+// Writes through the converter, which knows every file format
+size_t InventorySnapshot::exportTo(const string &path) const {
+    return RepositoryConverter::write(getAllPlants(), path);
+}
+
+// Constructor
+SnapshotPublisher::SnapshotPublisher(const PlantRepository &repository) : repository(repository) {
+    rebuild();
+    publish();
+}
+
+// Nodes of older epochs may be shared with published versions, so they are copied
+SnapshotNode &SnapshotPublisher::own(shared_ptr<SnapshotNode> &link) {
+    if (link->epoch != epoch) {
+        link = make_shared<SnapshotNode>(*link);
+        link->epoch = epoch;
+    }
+    return *link;
+}
+
+// Descends from the root, taking branchBits of the leaf number per level
+SnapshotNode &SnapshotPublisher::leafForWrite(size_t slot, bool grow) {
+    size_t leaf = slot >> SnapshotNode::leafBits;
+    shared_ptr<SnapshotNode> *link = &root;
+    for (unsigned level = depth; level > 0; --level) {
+        SnapshotNode &node = own(*link);
+        size_t child = (leaf >> ((level - 1) * SnapshotNode::branchBits)) & (SnapshotNode::branchSize - 1);
+        if (grow && child == node.children.size()) node.children.push_back(make_shared<SnapshotNode>(epoch));
+        link = &node.children[child];
+    }
+    return own(*link);
+}
+
+// Adds a level above the root once every slot under it is taken
+void SnapshotPublisher::append(const Plant &plant) {
+    if (!root) root = make_shared<SnapshotNode>(epoch);
+    size_t capacity = SnapshotNode::leafSize << (depth * SnapshotNode::branchBits);
+    if (slotCount == capacity) {
+        auto newRoot = make_shared<SnapshotNode>(epoch);
+        newRoot->children.push_back(move(root));
+        root = move(newRoot);
+        ++depth;
+    }
+    SnapshotNode &leaf = leafForWrite(slotCount, true);
+    leaf.plants.push_back(plant);
+    slotByName[plant.getName()] = slotCount++;
+    ++plantCount;
+    dirty = true;
+}
+
+// Starts over with fresh nodes; published versions keep the old ones
+void SnapshotPublisher::rebuild() {
+    root.reset();
+    depth = 0;
+    slotCount = plantCount = 0;
+    slotByName.clear();
+    ++epoch;
+    repository.forEachPlant([this](const Plant &plant) { append(plant); });
+    dirty = true;
+}
+
+// Appends the plant
+void SnapshotPublisher::plantAdded(const Plant &plant) { append(plant); }
+
+// Empties the plant's slot; once empty slots outnumber plants the trie is rebuilt
+void SnapshotPublisher::plantRemoved(const Plant &plant) {
+    auto it = slotByName.find(plant.getName());
+    if (it == slotByName.end()) return;
+    size_t slot = it->second;
+    slotByName.erase(it);
+    leafForWrite(slot, false).removed |= uint64_t{1} << (slot & (SnapshotNode::leafSize - 1));
+    --plantCount;
+    dirty = true;
+    if (slotCount - plantCount >= 1024 && slotCount - plantCount > plantCount) rebuild();
+}
+
+// Replaces the plant in its slot
+void SnapshotPublisher::plantUpdated(const Plant &, const Plant &newPlant) {
+    auto it = slotByName.find(newPlant.getName());
+    if (it == slotByName.end()) return;
+    leafForWrite(it->second, false).plants[it->second & (SnapshotNode::leafSize - 1)] = newPlant;
+    dirty = true;
+}
+
+// Many plants changed at once
+void SnapshotPublisher::plantsReset() { rebuild(); }
+
+// Wraps the current trie into a snapshot; nodes made so far become shared
+void SnapshotPublisher::publish() {
+    if (!dirty) return;
+    auto snapshot = make_shared<InventorySnapshot>();
+    snapshot->root = root;
+    snapshot->depth = depth;
+    snapshot->plantCount = plantCount;
+    snapshot->version = ++version;
+    auto holder = make_unique<Holder>(Holder{move(snapshot)});
+    published.store(holder.get());
+    if (publishedHolder) retiredSinceFlip.push_back(move(publishedHolder));
+    publishedHolder = move(holder);
+    ++epoch;
+    dirty = false;
+
+    // Readers of the current phase registered after the last flip and so
+    // loaded a holder that was still published then. Once the other phase has
+    // no readers, the holders retired before that flip are unreachable. With
+    // no reader in either phase two flips free every retired holder.
+    for (int flip = 0; flip < 2; ++flip) {
+        unsigned current = phase.load();
+        if (activeReaders[current ^ 1].load() != 0) break;
+        retiredBeforeFlip = move(retiredSinceFlip);
+        retiredSinceFlip.clear();
+        phase.store(current ^ 1);
+    }
+}
+
+// Registered on a phase, the loaded holder cannot be deleted before the copy is made
+shared_ptr<const InventorySnapshot> SnapshotPublisher::current() const {
+    unsigned readerPhase = phase.load();
+    activeReaders[readerPhase].fetch_add(1);
+    shared_ptr<const InventorySnapshot> snapshot = published.load()->snapshot;
+    activeReaders[readerPhase].fetch_sub(1);
+    return snapshot;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Node of the persistent trie behind the snapshots. Slots are numbered in
+// repository order; a leaf holds 64 consecutive slots, an inner node 32
+// children. Nodes reachable from a published snapshot are never changed.
+struct SnapshotNode {
+    static constexpr unsigned leafBits = 6;
+    static constexpr unsigned branchBits = 5;
+    static constexpr size_t leafSize = size_t{1} << leafBits;
+    static constexpr size_t branchSize = size_t{1} << branchBits;
+
+    uint64_t epoch;                           // Publication epoch the node was created in
+    vector<shared_ptr<SnapshotNode>> children; // Inner node
+    vector<Plant> plants;                     // Leaf: one plant per slot
+    uint64_t removed = 0;                     // Leaf: bit i set = slot i is empty
+
+    explicit SnapshotNode(uint64_t epoch) : epoch(epoch) {}
+};
+
+// Immutable version of the inventory. Holding one keeps it alive; iterating
+// needs no lock, even while the controller keeps changing.
+class InventorySnapshot {
+private:
+    shared_ptr<const SnapshotNode> root;
+    unsigned depth = 0; // Inner levels above the leaves
+    size_t plantCount = 0;
+    uint64_t version = 0;
+
+    friend class SnapshotPublisher;
+
+public:
+    // Number of the publication; grows with every published change
+    uint64_t getVersion() const { return version; }
+
+    // Number of plants
+    size_t size() const { return plantCount; }
+
+    // Calls visitor for every plant in repository order
+    void forEach(const function<void(const Plant&)> &visitor) const;
+
+    // Copies all plants, in repository order
+    vector<Plant> getAllPlants() const;
+
+    // Writes the plants to a new inventory file; the format follows the
+    // extension (.csv, .json or .bin). Returns the number of plants written.
+    size_t exportTo(const string &path) const;
+};
+
+// Keeps a persistent trie of the plants up to date from the repository's
+// change notifications and publishes it as an InventorySnapshot.
+//
+// Changes copy the path from the root to the affected leaf, unless those
+// nodes were created since the last publication: between two publications
+// (e.g. within one bulk edit) each node is copied at most once.
+//
+// Publication is RCU-style: the latest version sits in a holder behind an
+// atomic pointer. current() registers on the reader counter of the current
+// phase, loads the pointer and copies the shared_ptr out of the holder.
+// publish() retires the replaced holder. Once the counter of the other phase
+// has drained, no reader can still see a holder retired before the last phase
+// flip: those are deleted and the phase flips again. New readers always
+// register on the current phase, so a steady stream of them never holds up
+// reclamation; versions themselves live as long as someone holds them. Not
+// thread-safe itself: changes and publish() come from one writer at a time,
+// only current() may be called from any thread.
+class SnapshotPublisher : public PlantRepository::Listener {
+private:
+    const PlantRepository &repository;
+
+    shared_ptr<SnapshotNode> root;
+    unsigned depth = 0;
+    size_t slotCount = 0;  // Slots in use, including emptied ones
+    size_t plantCount = 0;
+    unordered_map<string, size_t> slotByName;
+
+    uint64_t epoch = 1;    // Nodes of this epoch are unpublished and may change in place
+    uint64_t version = 0;
+    bool dirty = true;
+
+    // The published version; holders are replaced, never changed
+    struct Holder {
+        shared_ptr<const InventorySnapshot> snapshot;
+    };
+    atomic<const Holder *> published{nullptr};
+    unique_ptr<Holder> publishedHolder;
+    vector<unique_ptr<Holder>> retiredBeforeFlip; // Only readers of the other phase may see these
+    vector<unique_ptr<Holder>> retiredSinceFlip;  // Readers of either phase may see these
+    atomic<unsigned> phase{0};
+    mutable atomic<size_t> activeReaders[2] = {0, 0};
+
+    // Returns a node of the current epoch at link, copying the node if needed
+    SnapshotNode &own(shared_ptr<SnapshotNode> &link);
+
+    // Returns the leaf holding slot, copying the path to it; with grow set,
+    // missing nodes on the way are created (for appends)
+    SnapshotNode &leafForWrite(size_t slot, bool grow);
+
+    // Appends a plant in the next slot
+    void append(const Plant &plant);
+
+    // Rebuilds the trie from the repository
+    void rebuild();
+
+public:
+    // Constructor; builds and publishes the first version
+    explicit SnapshotPublisher(const PlantRepository &repository);
+
+    void plantAdded(const Plant &plant) override;
+    void plantRemoved(const Plant &plant) override;
+    void plantUpdated(const Plant &oldPlant, const Plant &newPlant) override;
+    void plantsReset() override;
+
+    // Makes the changes since the last call visible to current()
+    void publish();
+
+    // The latest published version; never blocks
+    shared_ptr<const InventorySnapshot> current() const;
+};
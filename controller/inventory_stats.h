@@ -0,0 +1,95 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Compensated (Neumaier) sum: adding and subtracting the same terms many times
+// does not accumulate rounding error
+class CompensatedSum {
+private:
+    double sum = 0;
+    double compensation = 0;
+
+public:
+    // Adds a term (subtract by adding its negation)
+    void add(double term) {
+        double next = sum + term;
+        if (fabs(sum) >= fabs(term)) compensation += (sum - next) + term;
+        else compensation += (term - next) + sum;
+        sum = next;
+    }
+
+    // Adds the terms of another sum
+    void add(const CompensatedSum &other) {
+        add(other.sum);
+        add(other.compensation);
+    }
+
+    // Current total
+    double value() const { return sum + compensation; }
+};
+
+// Inventory totals of a repository, kept current through its change
+// notifications so that reading them is O(1) instead of a full scan
+class InventoryStats : public PlantRepository::Listener {
+private:
+    const PlantRepository &repository;
+    size_t plantCount = 0;
+    long long totalQuantity = 0;
+
+    // Total value as a compensated sum
+    CompensatedSum value;
+
+    // Adds (sign = 1) or subtracts (sign = -1) a plant from the totals
+    void apply(const Plant &plant, int sign) {
+        plantCount += sign;
+        totalQuantity += sign * static_cast<long long>(plant.getQuantity());
+        value.add(sign * plant.getQuantity() * plant.getPrice());
+    }
+
+public:
+    // Constructor; computes the initial totals with one scan
+    explicit InventoryStats(const PlantRepository &repository) : repository(repository) { rebuild(); }
+
+    // Recomputes the totals from scratch
+    void rebuild() {
+        plantCount = 0;
+        totalQuantity = 0;
+        value = CompensatedSum();
+        repository.forEachPlant([this](const Plant &plant) { apply(plant, 1); });
+    }
+
+    // Listener callbacks
+    void plantAdded(const Plant &plant) override { apply(plant, 1); }
+    void plantRemoved(const Plant &plant) override { apply(plant, -1); }
+    void plantUpdated(const Plant &oldPlant, const Plant &newPlant) override {
+        apply(oldPlant, -1);
+        apply(newPlant, 1);
+    }
+    void plantsReset() override { rebuild(); }
+
+    // Totals
+    double getTotalValue() const { return value.value(); }
+    long long getTotalQuantity() const { return totalQuantity; }
+    size_t getPlantCount() const { return plantCount; }
+
+    // Compares the totals against a full scan; throws logic_error on a mismatch
+    void verify() const {
+        InventoryStats scan(repository);
+        double tolerance = 1e-9 * max(1.0, fabs(scan.getTotalValue()));
+        if (scan.plantCount != plantCount || scan.totalQuantity != totalQuantity ||
+            fabs(scan.getTotalValue() - getTotalValue()) > tolerance) {
+            throw logic_error("Inventory statistics out of sync: tracked " + to_string(plantCount) + " plants, " +
+                              to_string(totalQuantity) + " units, value " + to_string(getTotalValue()) +
+                              "; scanned " + to_string(scan.plantCount) + " plants, " +
+                              to_string(scan.totalQuantity) + " units, value " + to_string(scan.getTotalValue()));
+        }
+    }
+};
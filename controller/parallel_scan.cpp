@@ -0,0 +1,50 @@
+#include "parallel_scan.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Ranges smaller than this cost more to schedule than to scan
+static constexpr size_t minSlotsPerTask = 16384;
+
+// Tasks per thread, so stealing can even out ranges of different cost
+static constexpr size_t tasksPerThread = 4;
+
+// At least minSlotsPerTask slots per range, at most tasksPerThread ranges per thread
+vector<pair<size_t, size_t>> ParallelScan::ranges(const PlantRepository &repository, WorkStealingPool *pool) {
+    size_t slots = repository.slotCount();
+    size_t tasks = 1;
+    if (pool && pool->threadCount() > 0)
+        tasks = clamp(slots / minSlotsPerTask, size_t{1}, (pool->threadCount() + 1) * tasksPerThread);
+
+    vector<pair<size_t, size_t>> result;
+    size_t chunk = (slots + tasks - 1) / tasks;
+    for (size_t task = 0; task < tasks; ++task) result.emplace_back(task * chunk, min(slots, (task + 1) * chunk));
+    return result;
+}
+
+// Scans the ranges on the pool and joins their results
+vector<Plant> ParallelScan::collect(const PlantRepository &repository, WorkStealingPool *pool,
+                                    const function<bool(const Plant&)> &predicate) {
+    vector<Plant> result;
+    auto slotRanges = ranges(repository, pool);
+    if (slotRanges.size() == 1) {
+        repository.forEachPlant([&](const Plant &plant) {
+            if (predicate(plant)) result.push_back(plant);
+        });
+        return result;
+    }
+
+    vector<vector<Plant>> parts(slotRanges.size());
+    pool->run(slotRanges.size(), [&](size_t task) {
+        repository.forEachPlantInSlots(slotRanges[task].first, slotRanges[task].second, [&](const Plant &plant) {
+            if (predicate(plant)) parts[task].push_back(plant);
+        });
+    });
+
+    size_t total = 0;
+    for (const auto &part : parts) total += part.size();
+    result.reserve(total);
+    for (auto &part : parts) move(part.begin(), part.end(), back_inserter(result));
+    return result;
+}
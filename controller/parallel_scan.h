@@ -0,0 +1,28 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+#include "work_stealing_pool.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Predicate scans over a repository, split into slot ranges on a pool.
+//
+// Every range collects its matches into its own vector and the vectors are
+// concatenated in range order, so the result is in repository order exactly
+// like a sequential scan. The predicate is called concurrently and must only
+// read shared state (all filters in filter.h do).
+class ParallelScan {
+public:
+    // Splits the repository's slots into [first, last) ranges sized for the
+    // pool; a single range when there is no pool, no worker or little data
+    static vector<pair<size_t, size_t>> ranges(const PlantRepository &repository, WorkStealingPool *pool);
+
+    // Returns the plants accepted by predicate, in repository order. Without a
+    // pool, or with a pool that has no workers, the scan stays on the caller.
+    static vector<Plant> collect(const PlantRepository &repository, WorkStealingPool *pool,
+                                 const function<bool(const Plant&)> &predicate);
+};
@@ -12,7 +12,23 @@ using namespace std;
 
 // Constructor
 PlantController::PlantController(unique_ptr<PlantRepository> repository)
-    : repository(move(repository)) {
+    : repository(move(repository)), stats(*this->repository), speciesStats(*this->repository), index(*this->repository),
+      columns(*this->repository), snapshots(*this->repository) {
+    this->repository->addListener(&stats);
+    this->repository->addListener(&speciesStats);
+    this->repository->addListener(&index);
+    this->repository->addListener(&columns);
+    this->repository->addListener(&snapshots);
+}
+
+// Destructor; finishes the queued mutations first
+PlantController::~PlantController() {
+    writerQueue.reset();
+    repository->removeListener(&snapshots);
+    repository->removeListener(&columns);
+    repository->removeListener(&index);
+    repository->removeListener(&speciesStats);
+    repository->removeListener(&stats);
 }
 
 // Throws if quantity is negative
@@ -29,25 +45,77 @@ void PlantController::validatePrice(double price) const {
     }
 }
 
+// Pushes an executed command onto the undo stack, or folds it into the
+// previous entry when both update the same plant and that entry was the
+// last one recorded
+void PlantController::record(unique_ptr<Command> cmd, bool coalesce) {
+    clearHistory(redoStack); // Clear redo stack on new operation
+
+    // Never merge into an entry from before the open batch, rollback must keep it
+    bool ownEntry = !repository->inBatch() || undoStack.size() > batchUndoDepth;
+    bool merge = coalesce && coalesceOpen && historyLimits.coalesceUpdates && !undoStack.empty() && ownEntry;
+    coalesceOpen = coalesce;
+    if (merge) {
+        Command &last = *undoStack.back();
+        size_t before = last.memoryUsage();
+        if (last.absorb(*cmd)) {
+            historyBytes = historyBytes - before + last.memoryUsage();
+            trimHistory();
+            return;
+        }
+    }
+    historyBytes += cmd->memoryUsage();
+    undoStack.push_back(move(cmd));
+    trimHistory();
+}
+
+// Drops from the bottom of the undo stack; a batch's saved depth moves down with it
+void PlantController::trimHistory() {
+    while (!undoStack.empty() &&
+           (undoStack.size() > historyLimits.maxEntries || historyBytes > historyLimits.maxBytes)) {
+        historyBytes -= undoStack.front()->memoryUsage();
+        undoStack.pop_front();
+        if (batchUndoDepth > 0) --batchUndoDepth;
+    }
+}
+
+// Pops every command of the stack
+void PlantController::clearHistory(stack<unique_ptr<Command>> &commands) {
+    while (!commands.empty()) {
+        historyBytes -= commands.top()->memoryUsage();
+        commands.pop();
+    }
+}
+
+// Applies new bounds and trims the history to them
+void PlantController::setUndoHistoryLimits(const UndoHistoryLimits &limits) {
+    write([&] {
+        historyLimits = limits;
+        trimHistory();
+    });
+}
+
 // Adds a new plant using Command Pattern for undo/redo support
 void PlantController::addPlant(const string &name, const string &species, int quantity, double price) {
     validateQuantity(quantity);
     validatePrice(price);
 
-    Plant plant(name, species, quantity, price);
-    auto cmd = make_unique<AddPlantCommand>(repository.get(), plant);
-    cmd->execute();
-    undoStack.push(move(cmd));
-    while (!redoStack.empty()) redoStack.pop(); // Clear redo stack on new operation
+    write([&] {
+        Plant plant(name, species, quantity, price);
+        auto cmd = make_unique<AddPlantCommand>(repository.get(), plant);
+        cmd->execute();
+        record(move(cmd));
+    });
 }
 
 // Removes a plant by name using Command Pattern for undo/redo support
 void PlantController::removePlant(const string &name) {
-    Plant toRemove = repository->getPlantByName(name);
-    auto cmd = make_unique<RemovePlantCommand>(repository.get(), toRemove);
-    cmd->execute();
-    undoStack.push(move(cmd));
-    while (!redoStack.empty()) redoStack.pop(); // Clear redo stack on new operation
+    write([&] {
+        Plant toRemove = repository->getPlantByName(name);
+        auto cmd = make_unique<RemovePlantCommand>(repository.get(), toRemove);
+        cmd->execute();
+        record(move(cmd));
+    });
 }
 
 // Updates a plant by name using Command Pattern for undo/redo support
@@ -55,72 +123,296 @@ void PlantController::updatePlant(const string &name, const string &species, int
     validateQuantity(quantity);
     validatePrice(price);
 
-    Plant oldPlant = repository->getPlantByName(name);
-    Plant newPlant(name, species, quantity, price);
-    auto cmd = make_unique<UpdatePlantCommand>(repository.get(), oldPlant, newPlant);
-    cmd->execute();
-    undoStack.push(move(cmd));
-    while (!redoStack.empty()) redoStack.pop(); // Clear redo stack on new operation
+    write([&] {
+        Plant oldPlant = repository->getPlantByName(name);
+        Plant newPlant(name, species, quantity, price);
+        auto cmd = make_unique<UpdatePlantCommand>(repository.get(), oldPlant, newPlant);
+        cmd->execute();
+        record(move(cmd));
+    });
+}
+
+// Builds the command of one edit, reading the current plant for updates and removals
+unique_ptr<Command> PlantController::makeCommand(const PlantEdit &edit) const {
+    switch (edit.kind) {
+    case PlantEdit::Kind::Add:
+        validateQuantity(edit.plant.getQuantity());
+        validatePrice(edit.plant.getPrice());
+        return make_unique<AddPlantCommand>(repository.get(), edit.plant);
+    case PlantEdit::Kind::Update:
+        validateQuantity(edit.plant.getQuantity());
+        validatePrice(edit.plant.getPrice());
+        return make_unique<UpdatePlantCommand>(repository.get(), repository->getPlantByName(edit.plant.getName()),
+                                               edit.plant);
+    case PlantEdit::Kind::Remove:
+        return make_unique<RemovePlantCommand>(repository.get(), repository->getPlantByName(edit.plant.getName()));
+    }
+    throw invalid_argument("Unknown edit kind");
+}
+
+// Executes the edits one by one into a composite command. Commands are built
+// as they run, since an edit may refer to a plant added by an earlier one.
+void PlantController::applyEdits(const vector<PlantEdit> &edits) {
+    if (edits.empty()) return;
+
+    write([&] {
+        bool ownBatch = !repository->inBatch();
+        if (ownBatch) repository->beginBatch();
+        auto composite = make_unique<CompositeCommand>();
+        try {
+            for (const PlantEdit &edit : edits) {
+                auto cmd = makeCommand(edit);
+                cmd->execute();
+                composite->append(move(cmd));
+            }
+        } catch (...) {
+            if (ownBatch) repository->rollback();
+            else composite->undo();
+            throw;
+        }
+        if (ownBatch) repository->commit(); // Rolls back and rethrows if the write fails
+        record(move(composite), false);
+    });
 }
 
 // Undoes the last command, if available. Moves it to the redo stack
 void PlantController::undo() {
-    if (undoStack.empty()) { throw runtime_error("Nothing to undo"); }
-    auto cmd = move(undoStack.top());
-    undoStack.pop();
-    cmd->undo();
-    redoStack.push(move(cmd));
+    write([&] {
+        if (repository->inBatch()) { throw runtime_error("Cannot undo while a batch is in progress"); }
+        if (undoStack.empty()) { throw runtime_error("Nothing to undo"); }
+        PlantRepository::Batch batch(*repository);
+        undoStack.back()->undo();
+        batch.commit();
+        redoStack.push(move(undoStack.back()));
+        undoStack.pop_back();
+        coalesceOpen = false;
+    });
 }
 
 // Redoes the last undone command, if available. Moves it back to the undo stack
 void PlantController::redo() {
-    if (redoStack.empty()) { throw runtime_error("Nothing to redo"); }
-    auto cmd = move(redoStack.top());
-    redoStack.pop();
-    cmd->execute();
-    undoStack.push(move(cmd));
+    write([&] {
+        if (repository->inBatch()) { throw runtime_error("Cannot redo while a batch is in progress"); }
+        if (redoStack.empty()) { throw runtime_error("Nothing to redo"); }
+        PlantRepository::Batch batch(*repository);
+        redoStack.top()->execute();
+        batch.commit();
+        undoStack.push_back(move(redoStack.top()));
+        redoStack.pop();
+        coalesceOpen = false;
+    });
+}
+
+// Starts a repository batch and remembers the undo/redo history
+void PlantController::beginBatch() {
+    write([&] {
+        repository->beginBatch();
+        batchUndoDepth = undoStack.size();
+        batchRedoStack = move(redoStack);
+        redoStack = {};
+    });
+}
+
+// Persists the batch; its commands stay on the undo stack.
+// If the write fails the repository has rolled back, so the history is restored too.
+void PlantController::commitBatch() {
+    write([&] {
+        try {
+            repository->commit();
+        } catch (...) {
+            discardBatchHistory();
+            throw;
+        }
+        clearHistory(batchRedoStack);
+        coalesceOpen = false;
+    });
+}
+
+// Discards the batch and the undo entries it created
+void PlantController::rollbackBatch() {
+    write([&] {
+        repository->rollback();
+        discardBatchHistory();
+    });
+}
+
+// Pops the commands pushed during the batch and restores the redo stack
+void PlantController::discardBatchHistory() {
+    while (undoStack.size() > batchUndoDepth) {
+        historyBytes -= undoStack.back()->memoryUsage();
+        undoStack.pop_back();
+    }
+    clearHistory(redoStack);
+    redoStack = move(batchRedoStack);
+    batchRedoStack = {};
+    coalesceOpen = false;
 }
 
 // Returns a vector with all plants from the repository
-vector<Plant> PlantController::getAllPlants() const { return repository->getAllPlants(); }
+vector<Plant> PlantController::getAllPlants() const {
+    auto guard = readLock();
+    return repository->getAllPlants();
+}
 
 // Returns a specific plant by name or throws if not found
-Plant PlantController::getPlantByName(const string &name) const { return repository->getPlantByName(name); }
+Plant PlantController::getPlantByName(const string &name) const {
+    auto guard = readLock();
+    return repository->getPlantByName(name);
+}
 
 // Returns plants where either name or species contains the search term
-vector<Plant> PlantController::searchPlants(const string &searchTerm) const {
-    vector<Plant> allPlants = repository->getAllPlants();
+// Only matching plants are copied
+vector<Plant> PlantController::searchPlants(const string &searchTerm, bool ignoreCase) const {
+    auto guard = readLock();
     vector<Plant> matchingPlants;
 
-    for (const auto &plant : allPlants) {
-        if (plant.getName().find(searchTerm) != string::npos ||
-            plant.getSpecies().find(searchTerm) != string::npos) {
-            matchingPlants.push_back(plant);
+    // Fetching a match by name costs several times more than visiting a plant, so
+    // a term matching more than 1/16 of the inventory is answered by the scan below
+    vector<uint64_t> matches;
+    if (index.search(searchTerm, ignoreCase, stats.getPlantCount() / 16, matches)) {
+        matchingPlants.reserve(matches.size());
+        for (uint64_t sequence : matches)
+            matchingPlants.push_back(repository->getPlantByName(index.nameOf(sequence)));
+        return matchingPlants;
+    }
+
+    // Too short for the trigram index, or too many matches
+    string foldedTerm = TrigramIndex::fold(searchTerm);
+    return ParallelScan::collect(*repository, scanPool(), [&](const Plant &plant) {
+        return ignoreCase
+            ? TrigramIndex::containsFolded(plant.getName(), foldedTerm) ||
+                  TrigramIndex::containsFolded(plant.getSpecies(), foldedTerm)
+            : plant.getName().find(searchTerm) != string::npos || plant.getSpecies().find(searchTerm) != string::npos;
+    });
+}
+
+// Engages the lock only in concurrent mode; passing the writer gate first
+// makes new readers queue behind a waiting writer
+shared_lock<shared_mutex> PlantController::readLock() const {
+    if (!writerQueue) return {};
+    { lock_guard<mutex> gate(writerGate); }
+    return shared_lock<shared_mutex>(stateLock);
+}
+
+// Mutations queued from other threads run on the writer thread; ones issued
+// on it (nested) or outside concurrent mode run right away
+void PlantController::write(const function<void()> &mutation) {
+    // A failed mutation may have changed plants before rolling back, so publish either way
+    auto apply = [this, &mutation] {
+        try {
+            mutation();
+        } catch (...) {
+            snapshots.publish();
+            throw;
         }
+        snapshots.publish();
+    };
+    if (!writerQueue || writerQueue->onWriterThread()) {
+        apply();
+        return;
     }
-    return matchingPlants;
+    writerQueue->submit([this, &apply] {
+        unique_lock<shared_mutex> guard = [this] {
+            lock_guard<mutex> gate(writerGate);
+            return unique_lock<shared_mutex>(stateLock);
+        }();
+        apply();
+    }).get();
+}
+
+// Starts the writer thread
+void PlantController::enableConcurrentAccess() {
+    if (!writerQueue) writerQueue = make_unique<WriterQueue>();
+}
+
+// The shared pool once the inventory reaches the parallel threshold
+WorkStealingPool *PlantController::scanPool() const {
+    return stats.getPlantCount() >= parallelMinPlants ? &WorkStealingPool::shared() : nullptr;
 }
 
 // Returns the total value of inventory
 double PlantController::getTotalInventoryValue() const {
-    double totalValue = 0;
-    for (const auto &plant : repository->getAllPlants()) {
-        totalValue += plant.getQuantity() * plant.getPrice();
-    }
-    return totalValue;
+    auto guard = readLock();
+    if (statsCrossCheck) stats.verify();
+    return stats.getTotalValue();
 }
 
 // Returns the sum of all plant quantities
 int PlantController::getTotalQuantity() const {
-    int totalQuantity = 0;
-    for (const auto &plant : repository->getAllPlants()) {
-        totalQuantity += plant.getQuantity();
-    }
-    return totalQuantity;
+    auto guard = readLock();
+    if (statsCrossCheck) stats.verify();
+    return static_cast<int>(stats.getTotalQuantity());
 }
 
 // Returns the number of unique plants
-int PlantController::getTotalUniquePlants() const { return repository->getAllPlants().size(); }
+int PlantController::getTotalUniquePlants() const {
+    auto guard = readLock();
+    if (statsCrossCheck) stats.verify();
+    return static_cast<int>(stats.getPlantCount());
+}
+
+// Reads the incrementally maintained species groups
+vector<GroupTotals> PlantController::getSpeciesTotals() const {
+    auto guard = readLock();
+    if (statsCrossCheck) speciesStats.verify();
+    return speciesStats.all();
+}
+
+// Reads one species group
+GroupTotals PlantController::getSpeciesTotals(const string &species) const {
+    auto guard = readLock();
+    if (statsCrossCheck) speciesStats.verify();
+    return speciesStats.of(species);
+}
+
+// Aggregates all plants by the given key
+vector<GroupTotals> PlantController::groupPlants(const function<string(const Plant&)> &key) const {
+    auto guard = readLock();
+    return SpeciesStats::groupBy(*repository, scanPool(), key);
+}
+
+// Returns the plants of a species through the species index
+vector<Plant> PlantController::getPlantsBySpecies(const string &species) const {
+    auto guard = readLock();
+    vector<Plant> result;
+    result.reserve(index.countBySpecies(species));
+    for (uint64_t sequence : index.plantsOfSpecies(species))
+        result.push_back(repository->getPlantByName(index.nameOf(sequence)));
+    return result;
+}
+
+// Returns the plants priced in [minPrice, maxPrice] in ascending price order
+vector<Plant> PlantController::getPlantsByPriceRange(double minPrice, double maxPrice) const {
+    auto guard = readLock();
+    vector<Plant> result;
+    visitByPrice(minPrice, maxPrice, [&result](const Plant &plant) { result.push_back(plant); });
+    return result;
+}
+
+// Streams the plants priced in [minPrice, maxPrice] in ascending price order
+void PlantController::forEachPlantByPrice(double minPrice, double maxPrice,
+                                          const function<void(const Plant&)> &visitor) const {
+    auto guard = readLock();
+    visitByPrice(minPrice, maxPrice, visitor);
+}
+
+// Walks the price index; the caller holds the read lock
+void PlantController::visitByPrice(double minPrice, double maxPrice,
+                                   const function<void(const Plant&)> &visitor) const {
+    index.forEachInPriceRange(minPrice, maxPrice, [&](uint64_t sequence) {
+        visitor(repository->getPlantByName(index.nameOf(sequence)));
+    });
+}
+
+// Returns the plants with at least minQuantity units in ascending quantity order
+vector<Plant> PlantController::getPlantsByMinQuantity(int minQuantity) const {
+    auto guard = readLock();
+    vector<Plant> result;
+    index.forEachWithMinQuantity(minQuantity, [&](uint64_t sequence) {
+        result.push_back(repository->getPlantByName(index.nameOf(sequence)));
+    });
+    return result;
+}
 
 // Filters plants using a vector of PlantFilters
 // If filters is empty, returns all plants
@@ -128,28 +420,113 @@ int PlantController::getTotalUniquePlants() const { return repository->getAllPla
 vector<Plant> PlantController::filterPlants(
     const vector<shared_ptr<PlantFilter>>& filters, bool useAnd) const
 {
-    vector<Plant> allPlants = repository->getAllPlants();
-    vector<Plant> result;
-
+    auto guard = readLock();
     if (filters.empty())
-        return allPlants;
+        return repository->getAllPlants();
 
-    // Combine filters using AND/OR composite filter
-    shared_ptr<PlantFilter> combined;
-    if (useAnd)
-        combined = make_shared<AndPlantFilter>(filters);
-    else
-        combined = make_shared<OrPlantFilter>(filters);
+    FilterPlanner planner(*repository, index, columns, stats.getPlantCount(), scanPool());
+    return planner.execute(planner.plan(filters, useAnd));
+}
 
-    // Collect only plants that match the combined filter
-    for (const auto& plant : allPlants)
-        if (combined->matches(plant))
-            result.push_back(plant);
+// Plans and runs the filters, returning the plan text and row counts
+FilterExplanation PlantController::explainFilter(
+    const vector<shared_ptr<PlantFilter>>& filters, bool useAnd) const
+{
+    auto guard = readLock();
+    FilterExplanation explanation;
+    if (filters.empty()) {
+        explanation.plan = "no filters: all plants\n";
+        explanation.estimatedRows = explanation.actualRows = stats.getPlantCount();
+        return explanation;
+    }
 
-    return result;
+    FilterPlanner planner(*repository, index, columns, stats.getPlantCount(), scanPool());
+    FilterPlan plan = planner.plan(filters, useAnd);
+    explanation.plan = plan.describe();
+    explanation.estimatedRows = plan.estimatedRows;
+    explanation.actualRows = planner.execute(plan).size();
+    return explanation;
 }
 
+// Sums the matching plants on the columns when every filter has a column
+// kernel, and over filterPlants otherwise
+FilterTotals PlantController::getFilterTotals(
+    const vector<shared_ptr<PlantFilter>>& filters, bool useAnd) const
+{
+    auto guard = readLock();
+    FilterPlanner planner(*repository, index, columns, stats.getPlantCount(), scanPool());
+    // No filters select every plant, as in filterPlants
+    if (auto rows = planner.selectRows(filters, useAnd || filters.empty())) {
+        return {rows->count(), columns.sumQuantity(*rows), columns.sumValue(*rows)};
+    }
 
+    FilterTotals totals;
+    for (const Plant &plant : planner.execute(planner.plan(filters, useAnd))) {
+        ++totals.plants;
+        totals.quantity += plant.getQuantity();
+        totals.value += plant.getQuantity() * plant.getPrice();
+    }
+    return totals;
+}
 
+// Looks the query up in the cache, compiling and caching it if missing
+shared_ptr<const QueryProgram> PlantController::compiledQuery(const string &text) const {
+    lock_guard<mutex> cacheGuard(queryCacheLock);
+    auto it = queryCache.find(text);
+    if (it != queryCache.end()) return it->second;
 
+    auto program = make_shared<const QueryProgram>(QueryProgram::compile(text));
+    if (queryCache.size() >= queryCacheCapacity) queryCache.clear();
+    queryCache.emplace(text, program);
+    return program;
+}
 
+// Runs the compiled query over every plant
+vector<Plant> PlantController::query(const string &text) const {
+    auto guard = readLock();
+    auto program = compiledQuery(text);
+    return ParallelScan::collect(*repository, scanPool(), [&program](const Plant &plant) {
+        return program->matches(plant);
+    });
+}
+
+// Reads the page from an index when one orders by the key, else selects it from a scan
+vector<Plant> PlantController::getPlantsPage(const PlantPageRequest &request) const {
+    auto guard = readLock();
+    return orderedPage(request);
+}
+
+// Index order for price, quantity and species, top-K selection otherwise
+vector<Plant> PlantController::orderedPage(const PlantPageRequest &request) const {
+    optional<vector<uint64_t>> sequences;
+    if (request.key == PlantSortKey::Price)
+        sequences = index.pageByPrice(request.descending, request.offset, request.limit);
+    else if (request.key == PlantSortKey::Quantity)
+        sequences = index.pageByQuantity(request.descending, request.offset, request.limit);
+    else if (request.key == PlantSortKey::Species)
+        sequences = index.pageBySpecies(request.descending, request.offset, request.limit);
+
+    if (sequences) {
+        vector<Plant> page;
+        page.reserve(sequences->size());
+        for (uint64_t sequence : *sequences) page.push_back(repository->getPlantByName(index.nameOf(sequence)));
+        return page;
+    }
+
+    TopKSelector selector(request);
+    repository->forEachPlant([&selector](const Plant &plant) { selector.offer(plant); });
+    return selector.takePage();
+}
+
+// Streams the matches of the filter plan into a top-K selection
+vector<Plant> PlantController::getPlantsPage(
+    const PlantPageRequest &request, const vector<shared_ptr<PlantFilter>> &filters, bool useAnd) const
+{
+    auto guard = readLock();
+    if (filters.empty()) return orderedPage(request);
+
+    FilterPlanner planner(*repository, index, columns, stats.getPlantCount());
+    TopKSelector selector(request);
+    planner.visit(planner.plan(filters, useAnd), [&selector](const Plant &plant) { selector.offer(plant); });
+    return selector.takePage();
+}
@@ -1,12 +1,30 @@
 #pragma once
 #include "../Model/plant.h"
 #include "../Repository/plant_repository.h"
+#include "../Repository/plant_columns.h"
 #include "command.h"
 #include "filter.h"
+#include "filter_expression.h"
+#include "filter_planner.h"
+#include "group_stats.h"
+#include "inventory_snapshot.h"
+#include "inventory_stats.h"
+#include "parallel_scan.h"
+#include "plant_index.h"
+#include "plant_page.h"
+#include "plant_query.h"
+#include "writer_queue.h"
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <stack>
+#include <unordered_map>
 #include <string>
 #include <stdexcept>
 
@@ -17,10 +35,92 @@ private:
     // The repository (CSV, JSON, etc.) where the plants are stored
     unique_ptr<PlantRepository> repository;
 
-    // Undo/Redo stacks
-    stack<unique_ptr<Command>> undoStack;
+    // Totals maintained from the repository's change notifications
+    InventoryStats stats;
+
+    // Per-species aggregates, maintained the same way
+    SpeciesStats speciesStats;
+
+    // When set, every statistics read is checked against a full scan
+    atomic<bool> statsCrossCheck{false};
+
+    // Secondary indexes (species, price, quantity, substring), maintained like the statistics
+    PlantIndex index;
+
+    // Column copy of the plants for vectorized filters and sums
+    PlantColumns columns;
+
+    // Immutable versions of the inventory, published after every mutation
+    SnapshotPublisher snapshots;
+
+    // Scans run on the shared pool from this many plants on (SIZE_MAX = never)
+    atomic<size_t> parallelMinPlants{SIZE_MAX};
+
+    // Returns the pool for a scan, or nullptr to scan on the calling thread
+    WorkStealingPool *scanPool() const;
+
+    // Compiled queries by query text; cleared when it reaches queryCacheCapacity.
+    // Readers share it, so it has its own lock.
+    mutable mutex queryCacheLock;
+    mutable unordered_map<string, shared_ptr<const QueryProgram>> queryCache;
+    static constexpr size_t queryCacheCapacity = 256;
+
+    // Returns the compiled program of a query, compiling it on first use
+    shared_ptr<const QueryProgram> compiledQuery(const string &text) const;
+
+    // Undo/Redo stacks; the undo side is a deque so the oldest entries can be dropped
+    deque<unique_ptr<Command>> undoStack;
     stack<unique_ptr<Command>> redoStack;
 
+    // Bounds of the undo history and the bytes its entries hold
+    UndoHistoryLimits historyLimits;
+    size_t historyBytes = 0;
+
+    // State saved by beginBatch so rollbackBatch can restore the history
+    size_t batchUndoDepth = 0;
+    stack<unique_ptr<Command>> batchRedoStack;
+
+    // Set while the top undo entry was pushed or merged by the last record();
+    // undo, redo, batch ends and bulk edits close it, so finished edits stay apart
+    bool coalesceOpen = false;
+
+    // Pushes (or coalesces) an executed command, clears the redo stack and
+    // trims the history to its limits; coalesce = false keeps the command, and
+    // the next one, in entries of their own
+    void record(unique_ptr<Command> cmd, bool coalesce = true);
+
+    // Validates an edit and builds its command (not executed yet)
+    unique_ptr<Command> makeCommand(const PlantEdit &edit) const;
+
+    // Drops the oldest undo entries until the history fits its limits
+    void trimHistory();
+
+    // Pops all commands of a stack, releasing their bytes from the history
+    void clearHistory(stack<unique_ptr<Command>> &commands);
+
+    // Drops the undo entries of a failed or rolled back batch
+    void discardBatchHistory();
+
+    // Concurrent mode: readers hold stateLock shared, the writer queue's tasks
+    // hold it exclusively. A waiting writer holds writerGate, which keeps new
+    // readers out so a steady stream of them cannot starve it.
+    mutable shared_mutex stateLock;
+    mutable mutex writerGate;
+    unique_ptr<WriterQueue> writerQueue;
+
+    // Shared lock on the state in concurrent mode, an empty lock otherwise
+    shared_lock<shared_mutex> readLock() const;
+
+    // Runs a mutation and publishes the resulting snapshot: directly, or on the
+    // writer queue under the exclusive lock (waiting for it and rethrowing its error)
+    void write(const function<void()> &mutation);
+
+    // getPlantsPage without locking
+    vector<Plant> orderedPage(const PlantPageRequest &request) const;
+
+    // forEachPlantByPrice without locking
+    void visitByPrice(double minPrice, double maxPrice, const function<void(const Plant&)> &visitor) const;
+
     // Validators
     void validateQuantity(int quantity) const;
     void validatePrice(double price) const;
@@ -29,30 +129,187 @@ public:
     // Constructor
     explicit PlantController(unique_ptr<PlantRepository> repository);
 
+    // The statistics are registered with the repository by address
+    PlantController(const PlantController&) = delete;
+    PlantController &operator=(const PlantController&) = delete;
+
+    // Destructor; unregisters the statistics, indexes, columns and snapshots from the repository
+    ~PlantController();
+
     // Core CRUD operations
     void addPlant(const string &name, const string &species, int quantity, double price);
     void removePlant(const string &name);
     void updatePlant(const string &name, const string &species, int quantity, double price);
 
-    // Undo/Redo
+    // Applies the edits in order as one unit, e.g. a delivery or a repricing:
+    // persisted with a single write (or as part of the open batch) and undone
+    // or redone by one undo()/redo(). If any edit fails, the ones before it are
+    // reverted and the error is rethrown.
+    void applyEdits(const vector<PlantEdit> &edits);
+
+    // Undo/Redo (not allowed while a batch is open); each runs in a repository
+    // batch, so a bulk edit is persisted once and is reverted as a whole
     void undo();
     void redo();
 
+    // Undo history bounds (entry count, bytes, update coalescing); lowering
+    // them drops the oldest entries right away
+    void setUndoHistoryLimits(const UndoHistoryLimits &limits);
+    UndoHistoryLimits getUndoHistoryLimits() const {
+        auto guard = readLock();
+        return historyLimits;
+    }
+
+    // Entries and bytes currently held by the undo and redo history
+    UndoHistoryUsage getUndoHistoryUsage() const {
+        auto guard = readLock();
+        return {undoStack.size(), redoStack.size(), historyBytes};
+    }
+
+    // Concurrent mode: reads (lookups, search, filters, queries, statistics,
+    // pages) may run on any number of threads at once under a shared lock,
+    // while mutations, batches and undo/redo are queued to a single writer
+    // thread and applied one at a time, in submission order, under an
+    // exclusive lock. A mutating call returns once its change is applied
+    // (rethrowing its error), so every read started afterwards sees it.
+    // Off by default. Switch it only while no other thread uses the
+    // controller. Visitors run under the read lock and must not call the
+    // controller at all: a nested read waits behind a queued writer, which
+    // waits for the outer read, and a nested mutation waits for both.
+    void enableConcurrentAccess();
+    void disableConcurrentAccess() { writerQueue.reset(); }
+    bool concurrentAccessEnabled() const { return writerQueue != nullptr; }
+
+    // Current version of the inventory with one atomic load and no lock, from
+    // any thread and in any mode. It never changes: iterate or export it while
+    // edits go on; it is freed when the last holder lets go. Published after
+    // each mutation call (a bulk edit appears at once), including those of an
+    // open batch.
+    shared_ptr<const InventorySnapshot> snapshot() const { return snapshots.current(); }
+
+    // Writes the current version to a file (format by extension: .csv, .json,
+    // .bin) without blocking edits; returns the number of plants written
+    size_t exportSnapshot(const string &path) const { return snapshot()->exportTo(path); }
+
+    // Write-behind persistence: waits until every mutation made so far is in
+    // the file (no-op for the other modes) and reports save latency and backlog
+    void flush() {
+        auto guard = readLock();
+        repository->flush();
+    }
+    PersistenceStats getPersistenceStats() const { return repository->persistenceStats(); }
+
+    // Batches: mutations between beginBatch and commitBatch are persisted with a
+    // single write; rollbackBatch discards them together with their undo entries.
+    // In concurrent mode an open batch collects the mutations of all threads;
+    // applyEdits is the atomic alternative.
+    void beginBatch();
+    void commitBatch();
+    void rollbackBatch();
+
     // Returns a vector with all plants
     vector<Plant> getAllPlants() const;
 
+    // Calls visitor for every plant without copying them (see PlantRepository::forEachPlant).
+    // The visitor must not call any controller method (see enableConcurrentAccess).
+    void forEachPlant(const function<void(const Plant&)> &visitor) const {
+        auto guard = readLock();
+        repository->forEachPlant(visitor);
+    }
+
     // Finds a plant by name
     Plant getPlantByName(const string &name) const;
 
-    // Returns all plants where name or species contains the searchTerm
-    vector<Plant> searchPlants(const string &searchTerm) const;
+    // Returns all plants where name or species contains the searchTerm,
+    // optionally ignoring ASCII case. Terms of three or more characters are
+    // answered from the trigram index; shorter ones scan all plants.
+    vector<Plant> searchPlants(const string &searchTerm, bool ignoreCase = false) const;
 
-    // Statistics
+    // Statistics; O(1), maintained incrementally
     double getTotalInventoryValue() const;
     int getTotalQuantity() const;
     int getTotalUniquePlants() const;
 
+    // Debug mode: verify the statistics against a full scan on every read
+    // (throws logic_error on a mismatch)
+    void setStatsCrossCheck(bool enabled) { statsCrossCheck = enabled; }
+
+    // Parallel mode: scans in filterPlants and searchPlants over inventories of
+    // at least minPlants plants are split into slot ranges and run on the
+    // shared work-stealing pool; results keep repository order. Off by default.
+    // Filters must then be safe to call concurrently (see filter.h).
+    void enableParallelScans(size_t minPlants = defaultParallelMinPlants) { parallelMinPlants = minPlants; }
+    void disableParallelScans() { parallelMinPlants = SIZE_MAX; }
+
+    // Below this size the partitioning costs more than it saves
+    static constexpr size_t defaultParallelMinPlants = 100000;
+
+    // Per-species count, quantity, value and min/max/average price, updated on
+    // every change (including undo, redo and rollback); species in alphabetical order
+    vector<GroupTotals> getSpeciesTotals() const;
+    GroupTotals getSpeciesTotals(const string &species) const;
+
+    // One-shot group-by over all plants with any key, e.g. price bands; runs
+    // on the shared pool in parallel mode. Groups are sorted by key.
+    vector<GroupTotals> groupPlants(const function<string(const Plant&)> &key) const;
+
+    // Species index: distinct species in alphabetical order, the number of
+    // plants of a species, and its plants in repository order
+    vector<string> getSpecies() const {
+        auto guard = readLock();
+        return index.species();
+    }
+    int countBySpecies(const string &species) const {
+        auto guard = readLock();
+        return static_cast<int>(index.countBySpecies(species));
+    }
+    vector<Plant> getPlantsBySpecies(const string &species) const;
+
+    // Price and quantity indexes: range lookups in O(log n + k), returned in
+    // ascending price (quantity) order. As with forEachPlant, the visitor must
+    // not call any controller method.
+    vector<Plant> getPlantsByPriceRange(double minPrice, double maxPrice) const;
+    void forEachPlantByPrice(double minPrice, double maxPrice, const function<void(const Plant&)> &visitor) const;
+    vector<Plant> getPlantsByMinQuantity(int minQuantity) const;
+
+    // Ordered pages (see PlantPageRequest); only the plants of the page are
+    // built. Species, quantity and price pages are read in index order; name
+    // and value pages are picked by top-K selection during one scan.
+    vector<Plant> getPlantsPage(const PlantPageRequest &request) const;
+
+    // Same, over the plants matching the filters (planned as in filterPlants)
+    vector<Plant> getPlantsPage(const PlantPageRequest &request, const vector<shared_ptr<PlantFilter>> &filters,
+                                bool useAnd = true) const;
+
+    // The count plants with the highest key, e.g. the 50 most valuable
+    vector<Plant> getTopPlants(PlantSortKey key, size_t count) const { return getPlantsPage({key, true, 0, count}); }
+
     // Returns plants that match all (AND) or any (OR) of the given filters
-    // By default, uses AND combination
+    // By default, uses AND combination. A FilterPlanner decides which indexes
+    // to use and in which order the filters are checked.
     vector<Plant> filterPlants(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd = true) const;
+
+    // Returns the plants matching a compile-time filter expression (see
+    // filter_expression.h), in repository order. The expression is inlined into
+    // the scan, so there is no virtual call per plant or per subfilter.
+    template <FilterExpression Expression>
+    vector<Plant> filterPlants(const Expression &expression) const {
+        auto guard = readLock();
+        return ParallelScan::collect(*repository, scanPool(), [&expression](const Plant &plant) {
+            return expression(plant);
+        });
+    }
+
+    // Returns the plants matching a text query (syntax in plant_query.h), in
+    // repository order. Throws invalid_argument on a syntax error. Compiled
+    // programs are cached by query text, so repeating a query skips parsing.
+    vector<Plant> query(const string &text) const;
+
+    // Runs filterPlants and reports the chosen plan with estimated and actual rows
+    FilterExplanation explainFilter(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd = true) const;
+
+    // Count, quantity and value of the plants matching the filters; price,
+    // quantity, stock and species filters are summed on the columns without
+    // building any Plant
+    FilterTotals getFilterTotals(const vector<shared_ptr<PlantFilter>> &filters, bool useAnd = true) const;
 };
@@ -0,0 +1,208 @@
+#include "plant_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Constructor
+PlantIndex::PlantIndex(const PlantRepository &repository) : repository(repository) { rebuild(); }
+
+// Numbers the plants again in repository order and refills every index
+void PlantIndex::rebuild() {
+    nextSequence = 0;
+    nextSpeciesId = 0;
+    sequenceByName.clear();
+    nameBySequence.clear();
+    bySpecies.clear();
+    speciesById.clear();
+    byPrice.clear();
+    byQuantity.clear();
+    nameTrigrams.clear();
+    speciesTrigrams.clear();
+    repository.forEachPlant([this](const Plant &plant) { plantAdded(plant); });
+}
+
+// Records the plant's species, price and quantity; a new species is also
+// added to the species trigram index
+void PlantIndex::insertAttributes(const Plant &plant, uint64_t sequence) {
+    auto [species, inserted] = bySpecies.try_emplace(plant.getSpecies());
+    if (inserted) {
+        species->second.id = nextSpeciesId++;
+        speciesById.emplace(species->second.id, &species->first);
+        speciesTrigrams.add(species->second.id, species->first);
+    }
+    species->second.plants.insert(sequence);
+    if (!isnan(plant.getPrice())) byPrice.emplace(plant.getPrice(), sequence);
+    byQuantity.emplace(plant.getQuantity(), sequence);
+}
+
+// Removes the plant's species, price and quantity entries; empty species are dropped
+void PlantIndex::eraseAttributes(const Plant &plant, uint64_t sequence) {
+    auto species = bySpecies.find(plant.getSpecies());
+    species->second.plants.erase(sequence);
+    if (species->second.plants.empty()) {
+        speciesTrigrams.remove(species->second.id);
+        speciesById.erase(species->second.id);
+        bySpecies.erase(species);
+    }
+    if (!isnan(plant.getPrice())) byPrice.erase({plant.getPrice(), sequence});
+    byQuantity.erase({plant.getQuantity(), sequence});
+}
+
+// New plants go to the end of the repository
+void PlantIndex::plantAdded(const Plant &plant) {
+    uint64_t sequence = nextSequence++;
+    sequenceByName[plant.getName()] = sequence;
+    nameBySequence[sequence] = plant.getName();
+    nameTrigrams.add(sequence, plant.getName());
+    insertAttributes(plant, sequence);
+}
+
+// Forgets a removed plant
+void PlantIndex::plantRemoved(const Plant &plant) {
+    auto it = sequenceByName.find(plant.getName());
+    uint64_t sequence = it->second;
+    sequenceByName.erase(it);
+    nameBySequence.erase(sequence);
+    nameTrigrams.remove(sequence);
+    eraseAttributes(plant, sequence);
+}
+
+// Updated plants keep their name and position, so only the attributes change
+void PlantIndex::plantUpdated(const Plant &oldPlant, const Plant &newPlant) {
+    uint64_t sequence = sequenceByName.at(oldPlant.getName());
+    eraseAttributes(oldPlant, sequence);
+    insertAttributes(newPlant, sequence);
+}
+
+// Returns the species names in order
+vector<string> PlantIndex::species() const {
+    vector<string> result;
+    result.reserve(bySpecies.size());
+    for (const auto &entry : bySpecies) result.push_back(entry.first);
+    return result;
+}
+
+// Returns how many plants have the given species
+size_t PlantIndex::countBySpecies(const string &species) const {
+    auto it = bySpecies.find(species);
+    return it == bySpecies.end() ? 0 : it->second.plants.size();
+}
+
+// Returns the plants of a species, or an empty set for an unknown species
+const set<uint64_t> &PlantIndex::plantsOfSpecies(const string &species) const {
+    static const set<uint64_t> none;
+    auto it = bySpecies.find(species);
+    return it == bySpecies.end() ? none : it->second.plants;
+}
+
+// Name matches come from the name trigrams; species matches contribute all
+// plants of every matching species. The trigram indexes match ignoring case,
+// so a case-sensitive search checks the original text as well.
+bool PlantIndex::search(const string &term, bool ignoreCase, size_t limit, vector<uint64_t> &matches) const {
+    string folded = TrigramIndex::fold(term);
+    vector<uint64_t> ids;
+    if (!nameTrigrams.search(folded, ids) || ids.size() > limit) return false;
+    for (uint64_t sequence : ids)
+        if (ignoreCase || nameBySequence.at(sequence).find(term) != string::npos) matches.push_back(sequence);
+
+    ids.clear();
+    speciesTrigrams.search(folded, ids);
+    bool speciesMatched = false;
+    for (uint64_t id : ids) {
+        const string &species = *speciesById.at(id);
+        if (!ignoreCase && species.find(term) == string::npos) continue;
+        const auto &plants = bySpecies.at(species).plants;
+        if (matches.size() + plants.size() > limit) return false;
+        matches.insert(matches.end(), plants.begin(), plants.end());
+        speciesMatched = true;
+    }
+    if (speciesMatched) {
+        ranges::sort(matches);
+        matches.erase(unique(matches.begin(), matches.end()), matches.end());
+    }
+    return true;
+}
+
+// Counts entries of the price index in the range, up to cap
+size_t PlantIndex::countInPriceRange(double minPrice, double maxPrice, size_t cap) const {
+    if (isnan(minPrice) || isnan(maxPrice)) return 0;
+    size_t count = 0;
+    for (auto it = byPrice.lower_bound({minPrice, 0}); it != byPrice.end() && it->first <= maxPrice && count < cap; ++it)
+        ++count;
+    return count;
+}
+
+// Counts entries of the quantity index in the range, up to cap
+size_t PlantIndex::countInQuantityRange(int minQuantity, int maxQuantity, size_t cap) const {
+    size_t count = 0;
+    for (auto it = byQuantity.lower_bound({minQuantity, 0});
+         it != byQuantity.end() && it->first <= maxQuantity && count < cap; ++it)
+        ++count;
+    return count;
+}
+
+// The shortest posting list of the folded term bounds the name matches
+optional<size_t> PlantIndex::estimateNameMatches(const string &term) const {
+    return nameTrigrams.estimate(TrigramIndex::fold(term));
+}
+
+// Folded trigram matches, checked against the original names
+bool PlantIndex::searchNames(const string &term, vector<uint64_t> &matches) const {
+    vector<uint64_t> ids;
+    if (!nameTrigrams.search(TrigramIndex::fold(term), ids)) return false;
+    for (uint64_t sequence : ids)
+        if (nameBySequence.at(sequence).find(term) != string::npos) matches.push_back(sequence);
+    return true;
+}
+
+// Walks [first, last) skipping offset entries and keeping the sequence of up to limit
+template <typename Iterator, typename Sequence>
+static void takePage(Iterator first, Iterator last, size_t &offset, size_t limit, vector<uint64_t> &page,
+                     Sequence sequence) {
+    for (; first != last && page.size() < limit; ++first) {
+        if (offset > 0) --offset;
+        else page.push_back(sequence(*first));
+    }
+}
+
+// Reads one page of an ordered (value, sequence) index
+template <typename Entries>
+static vector<uint64_t> pageOf(const Entries &entries, bool descending, size_t offset, size_t limit) {
+    vector<uint64_t> page;
+    auto sequence = [](const auto &entry) { return entry.second; };
+    if (descending) takePage(entries.rbegin(), entries.rend(), offset, limit, page, sequence);
+    else takePage(entries.begin(), entries.end(), offset, limit, page, sequence);
+    return page;
+}
+
+// Price order, unless NaN prices are missing from the index
+optional<vector<uint64_t>> PlantIndex::pageByPrice(bool descending, size_t offset, size_t limit) const {
+    if (byPrice.size() != sequenceByName.size()) return nullopt;
+    return pageOf(byPrice, descending, offset, limit);
+}
+
+// Quantity order
+vector<uint64_t> PlantIndex::pageByQuantity(bool descending, size_t offset, size_t limit) const {
+    return pageOf(byQuantity, descending, offset, limit);
+}
+
+// Species in alphabetical order; species entirely before the page are skipped by size
+vector<uint64_t> PlantIndex::pageBySpecies(bool descending, size_t offset, size_t limit) const {
+    vector<uint64_t> page;
+    auto identity = [](uint64_t sequence) { return sequence; };
+    auto visit = [&](const SpeciesEntry &entry) {
+        if (offset >= entry.plants.size()) {
+            offset -= entry.plants.size();
+            return;
+        }
+        if (descending) takePage(entry.plants.rbegin(), entry.plants.rend(), offset, limit, page, identity);
+        else takePage(entry.plants.begin(), entry.plants.end(), offset, limit, page, identity);
+    };
+    if (descending) {
+        for (auto it = bySpecies.rbegin(); it != bySpecies.rend() && page.size() < limit; ++it) visit(it->second);
+    } else {
+        for (auto it = bySpecies.begin(); it != bySpecies.end() && page.size() < limit; ++it) visit(it->second);
+    }
+    return page;
+}
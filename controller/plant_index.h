@@ -0,0 +1,131 @@
+#pragma once
+#include "../Model/plant.h"
+#include "../Repository/plant_repository.h"
+#include "trigram_index.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Secondary indexes over the plants of a repository, kept current through its
+// change notifications.
+//
+// Every plant gets a sequence number when it is added. Repositories keep
+// plants in insertion order (updates stay in place, re-added plants go to the
+// end), so sequence numbers follow repository order and index lookups return
+// plants in the same order as a full scan would.
+class PlantIndex : public PlantRepository::Listener {
+private:
+    const PlantRepository &repository;
+    uint64_t nextSequence = 0;
+
+    unordered_map<string, uint64_t> sequenceByName;
+    unordered_map<uint64_t, string> nameBySequence;
+
+    // Species -> sequence numbers of its plants, ordered by species name.
+    // Each species also gets an id for the species trigram index.
+    struct SpeciesEntry {
+        uint64_t id;
+        set<uint64_t> plants;
+    };
+    map<string, SpeciesEntry> bySpecies;
+    unordered_map<uint64_t, const string *> speciesById; // Points at keys of bySpecies
+    uint64_t nextSpeciesId = 0;
+
+    // Substring search: names by sequence number, distinct species by id
+    TrigramIndex nameTrigrams;
+    TrigramIndex speciesTrigrams;
+
+    // (price, sequence) and (quantity, sequence) in ascending order. Plants
+    // with a NaN price match no price range, so they are left out.
+    set<pair<double, uint64_t>> byPrice;
+    set<pair<int, uint64_t>> byQuantity;
+
+    // Adds or removes the species, price and quantity entries of a plant
+    void insertAttributes(const Plant &plant, uint64_t sequence);
+    void eraseAttributes(const Plant &plant, uint64_t sequence);
+
+public:
+    // Constructor; indexes all plants with one scan
+    explicit PlantIndex(const PlantRepository &repository);
+
+    // Drops everything and indexes the repository again
+    void rebuild();
+
+    // Listener callbacks
+    void plantAdded(const Plant &plant) override;
+    void plantRemoved(const Plant &plant) override;
+    void plantUpdated(const Plant &oldPlant, const Plant &newPlant) override;
+    void plantsReset() override { rebuild(); }
+
+    // Returns the name of the plant with the given sequence number
+    const string &nameOf(uint64_t sequence) const { return nameBySequence.at(sequence); }
+
+    // Returns the distinct species in alphabetical order
+    vector<string> species() const;
+
+    // Returns the number of plants of a species
+    size_t countBySpecies(const string &species) const;
+
+    // Returns the sequence numbers of a species' plants in repository order
+    const set<uint64_t> &plantsOfSpecies(const string &species) const;
+
+    // Collects, in repository order, the plants whose name or species contains
+    // term, optionally ignoring ASCII case. Returns false if the term is too
+    // short for the trigram index or more than limit plants match, in which
+    // case the caller has to scan.
+    bool search(const string &term, bool ignoreCase, size_t limit, vector<uint64_t> &matches) const;
+
+    // Calls visitor(sequence) for every plant priced in [minPrice, maxPrice],
+    // in ascending price order; O(log n + k)
+    template <typename Visitor>
+    void forEachInPriceRange(double minPrice, double maxPrice, Visitor &&visitor) const {
+        if (isnan(minPrice) || isnan(maxPrice)) return;
+        for (auto it = byPrice.lower_bound({minPrice, 0}); it != byPrice.end() && it->first <= maxPrice; ++it)
+            visitor(it->second);
+    }
+
+    // Calls visitor(sequence) for every plant with a quantity in
+    // [minQuantity, maxQuantity], in ascending quantity order; O(log n + k)
+    template <typename Visitor>
+    void forEachInQuantityRange(int minQuantity, int maxQuantity, Visitor &&visitor) const {
+        for (auto it = byQuantity.lower_bound({minQuantity, 0}); it != byQuantity.end() && it->first <= maxQuantity; ++it)
+            visitor(it->second);
+    }
+
+    // Calls visitor(sequence) for every plant with at least minQuantity units
+    template <typename Visitor>
+    void forEachWithMinQuantity(int minQuantity, Visitor &&visitor) const {
+        forEachInQuantityRange(minQuantity, numeric_limits<int>::max(), visitor);
+    }
+
+    // Count the plants in a price or quantity range, stopping at cap, so
+    // estimating a broad range stays cheap
+    size_t countInPriceRange(double minPrice, double maxPrice, size_t cap) const;
+    size_t countInQuantityRange(int minQuantity, int maxQuantity, size_t cap) const;
+
+    // Ordered pages: up to limit sequence numbers after skipping offset, by
+    // price, quantity or species with ties in repository order. Descending is
+    // the exact reverse of ascending. Costs O(offset + limit) (species skip
+    // whole species at once). pageByPrice returns nullopt while some plant
+    // has a NaN price, since those are not in the price index.
+    optional<vector<uint64_t>> pageByPrice(bool descending, size_t offset, size_t limit) const;
+    vector<uint64_t> pageByQuantity(bool descending, size_t offset, size_t limit) const;
+    vector<uint64_t> pageBySpecies(bool descending, size_t offset, size_t limit) const;
+
+    // Returns an upper bound of the plants whose name contains term, or
+    // nullopt if the term is too short for the trigram index
+    optional<size_t> estimateNameMatches(const string &term) const;
+
+    // Collects, in repository order, the plants whose name contains term
+    // (case-sensitive). Returns false if the term is too short for the index.
+    bool searchNames(const string &term, vector<uint64_t> &matches) const;
+};
@@ -0,0 +1,63 @@
+#include "plant_page.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+// -1, 0 or 1 for a < b, a == b, a > b, with NaN after every number
+static int compareNumbers(double a, double b) {
+    if (isnan(a) || isnan(b)) return isnan(a) - isnan(b);
+    return (a > b) - (a < b);
+}
+
+// Compares the sort key of two plants
+static int compareKeys(PlantSortKey key, const Plant &a, const Plant &b) {
+    switch (key) {
+    case PlantSortKey::Name: return a.getName().compare(b.getName());
+    case PlantSortKey::Species: return a.getSpecies().compare(b.getSpecies());
+    case PlantSortKey::Quantity: return (a.getQuantity() > b.getQuantity()) - (a.getQuantity() < b.getQuantity());
+    case PlantSortKey::Price: return compareNumbers(a.getPrice(), b.getPrice());
+    case PlantSortKey::Value: return compareNumbers(a.getQuantity() * a.getPrice(), b.getQuantity() * b.getPrice());
+    }
+    return 0;
+}
+
+// Constructor; the heap never holds more than offset + limit plants
+TopKSelector::TopKSelector(const PlantPageRequest &request)
+    : request(request), capacity(request.limit > SIZE_MAX - request.offset ? SIZE_MAX : request.offset + request.limit) {}
+
+// Key first, then position; descending reverses both
+bool TopKSelector::before(const Plant &a, size_t positionA, const Plant &b, size_t positionB) const {
+    int order = compareKeys(request.key, a, b);
+    if (order == 0) order = (positionA > positionB) - (positionA < positionB);
+    return request.descending ? order > 0 : order < 0;
+}
+
+// Replaces the worst kept plant when the new one comes before it
+void TopKSelector::offer(const Plant &plant) {
+    size_t position = offered++;
+    if (capacity == 0) return;
+    auto worstLast = [this](const Entry &a, const Entry &b) { return before(a.plant, a.position, b.plant, b.position); };
+    if (heap.size() < capacity) {
+        heap.push_back({plant, position});
+        push_heap(heap.begin(), heap.end(), worstLast);
+        return;
+    }
+    if (!before(plant, position, heap.front().plant, heap.front().position)) return;
+    pop_heap(heap.begin(), heap.end(), worstLast);
+    heap.back() = {plant, position};
+    push_heap(heap.begin(), heap.end(), worstLast);
+}
+
+// Sorts the kept plants and drops the ones before the offset
+vector<Plant> TopKSelector::takePage() {
+    sort_heap(heap.begin(), heap.end(),
+              [this](const Entry &a, const Entry &b) { return before(a.plant, a.position, b.plant, b.position); });
+    vector<Plant> page;
+    page.reserve(heap.size() > request.offset ? heap.size() - request.offset : 0);
+    for (size_t i = request.offset; i < heap.size(); ++i) page.push_back(move(heap[i].plant));
+    heap.clear();
+    return page;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "../Model/plant.h"
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// Attribute a page of plants is ordered by; Value is quantity * price
+enum class PlantSortKey { Name, Species, Quantity, Price, Value };
+
+// One page of an ordered result: plants [offset, offset + limit) of the order.
+// Ties are broken by repository order, and descending is the exact reverse of
+// ascending. NaN prices and values sort after every number.
+struct PlantPageRequest {
+    PlantSortKey key = PlantSortKey::Name;
+    bool descending = false;
+    size_t offset = 0;
+    size_t limit = 50;
+};
+
+// Top-K selection over plants offered in repository order.
+//
+// Keeps the first offset + limit plants of the requested order in a bounded
+// max-heap whose top is the worst plant kept, so each offer costs one
+// comparison unless the plant beats it, and only kept plants are copied.
+// Selecting k of n plants costs O(n log k) time and O(k) memory.
+class TopKSelector {
+private:
+    struct Entry {
+        Plant plant;
+        size_t position; // Offer order, i.e. repository order
+    };
+
+    PlantPageRequest request;
+    size_t capacity;
+    size_t offered = 0;
+    vector<Entry> heap;
+
+    // True if a comes before b in the requested order
+    bool before(const Plant &a, size_t positionA, const Plant &b, size_t positionB) const;
+
+public:
+    // Constructor
+    explicit TopKSelector(const PlantPageRequest &request);
+
+    // Considers the next plant
+    void offer(const Plant &plant);
+
+    // Returns the requested page in order; the selector is left empty
+    vector<Plant> takePage();
+};
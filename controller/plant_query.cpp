@@ -0,0 +1,268 @@
+#include "plant_query.h"
+#include "trigram_index.h"
+
+#include <cctype>
+#include <charconv>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+// Recursive-descent parser that emits instructions straight into a program
+class QueryParser {
+private:
+    enum class TokenType { Word, String, Number, Operator, OpenParen, CloseParen, End };
+
+    struct Token {
+        TokenType type;
+        string text;    // Word (folded), String (unescaped), Operator
+        double number = 0;
+        size_t column;  // 1-based, for error messages
+    };
+
+    const string &text;
+    size_t position = 0;
+    Token current;
+    QueryProgram &program;
+
+    // Throws an error pointing at a column of the query
+    [[noreturn]] void fail(size_t column, const string &message) const {
+        throw invalid_argument("Query error at column " + to_string(column) + ": " + message);
+    }
+
+    // Reads the next token into current
+    void advance();
+
+    // Consumes the current token if it is the given keyword
+    bool acceptWord(const char *word) {
+        if (current.type != TokenType::Word || current.text != word) return false;
+        advance();
+        return true;
+    }
+
+    // Appends an instruction and returns its index
+    uint32_t emit(QueryProgram::OpCode op, QueryProgram::Comparison comparison = QueryProgram::Comparison::Equal,
+                  uint32_t operand = 0) {
+        program.code.push_back({op, comparison, operand});
+        return static_cast<uint32_t>(program.code.size() - 1);
+    }
+
+    // Points the given jumps at the next instruction
+    void patch(const vector<uint32_t> &jumps) {
+        for (uint32_t jump : jumps) program.code[jump].operand = static_cast<uint32_t>(program.code.size());
+    }
+
+    void parseOr();
+    void parseAnd();
+    void parseUnary();
+    void parseComparison();
+
+public:
+    QueryParser(const string &text, QueryProgram &program) : text(text), program(program) {}
+
+    // Compiles the whole query
+    void parse() {
+        advance();
+        if (current.type == TokenType::End) fail(1, "empty query");
+        parseOr();
+        if (current.type != TokenType::End) fail(current.column, "unexpected '" + current.text + "'");
+    }
+};
+
+// Splits words, quoted strings, numbers, operators and parentheses
+void QueryParser::advance() {
+    while (position < text.size() && isspace(static_cast<unsigned char>(text[position]))) ++position;
+    current = Token{TokenType::End, "", 0, position + 1};
+    if (position >= text.size()) return;
+
+    char c = text[position];
+    if (c == '(' || c == ')') {
+        current.type = c == '(' ? TokenType::OpenParen : TokenType::CloseParen;
+        current.text = string(1, c);
+        ++position;
+    } else if (c == '"') {
+        current.type = TokenType::String;
+        for (++position;; ++position) {
+            if (position >= text.size()) fail(current.column, "unterminated string");
+            if (text[position] == '"') break;
+            if (text[position] == '\\' && position + 1 < text.size()) ++position;
+            current.text += text[position];
+        }
+        ++position;
+    } else if (isdigit(static_cast<unsigned char>(c)) || c == '-' || c == '.') {
+        current.type = TokenType::Number;
+        auto [end, error] = from_chars(text.data() + position, text.data() + text.size(), current.number);
+        if (error != errc()) fail(current.column, "invalid number");
+        current.text = text.substr(position, end - (text.data() + position));
+        position = end - text.data();
+    } else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+        current.type = TokenType::Word;
+        size_t start = position;
+        while (position < text.size() && (isalnum(static_cast<unsigned char>(text[position])) || text[position] == '_'))
+            ++position;
+        current.text = TrigramIndex::fold(string_view(text).substr(start, position - start));
+    } else {
+        current.type = TokenType::Operator;
+        for (const char *op : {"<=", ">=", "!=", "!~", "==", "<", ">", "=", "~"}) {
+            if (text.compare(position, char_traits<char>::length(op), op) == 0) {
+                current.text = op;
+                break;
+            }
+        }
+        if (current.text.empty()) fail(current.column, string("unexpected character '") + c + "'");
+        position += current.text.size();
+    }
+}
+
+// and ("or" and)*
+void QueryParser::parseOr() {
+    parseAnd();
+    vector<uint32_t> jumps;
+    while (acceptWord("or")) {
+        jumps.push_back(emit(QueryProgram::OpCode::JumpIfTrue));
+        parseAnd();
+    }
+    patch(jumps);
+}
+
+// unary ("and" unary)*
+void QueryParser::parseAnd() {
+    parseUnary();
+    vector<uint32_t> jumps;
+    while (acceptWord("and")) {
+        jumps.push_back(emit(QueryProgram::OpCode::JumpIfFalse));
+        parseUnary();
+    }
+    patch(jumps);
+}
+
+// "not" unary | "(" query ")" | comparison
+void QueryParser::parseUnary() {
+    if (acceptWord("not")) {
+        parseUnary();
+        emit(QueryProgram::OpCode::Not);
+    } else if (current.type == TokenType::OpenParen) {
+        size_t column = current.column;
+        advance();
+        parseOr();
+        if (current.type != TokenType::CloseParen) fail(column, "unclosed '('");
+        advance();
+    } else {
+        parseComparison();
+    }
+}
+
+// field operator value
+void QueryParser::parseComparison() {
+    using OpCode = QueryProgram::OpCode;
+    using Comparison = QueryProgram::Comparison;
+
+    if (current.type != TokenType::Word) fail(current.column, "expected a field (name, species, qty, price)");
+    Token field = current;
+    bool numeric = field.text == "qty" || field.text == "quantity" || field.text == "price";
+    if (!numeric && field.text != "name" && field.text != "species") fail(field.column, "unknown field '" + field.text + "'");
+    advance();
+
+    if (current.type != TokenType::Operator) fail(current.column, "expected a comparison after '" + field.text + "'");
+    Token op = current;
+    advance();
+    Comparison comparison = Comparison::Equal;
+    if (op.text == "!=" || op.text == "!~") comparison = Comparison::NotEqual;
+    else if (op.text == "<") comparison = Comparison::Less;
+    else if (op.text == "<=") comparison = Comparison::LessEqual;
+    else if (op.text == ">") comparison = Comparison::Greater;
+    else if (op.text == ">=") comparison = Comparison::GreaterEqual;
+    bool contains = op.text == "~" || op.text == "!~";
+
+    if (numeric) {
+        if (contains) fail(op.column, "'" + op.text + "' needs a text field");
+        if (current.type != TokenType::Number) fail(current.column, "expected a number");
+        program.numbers.push_back(current.number);
+        emit(field.text == "price" ? OpCode::ComparePrice : OpCode::CompareQuantity, comparison,
+             static_cast<uint32_t>(program.numbers.size() - 1));
+    } else {
+        if (comparison != Comparison::Equal && comparison != Comparison::NotEqual)
+            fail(op.column, "'" + op.text + "' needs a numeric field");
+        if (current.type != TokenType::String) fail(current.column, "expected a quoted string");
+        program.strings.push_back(contains ? TrigramIndex::fold(current.text) : current.text);
+        bool name = field.text == "name";
+        OpCode code = contains ? (name ? OpCode::NameContains : OpCode::SpeciesContains)
+                               : (name ? OpCode::CompareName : OpCode::CompareSpecies);
+        emit(code, comparison, static_cast<uint32_t>(program.strings.size() - 1));
+    }
+    advance();
+}
+
+// Parses the text into a fresh program
+QueryProgram QueryProgram::compile(const string &text) {
+    QueryProgram program;
+    QueryParser(text, program).parse();
+    return program;
+}
+
+// Applies a numeric comparison
+static bool compare(double value, double constant, QueryProgram::Comparison comparison) {
+    switch (comparison) {
+    case QueryProgram::Comparison::Equal: return value == constant;
+    case QueryProgram::Comparison::NotEqual: return value != constant;
+    case QueryProgram::Comparison::Less: return value < constant;
+    case QueryProgram::Comparison::LessEqual: return value <= constant;
+    case QueryProgram::Comparison::Greater: return value > constant;
+    case QueryProgram::Comparison::GreaterEqual: return value >= constant;
+    }
+    return false;
+}
+
+// Runs the instructions from the first to past the last, following jumps
+bool QueryProgram::matches(const Plant &plant) const {
+    bool result = false;
+    const Instruction *instructions = code.data();
+    for (size_t pc = 0, end = code.size(); pc < end;) {
+        const Instruction &in = instructions[pc++];
+        bool negate = in.comparison == Comparison::NotEqual;
+        switch (in.op) {
+        case OpCode::CompareQuantity: result = compare(plant.getQuantity(), numbers[in.operand], in.comparison); break;
+        case OpCode::ComparePrice: result = compare(plant.getPrice(), numbers[in.operand], in.comparison); break;
+        case OpCode::CompareName: result = (plant.getName() == strings[in.operand]) != negate; break;
+        case OpCode::CompareSpecies: result = (plant.getSpecies() == strings[in.operand]) != negate; break;
+        case OpCode::NameContains:
+            result = TrigramIndex::containsFolded(plant.getName(), strings[in.operand]) != negate;
+            break;
+        case OpCode::SpeciesContains:
+            result = TrigramIndex::containsFolded(plant.getSpecies(), strings[in.operand]) != negate;
+            break;
+        case OpCode::Not: result = !result; break;
+        case OpCode::JumpIfFalse: if (!result) pc = in.operand; break;
+        case OpCode::JumpIfTrue: if (result) pc = in.operand; break;
+        }
+    }
+    return result;
+}
+
+// Mnemonics with their operand, constants inlined
+string QueryProgram::disassemble() const {
+    static const char *comparisons[] = {"==", "!=", "<", "<=", ">", ">="};
+    ostringstream out;
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        const Instruction &in = code[pc];
+        const char *cmp = comparisons[static_cast<int>(in.comparison)];
+        out << pc << ": ";
+        switch (in.op) {
+        case OpCode::CompareQuantity: out << "quantity " << cmp << " " << numbers[in.operand]; break;
+        case OpCode::ComparePrice: out << "price " << cmp << " " << numbers[in.operand]; break;
+        case OpCode::CompareName: out << "name " << cmp << " \"" << strings[in.operand] << "\""; break;
+        case OpCode::CompareSpecies: out << "species " << cmp << " \"" << strings[in.operand] << "\""; break;
+        case OpCode::NameContains:
+            out << "name " << (in.comparison == Comparison::NotEqual ? "!~" : "~") << " \"" << strings[in.operand] << "\"";
+            break;
+        case OpCode::SpeciesContains:
+            out << "species " << (in.comparison == Comparison::NotEqual ? "!~" : "~") << " \"" << strings[in.operand] << "\"";
+            break;
+        case OpCode::Not: out << "not"; break;
+        case OpCode::JumpIfFalse: out << "jump_if_false " << in.operand; break;
+        case OpCode::JumpIfTrue: out << "jump_if_true " << in.operand; break;
+        }
+        out << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "../Model/plant.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A compiled text query, evaluated per plant by a small bytecode loop.
+//
+// Grammar (keywords and field names ignore case):
+//     query      := and ("or" and)*
+//     and        := unary ("and" unary)*
+//     unary      := "not" unary | "(" query ")" | comparison
+//     comparison := ("qty" | "quantity" | "price") ("=" | "!=" | "<" | "<=" | ">" | ">=") number
+//                 | ("name" | "species") ("=" | "!=") string
+//                 | ("name" | "species") ("~" | "!~") string    -- contains, ignoring ASCII case
+// Strings are double-quoted with \" and \\ escapes; "and" binds tighter than "or".
+// Example: species = "Succulent" and price < 20 and qty >= 5 or name ~ "aloe"
+//
+// The program is a flat vector of 8-byte instructions that update a single
+// boolean result. "and" / "or" compile to conditional forward jumps, so
+// evaluation short-circuits like the C++ operators and needs no stack.
+class QueryProgram {
+public:
+    enum class OpCode : uint8_t {
+        CompareQuantity,  // result = quantity <cmp> numbers[operand]
+        ComparePrice,     // result = price <cmp> numbers[operand]
+        CompareName,      // result = name (== or !=) strings[operand]
+        CompareSpecies,   // result = species (== or !=) strings[operand]
+        NameContains,     // result = folded name contains strings[operand] (already folded)
+        SpeciesContains,  // result = folded species contains strings[operand]
+        Not,              // result = !result
+        JumpIfFalse,      // if (!result) continue at instruction operand
+        JumpIfTrue        // if (result) continue at instruction operand
+    };
+
+    enum class Comparison : uint8_t { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    struct Instruction {
+        OpCode op;
+        Comparison comparison; // Compare*: the operator; *Contains: Equal = contains, NotEqual = does not
+        uint32_t operand;      // Constant index or jump target
+    };
+
+private:
+    vector<Instruction> code;
+    vector<double> numbers;
+    vector<string> strings;
+
+    friend class QueryParser;
+
+public:
+    // Parses and compiles a query; throws invalid_argument with the column of
+    // the first error
+    static QueryProgram compile(const string &text);
+
+    // Runs the program on one plant
+    bool matches(const Plant &plant) const;
+
+    // Number of instructions
+    size_t size() const { return code.size(); }
+
+    // One instruction per line, e.g. "2: jump_if_false 5"; for tests and debugging
+    string disassemble() const;
+};
@@ -0,0 +1,128 @@
+#include "trigram_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Posting entries that may go stale before the lists are rebuilt
+static constexpr size_t compactAfterStale = 1024;
+
+// Packs the three bytes starting at text[i] into a key
+static uint32_t trigramAt(string_view text, size_t i) {
+    return static_cast<uint32_t>(static_cast<unsigned char>(text[i])) << 16 |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[i + 1])) << 8 |
+           static_cast<uint32_t>(static_cast<unsigned char>(text[i + 2]));
+}
+
+// Returns the distinct trigrams of text
+static vector<uint32_t> trigramsOf(string_view text) {
+    vector<uint32_t> keys;
+    if (text.size() < 3) return keys;
+    keys.reserve(text.size() - 2);
+    for (size_t i = 0; i + 3 <= text.size(); ++i) keys.push_back(trigramAt(text, i));
+    ranges::sort(keys);
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// Lowercases ASCII letters byte by byte
+string TrigramIndex::fold(string_view text) {
+    string folded(text);
+    for (char &c : folded)
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    return folded;
+}
+
+// Compares byte by byte, folding the text as it goes
+bool TrigramIndex::containsFolded(string_view text, string_view foldedTerm) {
+    if (text.size() < foldedTerm.size()) return false;
+    for (size_t i = 0, last = text.size() - foldedTerm.size(); i <= last; ++i) {
+        size_t j = 0;
+        while (j < foldedTerm.size()) {
+            char c = text[i + j];
+            if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+            if (c != foldedTerm[j]) break;
+            ++j;
+        }
+        if (j == foldedTerm.size()) return true;
+    }
+    return false;
+}
+
+// Appends id to the posting lists of the text's trigrams
+void TrigramIndex::index(uint64_t id, string_view text) {
+    for (uint32_t key : trigramsOf(text)) postings[key].push_back(id);
+}
+
+// Folds and indexes the text
+void TrigramIndex::add(uint64_t id, string_view text) {
+    auto [it, inserted] = texts.emplace(id, fold(text));
+    if (inserted) index(id, it->second);
+}
+
+// Forgets the text; its posting entries are dropped on the next rebuild
+void TrigramIndex::remove(uint64_t id) {
+    auto it = texts.find(id);
+    if (it == texts.end()) return;
+    staleEntries += trigramsOf(it->second).size();
+    texts.erase(it);
+    compactIfNeeded();
+}
+
+// Removes all texts and posting lists
+void TrigramIndex::clear() {
+    postings.clear();
+    texts.clear();
+    staleEntries = 0;
+}
+
+// Rebuilds the posting lists from the live texts, in id order
+void TrigramIndex::compactIfNeeded() {
+    if (staleEntries < compactAfterStale || staleEntries < texts.size()) return;
+    vector<uint64_t> ids;
+    ids.reserve(texts.size());
+    for (const auto &entry : texts) ids.push_back(entry.first);
+    ranges::sort(ids);
+
+    postings.clear();
+    for (uint64_t id : ids) index(id, texts.at(id));
+    staleEntries = 0;
+}
+
+// Looks up the posting list sizes only
+optional<size_t> TrigramIndex::estimate(string_view foldedTerm) const {
+    if (foldedTerm.size() < 3) return nullopt;
+    size_t smallest = texts.size();
+    for (uint32_t key : trigramsOf(foldedTerm)) {
+        auto it = postings.find(key);
+        smallest = min(smallest, it == postings.end() ? 0 : it->second.size());
+    }
+    return smallest;
+}
+
+// Intersects the posting lists, smallest first, then verifies each candidate
+bool TrigramIndex::search(string_view foldedTerm, vector<uint64_t> &ids) const {
+    if (foldedTerm.size() < 3) return false;
+
+    vector<const vector<uint64_t> *> lists;
+    for (uint32_t key : trigramsOf(foldedTerm)) {
+        auto it = postings.find(key);
+        if (it == postings.end()) return true; // Some trigram occurs nowhere
+        lists.push_back(&it->second);
+    }
+    ranges::sort(lists, {}, [](const vector<uint64_t> *list) { return list->size(); });
+
+    vector<uint64_t> candidates = *lists.front();
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+        const auto &list = *lists[i];
+        erase_if(candidates, [&list](uint64_t id) { return !binary_search(list.begin(), list.end(), id); });
+    }
+
+    // Candidates share all trigrams with the term; check the text really
+    // contains it and the id is still live
+    for (uint64_t id : candidates) {
+        auto it = texts.find(id);
+        if (it != texts.end() && it->second.find(foldedTerm) != string::npos) ids.push_back(id);
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Substring index over short texts identified by increasing ids.
+//
+// Texts are case-folded once when they are added; each trigram of the folded
+// text maps to a posting list of ids. A search intersects the posting lists of
+// the term's trigrams and verifies the remaining candidates against the folded
+// texts, so the caller gets exactly the ids whose text contains the term.
+//
+// Ids must be added in increasing order, which keeps every posting list sorted
+// with a plain push_back. Removed ids stay in the lists until stale entries
+// outnumber live texts, then the lists are rebuilt.
+class TrigramIndex {
+private:
+    unordered_map<uint32_t, vector<uint64_t>> postings;
+    unordered_map<uint64_t, string> texts; // id -> folded text
+    size_t staleEntries = 0;               // Posting entries of removed ids
+
+    // Adds id to the posting list of every distinct trigram of text
+    void index(uint64_t id, string_view text);
+
+    // Drops stale posting entries once they outnumber the live ones
+    void compactIfNeeded();
+
+public:
+    // Returns text with ASCII letters lowercased (other bytes, e.g. UTF-8, unchanged)
+    static string fold(string_view text);
+
+    // Checks if text contains an already folded term, ignoring ASCII case,
+    // without copying text
+    static bool containsFolded(string_view text, string_view foldedTerm);
+
+    // Indexes a text; id must be greater than every id added before
+    void add(uint64_t id, string_view text);
+
+    // Removes an id
+    void remove(uint64_t id);
+
+    // Removes everything
+    void clear();
+
+    // Returns the folded text of an id
+    const string &foldedText(uint64_t id) const { return texts.at(id); }
+
+    // Collects, in ascending order, the ids whose folded text contains
+    // foldedTerm. Returns false without collecting anything if the term is
+    // shorter than a trigram, in which case the caller has to scan.
+    bool search(string_view foldedTerm, vector<uint64_t> &ids) const;
+
+    // Returns an upper bound of the ids a search would find (the shortest
+    // posting list of the term's trigrams), or nullopt if the term is too short
+    optional<size_t> estimate(string_view foldedTerm) const;
+};
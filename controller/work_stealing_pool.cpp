@@ -0,0 +1,107 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Constructor; every worker owns one deque
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    for (unsigned i = 0; i < max(threads, 1u); ++i) queues.push_back(make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this, i] { work(i); });
+}
+
+// Destructor
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+// Own deque from the back (most recently pushed, still cache-warm), others from the front
+bool WorkStealingPool::takeTask(size_t home, Task &task) {
+    if (queuedTasks == 0) return false;
+    for (size_t i = 0; i < queues.size(); ++i) {
+        Queue &queue = *queues[(home + i) % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) continue;
+        if (i == 0) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        --queuedTasks;
+        return true;
+    }
+    return false;
+}
+
+// Runs one task; the last task of a job wakes its caller
+void WorkStealingPool::execute(const Task &task) {
+    Job &job = *task.job;
+    try {
+        (*job.task)(task.index);
+    } catch (...) {
+        lock_guard<mutex> guard(job.errorLock);
+        if (!job.error) job.error = current_exception();
+    }
+    if (--job.remaining == 0) {
+        lock_guard<mutex> guard(sleepLock);
+        jobFinished.notify_all();
+    }
+}
+
+// Takes tasks until the pool stops, sleeping while there are none
+void WorkStealingPool::work(size_t home) {
+    while (true) {
+        Task task;
+        if (takeTask(home, task)) {
+            execute(task);
+            continue;
+        }
+        unique_lock<mutex> guard(sleepLock);
+        taskAvailable.wait(guard, [this] { return stopping || queuedTasks > 0; });
+        if (stopping) return;
+    }
+}
+
+// Queues the tasks, helps until they are done, then reports the first error
+void WorkStealingPool::run(size_t count, const function<void(size_t)> &task) {
+    if (count == 0) return;
+    Job job;
+    job.task = &task;
+    job.remaining = count;
+
+    for (size_t i = 0; i < count; ++i) {
+        Queue &queue = *queues[i % queues.size()];
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back({&job, i});
+    }
+    {
+        lock_guard<mutex> guard(sleepLock);
+        queuedTasks += count;
+    }
+    taskAvailable.notify_all();
+
+    // The caller may run tasks of other jobs too; that only helps them finish
+    Task next;
+    while (job.remaining > 0) {
+        if (takeTask(0, next)) {
+            execute(next);
+            continue;
+        }
+        unique_lock<mutex> guard(sleepLock);
+        jobFinished.wait(guard, [&job] { return job.remaining == 0; });
+    }
+    if (job.error) rethrow_exception(job.error);
+}
+
+// Created on first use; the caller counts as one of the cores
+WorkStealingPool &WorkStealingPool::shared() {
+    static WorkStealingPool pool(max(thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
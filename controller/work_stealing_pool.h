@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fixed set of worker threads for data-parallel loops.
+//
+// run(count, task) spreads task(0) .. task(count - 1) round-robin over one
+// deque per worker. A worker takes from the back of its own deque and, when
+// that is empty, steals from the front of the others, so uneven partitions
+// (e.g. a chunk full of removed slots) rebalance on their own. The calling
+// thread steals too while it waits, which makes nested run calls safe and
+// lets a pool without workers run everything on the caller.
+class WorkStealingPool {
+private:
+    // One run call; lives on the caller's stack until all its tasks finished
+    struct Job {
+        const function<void(size_t)> *task;
+        atomic<size_t> remaining;
+        mutex errorLock;
+        exception_ptr error;
+    };
+
+    struct Task {
+        Job *job;
+        size_t index;
+    };
+
+    struct Queue {
+        mutex lock;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+
+    // Idle workers and waiting callers sleep on these
+    mutex sleepLock;
+    condition_variable taskAvailable;
+    condition_variable jobFinished;
+    atomic<size_t> queuedTasks{0};
+    bool stopping = false;
+
+    // Takes a task, preferring the back of queue 'home'; false if all are empty
+    bool takeTask(size_t home, Task &task);
+
+    // Runs a task and records its exception, if any, on its job
+    void execute(const Task &task);
+
+    // Worker loop
+    void work(size_t home);
+
+public:
+    // Constructor; starts the given number of workers (0 = run on the caller)
+    explicit WorkStealingPool(unsigned threads);
+
+    // Stops and joins the workers; pending tasks must have finished
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool&) = delete;
+
+    // Number of worker threads (the caller helps, so parallelism is one more)
+    size_t threadCount() const { return workers.size(); }
+
+    // Calls task(i) for every i in [0, count), possibly concurrently, and
+    // returns when all calls finished. Rethrows the first exception thrown.
+    void run(size_t count, const function<void(size_t)> &task);
+
+    // Pool shared by the controllers: one worker per additional core
+    static WorkStealingPool &shared();
+};
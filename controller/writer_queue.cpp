@@ -0,0 +1,43 @@
+#include "writer_queue.h"
+
+using namespace std;
+
+// Constructor
+WriterQueue::WriterQueue() : writer([this] { work(); }) {}
+
+// Destructor
+WriterQueue::~WriterQueue() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    taskAvailable.notify_one();
+    writer.join();
+}
+
+// Takes tasks in order until stopped and drained
+void WriterQueue::work() {
+    while (true) {
+        packaged_task<void()> task;
+        {
+            unique_lock<mutex> guard(lock);
+            taskAvailable.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = move(tasks.front());
+            tasks.pop_front();
+        }
+        task(); // Exceptions are stored in the task's future
+    }
+}
+
+// Appends the task to the queue and wakes the writer
+future<void> WriterQueue::submit(function<void()> task) {
+    packaged_task<void()> packaged(move(task));
+    future<void> done = packaged.get_future();
+    {
+        lock_guard<mutex> guard(lock);
+        tasks.push_back(move(packaged));
+    }
+    taskAvailable.notify_one();
+    return done;
+}
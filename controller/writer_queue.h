@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+// Single thread that runs submitted tasks one at a time, in submission order.
+//
+// Mutations from any number of threads are funneled through it, so they are
+// applied in a single total order: a task submitted after another one
+// returned (or after its future became ready) always runs after it.
+class WriterQueue {
+private:
+    mutex lock;
+    condition_variable taskAvailable;
+    deque<packaged_task<void()>> tasks;
+    bool stopping = false;
+    thread writer;
+
+    // Writer loop
+    void work();
+
+public:
+    // Constructor; starts the writer thread
+    WriterQueue();
+
+    // Runs the tasks still queued, then stops the writer
+    ~WriterQueue();
+
+    WriterQueue(const WriterQueue&) = delete;
+    WriterQueue &operator=(const WriterQueue&) = delete;
+
+    // Queues a task; the future reports its completion or exception
+    future<void> submit(function<void()> task);
+
+    // Checks if the caller is the writer thread (i.e. runs inside a task)
+    bool onWriterThread() const { return this_thread::get_id() == writer.get_id(); }
+};
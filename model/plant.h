@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <utility>
 
 using namespace std;
 
@@ -12,11 +13,12 @@ private:
     double price;
 public:
     // Constructor
-    Plant(const string &name, const string &species, int quantity, double price) :
-        name(name), species(species), quantity(quantity), price(price) {}
-    // Getters
-    string getName() const { return name; }
-    string getSpecies() const { return species; }
+    Plant(string name, string species, int quantity, double price) :
+        name(move(name)), species(move(species)), quantity(quantity), price(price) {}
+    // Getters; strings are returned by reference, copy them if they must
+    // outlive the plant
+    const string &getName() const { return name; }
+    const string &getSpecies() const { return species; }
     double getPrice() const { return price; }
     int getQuantity() const { return quantity; }
     // Setters
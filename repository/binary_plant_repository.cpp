@@ -0,0 +1,505 @@
+#include "binary_plant_repository.h"
+#include "file_sync.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+
+static constexpr char fileMagic[8] = {'P', 'L', 'A', 'N', 'T', 'B', 'I', 'N'};
+static constexpr uint64_t initialRecordCapacity = 1024;
+static constexpr uint64_t initialHeapCapacity = 64 * 1024;
+
+// Compaction runs once this many slots are removed and they outnumber live plants,
+// or once this many heap bytes are unreferenced and they outnumber the used ones
+static constexpr uint64_t compactAfterRemoved = 1024;
+static constexpr uint64_t compactAfterDeadBytes = 64 * 1024;
+
+// Constructor
+BinaryPlantRepository::BinaryPlantRepository(string filename, DurabilityPolicy durability)
+    : filename(move(filename)), durability(durability), file(make_unique<WritableMappedFile>(this->filename)) {
+    static_assert(sizeof(Header) == 72, "header layout changed");
+    static_assert(sizeof(Record) == 48, "record layout changed");
+    openFile();
+}
+
+// Destructor; the clean flag may only reach the disk after every page it covers
+BinaryPlantRepository::~BinaryPlantRepository() {
+    if (!file || !(header().flags & dirtyFlag)) return;
+    try {
+        file->sync();
+        header().flags &= ~dirtyFlag;
+        file->sync();
+    } catch (...) {}
+}
+
+// Returns the record of a slot
+BinaryPlantRepository::Record &BinaryPlantRepository::record(uint64_t slot) const {
+    return reinterpret_cast<Record *>(file->data() + sizeof(Header))[slot];
+}
+
+// Returns the start of the heap, which follows the record table
+char *BinaryPlantRepository::heap() const {
+    return file->data() + sizeof(Header) + header().recordCapacity * sizeof(Record);
+}
+
+// Returns a view of heap bytes; a clean file's records are not checked on open
+string_view BinaryPlantRepository::text(uint64_t offset, uint32_t length) const {
+    uint64_t heapSize = header().heapSize;
+    if (offset > heapSize || length > heapSize - offset) throw invalid("string out of range");
+    return {heap() + offset, length};
+}
+
+// Builds a Plant from the record of a slot
+Plant BinaryPlantRepository::plantAt(uint64_t slot) const {
+    const Record &r = record(slot);
+    return Plant(string(text(r.nameOffset, r.nameLength)),
+                 string(text(r.speciesOffset, r.speciesLength)),
+                 r.quantity, r.price);
+}
+
+// Error for a file that is not a valid plant binary file
+runtime_error BinaryPlantRepository::invalid(const string &why) const {
+    return runtime_error("File " + filename + " is not a valid plant binary file: " + why);
+}
+
+// FNV-1a over bytes, continuing from hash
+static uint64_t fnv1a(uint64_t hash, const void *bytes, size_t length) {
+    const auto *p = static_cast<const unsigned char *>(bytes);
+    for (size_t i = 0; i < length; ++i) hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+// Covers the slot too, so a record written to the wrong place does not pass
+uint64_t BinaryPlantRepository::recordChecksum(const Record &value, uint64_t slot, const char *heap) {
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, &value, offsetof(Record, checksum));
+    hash = fnv1a(hash, &slot, sizeof(slot));
+    hash = fnv1a(hash, heap + value.nameOffset, value.nameLength);
+    return fnv1a(hash, heap + value.speciesOffset, value.speciesLength);
+}
+
+// Strings first: the checksum reads them
+bool BinaryPlantRepository::recordIntact(uint64_t slot) const {
+    const Record &r = record(slot);
+    uint64_t heapSize = header().heapSize;
+    if (r.nameOffset > heapSize || r.nameLength > heapSize - r.nameOffset ||
+        r.speciesOffset > heapSize || r.speciesLength > heapSize - r.speciesOffset)
+        return false;
+    return r.checksum == recordChecksum(r, slot, heap());
+}
+
+// Initializes an empty file, or validates the header of an existing one.
+// Nothing past the header is read unless the file was left dirty.
+void BinaryPlantRepository::openFile() {
+    index.clear();
+    indexed = false;
+    if (file->size() == 0) {
+        file->resize(sizeof(Header) + initialRecordCapacity * sizeof(Record) + initialHeapCapacity);
+        Header &h = header();
+        memcpy(h.magic, fileMagic, sizeof(fileMagic));
+        h.version = formatVersion;
+        h.recordSize = sizeof(Record);
+        h.recordCount = 0;
+        h.recordCapacity = initialRecordCapacity;
+        h.heapSize = 0;
+        h.heapCapacity = initialHeapCapacity;
+        h.liveCount = 0;
+        h.deadHeapBytes = 0;
+        h.flags = 0;
+        return;
+    }
+
+    if (file->size() < sizeof(Header) || memcmp(header().magic, fileMagic, sizeof(fileMagic)) != 0)
+        throw invalid("bad header");
+    const Header &h = header();
+    if (h.version != formatVersion)
+        throw invalid("unsupported format version " + to_string(h.version));
+    if (h.recordSize != sizeof(Record))
+        throw invalid("unexpected record size");
+    if (h.recordCount > h.recordCapacity || h.heapSize > h.heapCapacity || h.liveCount > h.recordCount ||
+        h.deadHeapBytes > h.heapSize ||
+        h.recordCapacity > file->size() / sizeof(Record) || h.heapCapacity > file->size() ||
+        file->size() < sizeof(Header) + h.recordCapacity * sizeof(Record) + h.heapCapacity)
+        throw invalid("truncated file");
+    if (h.flags & dirtyFlag) recover();
+}
+
+// A torn record, or one whose strings never reached the disk, becomes a
+// removed record without strings. The live count and dead heap bytes are
+// recounted, as their updates may have been lost too.
+void BinaryPlantRepository::recover() {
+    Header &h = header();
+    uint64_t live = 0, usedBytes = 0;
+    for (uint64_t slot = 0; slot < h.recordCount; ++slot) {
+        if (!recordIntact(slot)) {
+            Record removed{};
+            removed.flags = removedFlag;
+            writeRecord(slot, removed);
+        }
+        const Record &r = record(slot);
+        if (r.flags & removedFlag) continue;
+        ++live;
+        usedBytes += r.nameLength + r.speciesLength;
+    }
+    h.liveCount = live;
+    h.deadHeapBytes = h.heapSize - usedBytes;
+    file->sync();
+    h.flags &= ~dirtyFlag;
+    file->sync();
+}
+
+// Indexes the live records; a name stored twice means the file is damaged
+void BinaryPlantRepository::ensureIndexed() const {
+    if (indexed.load(memory_order_acquire)) return;
+    lock_guard<mutex> guard(indexLock); // Concurrent readers may all get here
+    if (indexed.load(memory_order_relaxed)) return;
+    const Header &h = header();
+    index.clear();
+    index.reserve(h.liveCount);
+    for (uint64_t slot = 0; slot < h.recordCount; ++slot) {
+        const Record &r = record(slot);
+        if (r.flags & removedFlag) continue;
+        if (!index.emplace(string(text(r.nameOffset, r.nameLength)), slot).second) {
+            index.clear();
+            throw invalid("duplicate name");
+        }
+    }
+    indexed.store(true, memory_order_release);
+}
+
+// The dirty flag must be on the disk before any page it guards
+void BinaryPlantRepository::beginChange() {
+    if (header().flags & dirtyFlag) return;
+    header().flags |= dirtyFlag;
+    file->sync();
+}
+
+// Doubles the record table and/or heap until the request fits. The heap sits
+// after the record table, so the file is copied into the new layout and
+// renamed over the old one; a crash leaves one or the other. Slots keep
+// their numbers, so this may run inside a batch.
+void BinaryPlantRepository::reserve(uint64_t records, uint64_t heapBytes) {
+    Header h = header();
+    uint64_t recordCapacity = h.recordCapacity, heapCapacity = h.heapCapacity;
+    while (recordCapacity < h.recordCount + records) recordCapacity *= 2;
+    while (heapCapacity < h.heapSize + heapBytes) heapCapacity *= 2;
+    if (recordCapacity == h.recordCapacity && heapCapacity == h.heapCapacity) return;
+
+    string tempPath = filename + ".tmp";
+    filesystem::remove(tempPath);
+    {
+        WritableMappedFile out(tempPath);
+        out.resize(sizeof(Header) + recordCapacity * sizeof(Record) + heapCapacity);
+        memcpy(out.data() + sizeof(Header), &record(0), h.recordCount * sizeof(Record));
+        memcpy(out.data() + sizeof(Header) + recordCapacity * sizeof(Record), heap(), h.heapSize);
+        h.recordCapacity = recordCapacity;
+        h.heapCapacity = heapCapacity;
+        h.flags = 0; // Complete once synced
+        memcpy(out.data(), &h, sizeof(Header));
+        out.sync();
+    }
+    file.reset();
+    filesystem::rename(tempPath, filename);
+    if (durability != DurabilityPolicy::None) syncDirectoryOf(filename);
+    file = make_unique<WritableMappedFile>(filename);
+}
+
+// Copies text to the end of the heap; space must already be reserved
+uint64_t BinaryPlantRepository::appendText(string_view value) {
+    Header &h = header();
+    uint64_t offset = h.heapSize;
+    memcpy(heap() + offset, value.data(), value.size());
+    h.heapSize += value.size();
+    return offset;
+}
+
+// Overwrites a slot; its strings must already be in the heap
+void BinaryPlantRepository::writeRecord(uint64_t slot, Record value) {
+    value.checksum = recordChecksum(value, slot, heap());
+    record(slot) = value;
+}
+
+// Slots appended during the batch need no undo entry; rollback cuts them off
+void BinaryPlantRepository::recordUndo(uint64_t slot) {
+    if (batchOpen && slot < batchHeader.recordCount) batchUndo.try_emplace(slot, record(slot));
+}
+
+// Writes live plants to a fresh file and swaps it in; slot numbers change, so
+// this never runs inside a batch
+void BinaryPlantRepository::compactIfNeeded() {
+    const Header &h = header();
+    uint64_t removed = h.recordCount - h.liveCount;
+    bool manyRemoved = removed >= compactAfterRemoved && removed > h.liveCount;
+    bool mostlyDead = h.deadHeapBytes >= compactAfterDeadBytes && h.deadHeapBytes > h.heapSize - h.deadHeapBytes;
+    if (batchOpen || !(manyRemoved || mostlyDead)) return;
+
+    string tempPath = filename + ".tmp";
+    writeFile(tempPath, getAllPlants());
+    file.reset();
+    filesystem::rename(tempPath, filename);
+    if (durability != DurabilityPolicy::None) syncDirectoryOf(filename);
+    file = make_unique<WritableMappedFile>(filename);
+    openFile();
+}
+
+// Lays out header, records and heap for the plants in one pass
+void BinaryPlantRepository::writeFile(const string &path, const vector<Plant> &plants) {
+    uint64_t heapBytes = 0;
+    for (const auto &plant : plants) heapBytes += plant.getName().size() + plant.getSpecies().size();
+    uint64_t recordCapacity = initialRecordCapacity, heapCapacity = initialHeapCapacity;
+    while (recordCapacity < plants.size()) recordCapacity *= 2;
+    while (heapCapacity < heapBytes) heapCapacity *= 2;
+
+    filesystem::remove(path);
+    WritableMappedFile out(path);
+    out.resize(sizeof(Header) + recordCapacity * sizeof(Record) + heapCapacity);
+
+    Header h{};
+    memcpy(h.magic, fileMagic, sizeof(fileMagic));
+    h.version = formatVersion;
+    h.recordSize = sizeof(Record);
+    h.recordCapacity = recordCapacity;
+    h.heapCapacity = heapCapacity;
+
+    auto *records = reinterpret_cast<Record *>(out.data() + sizeof(Header));
+    char *heapStart = out.data() + sizeof(Header) + recordCapacity * sizeof(Record);
+    auto append = [&](const string &value) {
+        uint64_t offset = h.heapSize;
+        memcpy(heapStart + offset, value.data(), value.size());
+        h.heapSize += value.size();
+        return offset;
+    };
+    for (const auto &plant : plants) {
+        Record r{};
+        r.nameOffset = append(plant.getName());
+        r.speciesOffset = append(plant.getSpecies());
+        r.nameLength = static_cast<uint32_t>(plant.getName().size());
+        r.speciesLength = static_cast<uint32_t>(plant.getSpecies().size());
+        r.price = plant.getPrice();
+        r.quantity = plant.getQuantity();
+        r.checksum = recordChecksum(r, h.recordCount, heapStart);
+        records[h.recordCount] = r;
+        ++h.recordCount;
+    }
+    h.liveCount = h.recordCount;
+    memcpy(out.data(), &h, sizeof(Header));
+    out.sync();
+}
+
+// Appends the strings and a new record at the end of the table
+void BinaryPlantRepository::addPlant(const Plant& plant) {
+    ensureIndexed();
+    if (index.contains(plant.getName())) { throw DuplicatePlantException(plant.getName()); }
+    reserve(1, plant.getName().size() + plant.getSpecies().size());
+    beginChange();
+
+    Record r{};
+    r.nameOffset = appendText(plant.getName());
+    r.speciesOffset = appendText(plant.getSpecies());
+    r.nameLength = static_cast<uint32_t>(plant.getName().size());
+    r.speciesLength = static_cast<uint32_t>(plant.getSpecies().size());
+    r.price = plant.getPrice();
+    r.quantity = plant.getQuantity();
+
+    Header &h = header();
+    uint64_t slot = h.recordCount;
+    writeRecord(slot, r);
+    ++h.recordCount;
+    ++h.liveCount;
+    index.emplace(plant.getName(), slot);
+    mutated();
+    notifyAdded(plant);
+}
+
+// Flags the record as removed
+void BinaryPlantRepository::removePlant(const string& name) {
+    ensureIndexed();
+    auto it = index.find(name);
+    if (it == index.end()) { throw PlantNotFoundException(name); }
+    uint64_t slot = it->second;
+    recordUndo(slot);
+    optional<Plant> removed;
+    if (hasListeners()) removed = plantAt(slot);
+
+    beginChange();
+    Record r = record(slot);
+    r.flags |= removedFlag;
+    writeRecord(slot, r);
+    --header().liveCount;
+    header().deadHeapBytes += r.nameLength + r.speciesLength;
+    index.erase(it);
+    compactIfNeeded();
+    mutated();
+    if (removed) notifyRemoved(*removed);
+}
+
+// Rewrites quantity and price in place; a new species is appended to the heap
+void BinaryPlantRepository::updatePlant(const Plant& plant) {
+    ensureIndexed();
+    auto it = index.find(plant.getName());
+    if (it == index.end()) { throw PlantNotFoundException(plant.getName()); }
+    uint64_t slot = it->second;
+    recordUndo(slot);
+    optional<Plant> oldPlant;
+    if (hasListeners()) oldPlant = plantAt(slot);
+
+    Record r = record(slot);
+    bool newSpecies = text(r.speciesOffset, r.speciesLength) != plant.getSpecies();
+    if (newSpecies) reserve(0, plant.getSpecies().size());
+    beginChange();
+    if (newSpecies) {
+        header().deadHeapBytes += r.speciesLength; // The old species stays behind until compaction
+        r.speciesOffset = appendText(plant.getSpecies());
+        r.speciesLength = static_cast<uint32_t>(plant.getSpecies().size());
+    }
+    r.quantity = plant.getQuantity();
+    r.price = plant.getPrice();
+    writeRecord(slot, r);
+    compactIfNeeded();
+    mutated();
+    if (oldPlant) notifyUpdated(*oldPlant, plant);
+}
+
+// Returns the Plant object with the given name
+Plant BinaryPlantRepository::getPlantByName(const string &name) const {
+    ensureIndexed();
+    auto it = index.find(name);
+    if (it == index.end()) { throw PlantNotFoundException(name); }
+    return plantAt(it->second);
+}
+
+// Returns a vector of all plants in slot order
+vector<Plant> BinaryPlantRepository::getAllPlants() const {
+    const Header &h = header();
+    vector<Plant> result;
+    result.reserve(h.liveCount);
+    for (uint64_t slot = 0; slot < h.recordCount; ++slot)
+        if (!(record(slot).flags & removedFlag)) result.push_back(plantAt(slot));
+    return result;
+}
+
+// Calls visitor with a temporary Plant for every live record
+void BinaryPlantRepository::forEachPlant(const function<void(const Plant&)> &visitor) const {
+    const Header &h = header();
+    for (uint64_t slot = 0; slot < h.recordCount; ++slot)
+        if (!(record(slot).flags & removedFlag)) visitor(plantAt(slot));
+}
+
+// Number of records, removed ones included
+size_t BinaryPlantRepository::slotCount() const { return header().recordCount; }
+
+// Visits the live records of [first, last); only reads the mapping
+void BinaryPlantRepository::forEachPlantInSlots(size_t first, size_t last,
+                                                const function<void(const Plant&)> &visitor) const {
+    last = min<size_t>(last, header().recordCount);
+    for (size_t slot = first; slot < last; ++slot)
+        if (!(record(slot).flags & removedFlag)) visitor(plantAt(slot));
+}
+
+// Checks if a plant with the given name exists in the repository
+bool BinaryPlantRepository::exists(const string& name) const {
+    ensureIndexed();
+    return index.contains(name);
+}
+
+// Starts recording original records
+void BinaryPlantRepository::beginBatch() {
+    if (batchOpen) { throw runtime_error("A batch is already in progress"); }
+    batchOpen = true;
+    batchHeader = header();
+    batchUndo.clear();
+    batchMutations = 0;
+}
+
+// Ends the batch; its changes are already in the mapping
+void BinaryPlantRepository::commit() {
+    if (!batchOpen) { throw runtime_error("No batch in progress"); }
+    batchOpen = false;
+    batchUndo.clear();
+    compactIfNeeded();
+    unsyncedMutations += batchMutations;
+    if (durability != DurabilityPolicy::None && unsyncedMutations > 0) sync();
+}
+
+// Puts back the original records and the header counters (capacities may have grown)
+void BinaryPlantRepository::rollback() {
+    if (!batchOpen) { throw runtime_error("No batch in progress"); }
+    Header &h = header();
+
+    // Unindex what the batch appended or changed...
+    if (indexed) {
+        for (uint64_t slot = batchHeader.recordCount; slot < h.recordCount; ++slot)
+            if (!(record(slot).flags & removedFlag)) index.erase(string(text(record(slot).nameOffset, record(slot).nameLength)));
+        for (const auto &[slot, original] : batchUndo)
+            if (!(record(slot).flags & removedFlag)) index.erase(string(text(record(slot).nameOffset, record(slot).nameLength)));
+    }
+
+    // ...then restore the records (with their checksums) and index them again
+    for (const auto &[slot, original] : batchUndo) {
+        record(slot) = original;
+        if (indexed && !(original.flags & removedFlag)) index[string(text(original.nameOffset, original.nameLength))] = slot;
+    }
+    h.recordCount = batchHeader.recordCount;
+    h.heapSize = batchHeader.heapSize;
+    h.liveCount = batchHeader.liveCount;
+    h.deadHeapBytes = batchHeader.deadHeapBytes;
+
+    batchOpen = false;
+    batchUndo.clear();
+    notifyReset();
+}
+
+// Flushes modified pages to disk
+void BinaryPlantRepository::sync() {
+    file->sync();
+    if (unsyncedMutations > 0) ++syncCount;
+    unsyncedMutations = 0;
+}
+
+// Only Always syncs single mutations; a batch is synced by its commit
+void BinaryPlantRepository::mutated() {
+    if (batchOpen) {
+        ++batchMutations;
+        return;
+    }
+    ++unsyncedMutations;
+    if (durability == DurabilityPolicy::Always) sync();
+}
+
+// Checks what opening a clean file skips
+void BinaryPlantRepository::verify() const {
+    const Header &h = header();
+    unordered_set<string_view> names;
+    names.reserve(h.liveCount);
+    uint64_t live = 0, usedBytes = 0;
+    for (uint64_t slot = 0; slot < h.recordCount; ++slot) {
+        if (!recordIntact(slot)) throw invalid("record " + to_string(slot) + " is damaged");
+        const Record &r = record(slot);
+        if (r.flags & removedFlag) continue;
+        ++live;
+        usedBytes += r.nameLength + r.speciesLength;
+        if (!names.insert(text(r.nameOffset, r.nameLength)).second)
+            throw invalid("duplicate name in record " + to_string(slot));
+    }
+    if (live != h.liveCount) throw invalid("live count mismatch");
+    if (h.heapSize - usedBytes != h.deadHeapBytes) throw invalid("dead heap byte count mismatch");
+}
+
+// Syncs whatever the policy left in the OS cache
+void BinaryPlantRepository::flush() {
+    if (durability != DurabilityPolicy::None) sync();
+}
+
+// Reports the syncs and the mutations a power loss could still undo
+PersistenceStats BinaryPlantRepository::persistenceStats() const {
+    PersistenceStats result;
+    if (durability == DurabilityPolicy::None) return result;
+    result.fileSyncs = syncCount;
+    result.unsyncedMutations = unsyncedMutations;
+    return result;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include "plant_repository.h"
+#include "mapped_file.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Concrete implementation of PlantRepository that stores plants in a compact,
+// versioned binary file which is memory-mapped and used in place.
+//
+// Layout (native little-endian): a 72-byte header, a table of fixed-size
+// records (one per plant slot, in insertion order) and a heap holding the
+// name and species bytes. Opening only validates the header, so it takes the
+// same time for any file size; the name index is built by the first lookup
+// by name. Quantity and price updates rewrite one record in place. Removed
+// plants are flagged in their record; they and the species strings replaced
+// by updates are dropped when the file is compacted.
+// Growing the table or heap writes a new file and renames it over the old one;
+// the directory is synced after such a rename unless the policy is None.
+//
+// Each record carries a checksum over its fields and strings. The header is
+// flagged dirty, and synced, before the first change after opening, and
+// cleaned when the repository is closed. Opening a dirty file (left by a
+// crash) checks every record and drops the torn ones, so a torn write loses
+// the plant it was writing instead of the whole file. verify() checks a
+// clean file the same way on request.
+class BinaryPlantRepository : public PlantRepository {
+public:
+    // Current version of the file format
+    static constexpr uint32_t formatVersion = 2;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        uint64_t recordCount;    // Used slots, including removed ones
+        uint64_t recordCapacity;
+        uint64_t heapSize;       // Used heap bytes
+        uint64_t heapCapacity;
+        uint64_t liveCount;      // Slots holding a plant
+        uint64_t deadHeapBytes;  // Strings of removed records and replaced species
+        uint64_t flags;
+    };
+    static constexpr uint64_t dirtyFlag = 1; // Changed since the last clean close
+
+    struct Record {
+        uint64_t nameOffset;
+        uint64_t speciesOffset;
+        uint32_t nameLength;
+        uint32_t speciesLength;
+        double price;
+        int32_t quantity;
+        uint32_t flags;
+        uint64_t checksum;       // Of the fields above, the slot and both strings
+    };
+    static constexpr uint32_t removedFlag = 1;
+
+    string filename;
+    DurabilityPolicy durability;
+    unique_ptr<WritableMappedFile> file;
+    mutable unordered_map<string, uint64_t> index; // name -> slot, once indexed
+    mutable atomic<bool> indexed = false;
+    mutable mutex indexLock;
+
+    // Open batch: original records of the slots it touched and the header at its start
+    bool batchOpen = false;
+    unordered_map<uint64_t, Record> batchUndo;
+    Header batchHeader{};
+
+    Header &header() const { return *reinterpret_cast<Header *>(file->data()); }
+    Record &record(uint64_t slot) const;
+    char *heap() const;
+    string_view text(uint64_t offset, uint32_t length) const;
+    Plant plantAt(uint64_t slot) const;
+
+    // Error for a file that is not a valid plant binary file
+    runtime_error invalid(const string &why) const;
+
+    // Checksum of a record whose strings are already in the heap
+    static uint64_t recordChecksum(const Record &value, uint64_t slot, const char *heap);
+
+    // Checks a used slot's string ranges and checksum
+    bool recordIntact(uint64_t slot) const;
+
+    // Creates an empty file, or validates the header of an existing one and
+    // recovers it if it was not closed cleanly
+    void openFile();
+
+    // Replaces the torn records of a dirty file with removed ones, then cleans it
+    void recover();
+
+    // Builds the name index on first use
+    void ensureIndexed() const;
+
+    // Flags the file dirty on disk before the first change to the mapping
+    void beginChange();
+
+    // Grows the record table and/or heap so the given amounts fit
+    void reserve(uint64_t records, uint64_t heapBytes);
+
+    // Appends bytes to the heap and returns their offset
+    uint64_t appendText(string_view text);
+
+    // Replaces a record, setting its checksum
+    void writeRecord(uint64_t slot, Record value);
+
+    // Remembers a record before the open batch first changes it
+    void recordUndo(uint64_t slot);
+
+    // Rewrites the file without removed slots and unreferenced heap bytes
+    void compactIfNeeded();
+
+    // Committed mutations changed in the mapping since the last sync, the
+    // mutations of the open batch and the syncs so far
+    uint64_t unsyncedMutations = 0;
+    uint64_t batchMutations = 0;
+    uint64_t syncCount = 0;
+
+    // Counts a mutation and syncs it if the policy asks for it; inside a
+    // batch the commit decides
+    void mutated();
+
+public:
+    // Constructor; creates the file if it does not exist. Under GroupCommit the
+    // mapping is synced by commit and flush, as there is no syncer thread.
+    explicit BinaryPlantRepository(string filename, DurabilityPolicy durability = DurabilityPolicy::None);
+
+    // Writes the given plants to a new binary file at path
+    static void writeFile(const string &path, const vector<Plant> &plants);
+
+    // Adds a new plant to the repository
+    void addPlant(const Plant& plant) override;
+
+    // Removes a plant by name from the repository
+    void removePlant(const string& name) override;
+
+    // Updates a plant (by name) in the repository; in place unless the species changes
+    void updatePlant(const Plant& plant) override;
+
+    // Retrieves a plant by name
+    Plant getPlantByName(const string &name) const override;
+
+    // Returns a vector with all plants in the repository
+    vector<Plant> getAllPlants() const override;
+
+    // Visits all plants in slot order; each is built from its record on the fly
+    void forEachPlant(const function<void(const Plant&)> &visitor) const override;
+
+    // Slots are records, removed ones included
+    size_t slotCount() const override;
+    void forEachPlantInSlots(size_t first, size_t last, const function<void(const Plant&)> &visitor) const override;
+
+    // Checks if a plant with the given name exists in the repository
+    bool exists(const string& name) const override;
+
+    // Starts a batch; changes still go to the mapping but can be rolled back
+    void beginBatch() override;
+
+    // Ends the batch; its changes are already in the mapping
+    void commit() override;
+
+    // Restores every record and the header as they were before beginBatch
+    void rollback() override;
+
+    // Checks if a batch is currently open
+    bool inBatch() const override { return batchOpen; }
+
+    // Flushes modified pages to disk
+    void sync();
+
+    // Syncs the mapping unless the policy is None
+    void flush() override;
+
+    // Checks every record and the name index of the file; throws runtime_error
+    // naming the first damaged record. Reads the whole file.
+    void verify() const;
+
+    // Only the sync counters are filled in; every mutation is written in place
+    PersistenceStats persistenceStats() const override;
+
+    // Destructor; syncs the file and marks it clean
+    ~BinaryPlantRepository() override;
+};
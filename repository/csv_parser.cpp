@@ -0,0 +1,254 @@
+#include "csv_parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Index of the lowest set bit of a non-zero match mask
+static inline unsigned firstBit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return bit;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Scans for a delimiter; vector loads compare a whole block against ',', '\n'
+// and '\r' at once and the first hit is taken from the match mask
+const char *CSVParser::findDelimiter(const char *begin, const char *end) {
+    const char *p = begin;
+#if defined(__AVX2__)
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i carriage = _mm256_set1_epi8('\r');
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, comma), _mm256_cmpeq_epi8(block, newline)),
+            _mm256_cmpeq_epi8(block, carriage));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask) return p + firstBit(mask);
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i comma16 = _mm_set1_epi8(',');
+    const __m128i newline16 = _mm_set1_epi8('\n');
+    const __m128i carriage16 = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, comma16), _mm_cmpeq_epi8(block, newline16)),
+            _mm_cmpeq_epi8(block, carriage16));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask) return p + firstBit(mask);
+        p += 16;
+    }
+#endif
+    // Scalar fallback and tail
+    while (p < end && *p != ',' && *p != '\n' && *p != '\r') ++p;
+    return p;
+}
+
+// Returns the offset of the second line
+size_t CSVParser::skipHeader(string_view data) {
+    size_t newline = data.find('\n');
+    return newline == string_view::npos ? data.size() : newline + 1;
+}
+
+// Counts '\n' bytes
+size_t CSVParser::countLines(string_view data) {
+    return static_cast<size_t>(count(data.begin(), data.end(), '\n'));
+}
+
+namespace {
+
+// Thrown with the file line number of the malformed record
+[[noreturn]] void parseError(const string &what, size_t line) {
+    throw runtime_error("Invalid CSV record on line " + to_string(line) + ": " + what);
+}
+
+// Trims spaces and tabs on both sides of a field
+string_view trim(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+    return field;
+}
+
+// Reads one field starting at p and leaves p on the delimiter that ends it.
+// Quoted fields without escaped quotes are returned as views into the input;
+// otherwise the unescaped text is built in storage.
+string_view readField(const char *&p, const char *end, string &storage, size_t &line) {
+    if (p == end || *p != '"') {
+        const char *start = p;
+        p = CSVParser::findDelimiter(p, end);
+        return {start, static_cast<size_t>(p - start)};
+    }
+
+    const char *start = ++p;
+    bool escaped = false;
+    storage.clear();
+    while (true) {
+        const char *quote = static_cast<const char *>(memchr(p, '"', static_cast<size_t>(end - p)));
+        if (!quote) parseError("unterminated quoted field", line);
+        line += static_cast<size_t>(count(p, quote, '\n'));
+        if (quote + 1 < end && quote[1] == '"') {
+            storage.append(start, quote + 1); // Keep one quote of the pair
+            p = start = quote + 2;
+            escaped = true;
+            continue;
+        }
+        p = quote + 1;
+        // Anything between the closing quote and the delimiter is ignored
+        p = CSVParser::findDelimiter(p, end);
+        if (!escaped) return {start, static_cast<size_t>(quote - start)};
+        storage.append(start, quote);
+        return storage;
+    }
+}
+
+// Falls back to stoi / stod, which the loader used before, so the spellings
+// they accepted still load: a leading '+' and trailing text after the number
+// (a quantity of "5.0" reads as 5)
+template <typename Number>
+bool readLegacyNumber(string_view field, Number &value) {
+    try {
+        if constexpr (is_same_v<Number, int>) value = stoi(string(field));
+        else value = stod(string(field));
+        return true;
+    } catch (const logic_error &) {
+        return false;
+    }
+}
+
+// Parses a whole field as a number with from_chars
+template <typename Number>
+Number readNumber(string_view field, const char *what, size_t line) {
+    field = trim(field);
+    Number value{};
+    auto [next, error] = from_chars(field.data(), field.data() + field.size(), value);
+    if ((error != errc() || next != field.data() + field.size() || field.empty()) && !readLegacyNumber(field, value))
+        parseError(string("invalid ") + what + " '" + string(field) + "'", line);
+    return value;
+}
+
+} // namespace
+
+// Parses records one line at a time; extra fields after the price are ignored
+void CSVParser::parse(string_view data, vector<Plant> &out, size_t firstLine) {
+    const char *p = data.data();
+    const char *end = p + data.size();
+    size_t line = firstLine;
+    string storage[4];
+    string_view fields[4];
+
+    while (p < end) {
+        // Skip blank lines
+        if (*p == '\n') { ++p; ++line; continue; }
+        if (*p == '\r') { ++p; continue; }
+
+        size_t recordLine = line;
+        for (int i = 0; i < 4; ++i) {
+            if (i > 0) {
+                if (p == end || *p != ',') parseError("expected 4 fields", recordLine);
+                ++p;
+            }
+            fields[i] = readField(p, end, storage[i], line);
+        }
+
+        // Skip any extra fields up to the end of the line
+        if (p < end && *p == ',') {
+            const char *newline = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            p = newline ? newline : end;
+        }
+        if (p < end && *p == '\r') ++p;
+        if (p < end && *p == '\n') { ++p; ++line; }
+
+        out.emplace_back(string(fields[0]), string(fields[1]),
+                         readNumber<int>(fields[2], "quantity", recordLine),
+                         readNumber<double>(fields[3], "price", recordLine));
+    }
+}
+
+// Chunks smaller than this are not worth a thread
+static constexpr size_t minChunkBytes = 1 << 20;
+
+// Cuts data at the first newline after every 1/threads of its size, then parses
+// each chunk on its own thread. Line numbers for error messages are counted
+// per chunk before parsing starts.
+vector<vector<Plant>> CSVParser::parseParallel(string_view data, unsigned threads, size_t firstLine) {
+    size_t chunkCount = min<size_t>(max(threads, 1u), max<size_t>(data.size() / minChunkBytes, 1));
+    if (chunkCount == 1 || data.find('"') != string_view::npos) {
+        vector<vector<Plant>> result(1);
+        result[0].reserve(countLines(data) + 1);
+        parse(data, result[0], firstLine);
+        return result;
+    }
+
+    // Newline-aligned chunk boundaries and the first line number of each chunk
+    vector<string_view> chunks;
+    vector<size_t> chunkLines;
+    size_t start = 0, line = firstLine;
+    for (size_t i = 1; i <= chunkCount && start < data.size(); ++i) {
+        size_t end = i == chunkCount ? data.size() : data.size() * i / chunkCount;
+        if (end < start) end = start;
+        size_t newline = data.find('\n', end);
+        end = i == chunkCount || newline == string_view::npos ? data.size() : newline + 1;
+        chunks.push_back(data.substr(start, end - start));
+        chunkLines.push_back(line);
+        line += countLines(chunks.back());
+        start = end;
+    }
+
+    vector<vector<Plant>> result(chunks.size());
+    vector<exception_ptr> errors(chunks.size());
+    vector<thread> workers;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        workers.emplace_back([&, i] {
+            try {
+                result[i].reserve(countLines(chunks[i]) + 1);
+                parse(chunks[i], result[i], chunkLines[i]);
+            } catch (...) {
+                errors[i] = current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) worker.join();
+
+    // Report the first error in file order
+    for (const auto &error : errors)
+        if (error) rethrow_exception(error);
+    return result;
+}
+
+// Wraps the field in quotes and doubles inner quotes when needed
+string CSVParser::quote(const string &field) {
+    if (field.find_first_of(",\"\r\n") == string::npos) return field;
+    string quoted = "\"";
+    for (char c : field) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+// Shortest round-trip formatting via to_chars
+string CSVParser::formatPrice(double price) {
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), price);
+    return string(buffer, result.ptr);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "../Model/plant.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Parsing and formatting helpers for the inventory CSV format
+// (name, species, quantity, price), with RFC 4180 quoting.
+// The parser works directly on a memory buffer: fields are string_views into
+// the input, numbers are read with from_chars, and the only allocations are
+// the strings of the constructed plants.
+class CSVParser {
+public:
+    // Returns a pointer to the first ',', '\n' or '\r' in [begin, end), or end.
+    // Scans 32 or 16 bytes at a time when the build enables AVX2 or SSE2.
+    static const char *findDelimiter(const char *begin, const char *end);
+
+    // Returns the offset just past the first line (the header)
+    static size_t skipHeader(string_view data);
+
+    // Counts the line breaks in data; used to reserve room before parsing
+    static size_t countLines(string_view data);
+
+    // Parses every record in data and appends the plants to out.
+    // firstLine is the file line number of data's first line, for error messages.
+    // Throws runtime_error on malformed records.
+    static void parse(string_view data, vector<Plant> &out, size_t firstLine = 2);
+
+    // Splits data into newline-aligned chunks and parses them on up to
+    // 'threads' threads. Returns the plants of each chunk, in file order.
+    // Small inputs, and inputs containing quotes (where a newline may sit
+    // inside a field), are parsed on the calling thread as a single chunk.
+    static vector<vector<Plant>> parseParallel(string_view data, unsigned threads, size_t firstLine = 2);
+
+    // Quotes a field if it contains a comma, quote or line break
+    static string quote(const string &field);
+
+    // Formats a price with the shortest representation that reads back exactly
+    static string formatPrice(double price);
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include "plant_repository.h"
+#include "file_plant_repository.h"
 
 #include <string>
 #include <fstream>
@@ -8,45 +8,21 @@
 using namespace std;
 
 // Concrete implementation of PlantRepository that stores plants in a CSV file
-class CSVPlantRepository : public PlantRepository {
+class CSVPlantRepository : public FilePlantRepository {
 private:
-       string filename;
-       vector<Plant> plants;
+       // Loads all plants from the CSV file into 'plants'
+       void loadFromFile() override;
 
-       // Loads all plants from the CSV file into the 'plants' vector
-       void loadFromFile();
-
-       // Writes all plants from the 'plants' vector back to the CSV file
-       void saveToFile() const;
-
-       // Parses a single line from the CSV file and adds the plant to 'plants'
-       void parseCSVLine(const string &line);
+       // Writes the given plants to a CSV file at path
+       void writePlants(const string &path, const PlantStore &plants) const override;
 
        // Converts a Plant object to a CSV-formatted line
        string plantToCSVLine(const Plant &plant) const;
 
 public:
        // Constructor
-       explicit CSVPlantRepository(string filename);
-
-       // Adds a new plant to the repository
-       void addPlant(const Plant& plant) override;
-
-       // Removes a plant by name from the repository
-       void removePlant(const string& name) override;
-
-       // Updates a plant (by name) in the repository
-       void updatePlant(const Plant& plant) override;
-
-       // Retrieves a plant by name
-       Plant getPlantByName(const string &name) const override;
-
-       // Returns a vector with all plants in the repository
-       vector<Plant> getAllPlants() const override;
-
-       // Checks if a plant with the given name exists in the repository
-       bool exists(const string& name) const override;
+       explicit CSVPlantRepository(string filename, FileRepositoryOptions options = {});
 
        // Destructor
-       ~CSVPlantRepository() override = default;
+       ~CSVPlantRepository() override { close(); }
 };
@@ -0,0 +1,460 @@
+#include "file_plant_repository.h"
+#include "file_sync.h"
+
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+using namespace std;
+
+// Constructor
+FilePlantRepository::FilePlantRepository(string filename, FileRepositoryOptions options)
+    : filename(move(filename)), options(options) {}
+
+// Destructor
+FilePlantRepository::~FilePlantRepository() { close(); }
+
+// Joins the background threads without throwing; used on destruction.
+// An open batch is dropped first, as it would be without write-behind.
+void FilePlantRepository::close() {
+    if (compactor.joinable()) compactor.join();
+    if (groupSyncer.joinable()) {
+        {
+            lock_guard<mutex> guard(syncLock);
+            syncerStopping = true;
+        }
+        syncerWake.notify_one();
+        groupSyncer.join();
+    }
+    if (options.durability != DurabilityPolicy::None) {
+        try { syncWritten(); } catch (...) {}
+    }
+    if (!backgroundWriter.joinable()) return;
+    {
+        lock_guard<mutex> guard(storeLock);
+        if (batchOpen) {
+            plants.rollbackBatch();
+            batchOpen = false;
+        }
+        failedCount = 0; // One last attempt after a failed save
+        writerStopping = true;
+    }
+    writerWake.notify_one();
+    backgroundWriter.join();
+}
+
+// Loads the base file, then replays a leftover compacting log and the live log
+void FilePlantRepository::open() {
+    loadFromFile();
+
+    bool hadJournal = filesystem::exists(compactingPath()) || filesystem::exists(journalPath());
+    // Records of a failed compaction count too: the next rotation merges them
+    size_t records = replayJournal(compactingPath());
+    records += replayJournal(journalPath());
+
+    bool durable = options.durability != DurabilityPolicy::None;
+    if (options.mode == PersistenceMode::Journaled) {
+        journal = make_unique<PlantJournal>(journalPath(), records);
+        if (durable) syncDirectoryOf(journalPath());
+    } else if (hadJournal) {
+        // Switching back to rewrite mode: fold the logs into the base file once
+        saveToFile(durable);
+        filesystem::remove(compactingPath());
+        filesystem::remove(journalPath());
+    }
+    if (options.mode == PersistenceMode::WriteBehind) backgroundWriter = thread([this] { writeBehindLoop(); });
+    else if (options.durability == DurabilityPolicy::GroupCommit) groupSyncer = thread([this] { groupSyncLoop(); });
+}
+
+// Always syncs; the others only when the policy's limit is reached
+bool FilePlantRepository::syncRequired(size_t mutations, bool batchCommit) {
+    switch (options.durability) {
+    case DurabilityPolicy::None: return false;
+    case DurabilityPolicy::PerBatch: return batchCommit;
+    case DurabilityPolicy::Always: return true;
+    case DurabilityPolicy::GroupCommit: break;
+    }
+    lock_guard<mutex> guard(syncLock);
+    return writtenMutations - syncedMutations + mutations >= options.groupCommitMutations;
+}
+
+// A synced write also syncs every earlier one: the journal or the new base file holds them all
+void FilePlantRepository::recordWrite(size_t mutations, bool synced) {
+    if (options.durability == DurabilityPolicy::None) return;
+    bool firstUnsynced = false;
+    {
+        lock_guard<mutex> guard(syncLock);
+        if (!synced && writtenMutations == syncedMutations) {
+            firstUnsynced = true;
+            oldestUnsynced = chrono::steady_clock::now();
+        }
+        writtenMutations += mutations;
+        if (synced) {
+            syncedMutations = writtenMutations;
+            ++syncCount;
+        }
+    }
+    if (firstUnsynced) syncerWake.notify_one(); // Later ones are due no earlier
+}
+
+// Only the mutations written before the fsync started count as synced
+void FilePlantRepository::syncWritten() {
+    lock_guard<mutex> fileGuard(fileSyncLock);
+    uint64_t target;
+    {
+        lock_guard<mutex> guard(syncLock);
+        if (writtenMutations == syncedMutations) return;
+        target = writtenMutations;
+    }
+    if (journal) {
+        syncFile(journalPath());
+    } else {
+        syncFile(filename);
+        syncDirectoryOf(filename);
+    }
+    lock_guard<mutex> guard(syncLock);
+    syncedMutations = max(syncedMutations, target);
+    ++syncCount;
+}
+
+// Sleeps until the oldest unsynced mutation is groupCommitMs old, then syncs
+// it together with everything written after it. A failed sync is retried on
+// the next round.
+void FilePlantRepository::groupSyncLoop() {
+    unique_lock<mutex> lock(syncLock);
+    while (true) {
+        syncerWake.wait(lock, [this] { return syncerStopping || writtenMutations > syncedMutations; });
+        if (syncerStopping) return;
+        auto due = oldestUnsynced + chrono::milliseconds(options.groupCommitMs);
+        if (chrono::steady_clock::now() < due) {
+            syncerWake.wait_until(lock, due, [this] { return syncerStopping; });
+            continue; // Re-check: a mutation may have synced them meanwhile
+        }
+        lock.unlock();
+        try {
+            syncWritten();
+        } catch (...) {
+            this_thread::sleep_for(chrono::milliseconds(options.groupCommitMs));
+        }
+        lock.lock();
+    }
+}
+
+// Engaged only while a background writer may be copying the plants
+unique_lock<mutex> FilePlantRepository::lockStore() {
+    if (!backgroundWriter.joinable()) return {};
+    return unique_lock<mutex>(storeLock);
+}
+
+// Counts the mutations with the current time for the latency metric
+void FilePlantRepository::markDirty(size_t mutations) {
+    double now = chrono::duration<double, milli>(chrono::steady_clock::now() - openedAt).count();
+    {
+        lock_guard<mutex> guard(storeLock);
+        if (untakenMutations == 0) untakenOldest = now;
+        mutationCount += mutations;
+        untakenMutations += mutations;
+        untakenTimeSum += mutations * now;
+    }
+    writerWake.notify_one();
+}
+
+// Saves a copy of the plants whenever committed mutations are pending. The
+// mutations that arrive during a save are written together by the next one.
+void FilePlantRepository::writeBehindLoop() {
+    unique_lock<mutex> lock(storeLock);
+    while (true) {
+        writerWake.wait(lock, [this] { return writerStopping || writeDue(); });
+        if (!writeDue()) return; // Stopping, and nothing left that could be saved
+
+        PlantStore copy = plants;
+        uint64_t target = mutationCount;
+        uint64_t taken = untakenMutations;
+        double takenTimeSum = untakenTimeSum, takenOldest = untakenOldest;
+        untakenMutations = 0;
+        untakenTimeSum = 0;
+        lock.unlock();
+
+        exception_ptr error;
+        string message;
+        try {
+            saveToFile(copy, options.durability != DurabilityPolicy::None);
+        } catch (const exception &e) {
+            error = current_exception();
+            message = e.what();
+        } catch (...) {
+            error = current_exception();
+            message = "unknown error";
+        }
+        double done = chrono::duration<double, milli>(chrono::steady_clock::now() - openedAt).count();
+
+        lock.lock();
+        if (error) {
+            // Hand the mutations back; they are retried with the next save
+            writeError = error;
+            writeStats.lastSaveError = message;
+            failedCount = target;
+            untakenOldest = takenOldest;
+            untakenMutations += taken;
+            untakenTimeSum += takenTimeSum;
+        } else {
+            writeError = nullptr;
+            writeStats.lastSaveError.clear();
+            savedCount = target;
+            ++writeStats.fileWrites;
+            writeStats.mutationsWritten += taken;
+            writeStats.lastLatencyMs = done - takenOldest;
+            writeStats.maxLatencyMs = max(writeStats.maxLatencyMs, writeStats.lastLatencyMs);
+            latencySum += taken * done - takenTimeSum;
+            recordWrite(taken, options.durability != DurabilityPolicy::None);
+        }
+        writeFinished.notify_all();
+    }
+}
+
+// Asks for a save (again, if the last one failed) and waits for its outcome;
+// without write-behind it syncs and reports a failed compaction
+void FilePlantRepository::flush() {
+    if (!backgroundWriter.joinable()) {
+        if (options.durability != DurabilityPolicy::None) syncWritten();
+        waitForCompaction();
+        return;
+    }
+    if (batchOpen) { throw runtime_error("Cannot flush while a batch is in progress"); }
+    unique_lock<mutex> lock(storeLock);
+    uint64_t target = mutationCount;
+    failedCount = 0;
+    writeError = nullptr;
+    writerWake.notify_one();
+    writeFinished.wait(lock, [this, target] { return savedCount >= target || writeError; });
+    if (writeError) {
+        exception_ptr error = writeError;
+        writeError = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+// Copies the counters under their locks
+PersistenceStats FilePlantRepository::persistenceStats() const {
+    lock_guard<mutex> guard(storeLock);
+    PersistenceStats result = writeStats;
+    result.pendingMutations = mutationCount - savedCount;
+    result.meanLatencyMs = writeStats.mutationsWritten ? latencySum / writeStats.mutationsWritten : 0;
+    lock_guard<mutex> syncGuard(syncLock);
+    result.fileSyncs = syncCount;
+    result.unsyncedMutations = writtenMutations - syncedMutations;
+    return result;
+}
+
+// Applies every record of the journal at path to the in-memory plants
+size_t FilePlantRepository::replayJournal(const string &path) {
+    return PlantJournal::replay(path, [this](PlantJournal::Operation operation, const Plant &plant) {
+        if (operation == PlantJournal::Operation::Remove) {
+            plants.remove(plant.getName());
+        } else if (!plants.update(plant)) {
+            plants.add(plant);
+        }
+    });
+}
+
+// Writes the plants to a temporary file and renames it over the base file,
+// so readers never see a half-written file
+void FilePlantRepository::saveToFile(const PlantStore &source, bool sync) const {
+    string tempPath = filename + ".tmp";
+    writePlants(tempPath, source);
+    if (sync) syncFile(tempPath);
+    filesystem::rename(tempPath, filename);
+    if (sync) syncDirectoryOf(filename);
+}
+
+// Records a mutation: one log record in journaled mode, a full rewrite otherwise.
+// Inside a batch nothing is written until commit.
+void FilePlantRepository::persist(PlantJournal::Operation operation, const Plant &plant) {
+    if (batchOpen) {
+        if (journal) batchRecords.emplace_back(operation, plant);
+        ++batchMutations;
+        return;
+    }
+    if (backgroundWriter.joinable()) {
+        markDirty(1);
+        return;
+    }
+    bool sync = syncRequired(1, false);
+    if (!journal) {
+        {
+            // The group syncer must not sync the old file while the new one replaces it
+            lock_guard<mutex> fileGuard(fileSyncLock);
+            saveToFile(sync);
+        }
+        recordWrite(1, sync);
+        return;
+    }
+    journal->append(operation, plant);
+    if (sync) syncFile(journalPath());
+    recordWrite(1, sync);
+    compactIfDue();
+}
+
+// Starts a compaction once the journal is long enough. Its errors, like those
+// of the compaction itself, are left for flush(): the mutation that got here is
+// already applied and logged, so it must not fail.
+void FilePlantRepository::compactIfDue() {
+    if (!journal || journal->size() < options.compactAfter) return;
+    try {
+        startCompaction();
+    } catch (...) {
+        compactionError = current_exception();
+    }
+}
+
+// Moves the journal aside and folds it into a new base file on a background thread.
+// The plants are copied here, so the main thread can keep mutating meanwhile.
+// Records left by a failed compaction are merged, not overwritten, and the
+// new base file covers them as well.
+void FilePlantRepository::startCompaction() {
+    if (compactor.joinable()) compactor.join();
+    compactionError = nullptr; // This run supersedes the last one
+    bool durable = options.durability != DurabilityPolicy::None;
+    {
+        // The rotated records must be on the disk before the journal moves:
+        // the syncer only ever syncs the live journal
+        lock_guard<mutex> fileGuard(fileSyncLock);
+        if (durable) {
+            syncFile(journalPath());
+            lock_guard<mutex> guard(syncLock);
+            if (syncedMutations != writtenMutations) ++syncCount;
+            syncedMutations = writtenMutations;
+        }
+        journal->rotate(compactingPath(), durable);
+        if (durable) syncDirectoryOf(journalPath());
+    }
+
+    compactor = thread([this, durable, snapshot = plants] {
+        try {
+            saveToFile(snapshot, durable);
+            filesystem::remove(compactingPath());
+        } catch (...) {
+            compactionError = current_exception();
+        }
+    });
+}
+
+// Joins the compactor thread and reports a failed compaction or rotation to the caller
+void FilePlantRepository::waitForCompaction() {
+    if (compactor.joinable()) compactor.join();
+    if (compactionError) {
+        exception_ptr error = compactionError;
+        compactionError = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+// Starts recording mutations in memory
+void FilePlantRepository::beginBatch() {
+    if (batchOpen) { throw runtime_error("A batch is already in progress"); }
+    auto guard = lockStore();
+    plants.beginBatch();
+    batchOpen = true;
+    batchMutations = 0;
+}
+
+// Persists the batch; if writing fails the batch is rolled back and the error rethrown
+void FilePlantRepository::commit() {
+    if (!batchOpen) { throw runtime_error("No batch in progress"); }
+    bool sync = false;
+    try {
+        if (!backgroundWriter.joinable()) sync = syncRequired(batchMutations, true);
+        if (journal) {
+            journal->appendAll(batchRecords);
+            if (sync) syncFile(journalPath());
+        } else if (!backgroundWriter.joinable()) {
+            lock_guard<mutex> fileGuard(fileSyncLock);
+            saveToFile(sync);
+        }
+    } catch (...) {
+        rollback();
+        throw;
+    }
+    {
+        auto guard = lockStore();
+        batchOpen = false;
+        plants.commitBatch();
+    }
+    batchRecords.clear();
+    if (backgroundWriter.joinable()) {
+        if (batchMutations > 0) markDirty(batchMutations);
+    } else {
+        recordWrite(batchMutations, sync);
+    }
+    compactIfDue();
+}
+
+// Drops the batch without writing anything
+void FilePlantRepository::rollback() {
+    if (!batchOpen) { throw runtime_error("No batch in progress"); }
+    {
+        auto guard = lockStore();
+        plants.rollbackBatch();
+        batchOpen = false;
+    }
+    batchRecords.clear();
+    notifyReset();
+}
+
+// Forces a compaction and waits until the new base file is written
+void FilePlantRepository::compact() {
+    if (!journal) return;
+    startCompaction();
+    waitForCompaction();
+}
+
+// Adds a new plant to the repository and persists it
+void FilePlantRepository::addPlant(const Plant& plant) {
+    {
+        auto guard = lockStore();
+        if (!plants.add(plant)) { throw DuplicatePlantException(plant.getName()); }
+    }
+    notifyAdded(plant);
+    persist(PlantJournal::Operation::Add, plant);
+}
+
+// Removes a plant by name and persists the removal
+void FilePlantRepository::removePlant(const string& name) {
+    const Plant *existing = plants.find(name);
+    if (!existing) { throw PlantNotFoundException(name); }
+    optional<Plant> removed;
+    if (hasListeners()) removed = *existing;
+    {
+        auto guard = lockStore();
+        plants.remove(name);
+    }
+    if (removed) notifyRemoved(*removed);
+    persist(PlantJournal::Operation::Remove, Plant(name, "", 0, 0));
+}
+
+// Updates a plant by name and persists it
+void FilePlantRepository::updatePlant(const Plant& plant) {
+    const Plant *existing = plants.find(plant.getName());
+    if (!existing) { throw PlantNotFoundException(plant.getName()); }
+    optional<Plant> oldPlant;
+    if (hasListeners()) oldPlant = *existing;
+    {
+        auto guard = lockStore();
+        plants.update(plant);
+    }
+    if (oldPlant) notifyUpdated(*oldPlant, plant);
+    persist(PlantJournal::Operation::Update, plant);
+}
+
+// Returns the Plant object with the given name
+Plant FilePlantRepository::getPlantByName(const string &name) const {
+    const Plant *plant = plants.find(name);
+    if (!plant) { throw PlantNotFoundException(name); }
+    return *plant;
+}
+
+// Returns a vector of all plants in the repository
+vector<Plant> FilePlantRepository::getAllPlants() const { return plants.toVector(); }
+
+// Checks if a plant with the given name exists in the repository
+bool FilePlantRepository::exists(const string& name) const { return plants.contains(name); }
@@ -0,0 +1,237 @@
+#pragma once
+#include "plant_repository.h"
+#include "plant_store.h"
+#include "plant_journal.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// How a file repository persists each mutation
+enum class PersistenceMode {
+    Rewrite,    // Rewrite the whole file after every mutation
+    Journaled,  // Append the mutation to a write-ahead log next to the file
+    WriteBehind // Return right away; a background thread rewrites the file soon after
+};
+
+// Construction options shared by the file-backed repositories
+struct FileRepositoryOptions {
+    PersistenceMode mode = PersistenceMode::Rewrite;
+
+    // Journaled mode: number of log records after which the log is folded
+    // into a fresh base file in the background
+    size_t compactAfter = 10000;
+
+    // Number of threads used to parse the file on load (0 = one per core).
+    // Only the CSV format loads in parallel.
+    unsigned loadThreads = 1;
+
+    // JSON format: write without indentation
+    bool compactJson = false;
+
+    DurabilityPolicy durability = DurabilityPolicy::None;
+
+    // GroupCommit: most mutations, and oldest age of one, that may stay unsynced
+    size_t groupCommitMutations = 256;
+    unsigned groupCommitMs = 20;
+};
+
+// Base class for repositories persisted to a single file (CSV, JSON).
+// Keeps all plants in memory; derived classes only provide the file format.
+//
+// In journaled mode mutations are appended to "<file>.wal" and replayed on
+// load. When the log grows past compactAfter records it is renamed to
+// "<file>.wal.compacting" and a background thread writes a new base file
+// from a copy of the plants, then deletes the old log. Replay is idempotent,
+// so a crash at any point of a compaction loses nothing. If a compaction
+// fails, its log stays; the next rotation appends to it instead of replacing
+// it, and flush() reports the failure.
+//
+// In write-behind mode mutations only change memory. A background writer
+// copies the plants (mutations wait only for the copy, not the disk) and
+// rewrites the file through a temporary file and a rename, so the file always
+// holds a complete committed state. Mutations made while a save runs are
+// coalesced into the next one, and an open batch is never saved. flush() and
+// destruction wait for the pending mutations to be written.
+//
+// The durability policy adds fsync calls on top of any mode. A synced rewrite
+// syncs the temporary file before the rename and the directory after it. In
+// group commit a background thread syncs whatever was written once the oldest
+// unsynced mutation reaches groupCommitMs; the mutation that reaches
+// groupCommitMutations syncs itself. Background saves (write-behind) and
+// compactions are synced under every policy except None. flush() and
+// destruction sync everything written.
+class FilePlantRepository : public PlantRepository {
+protected:
+    string filename;
+    PlantStore plants; // Plants in file order, indexed by name
+    FileRepositoryOptions options;
+
+    // Constructor; derived classes call open() once they are fully constructed
+    FilePlantRepository(string filename, FileRepositoryOptions options);
+
+    // Loads the base file, replays any journal and prepares persistence
+    void open();
+
+    // Reads the base file into 'plants'
+    virtual void loadFromFile() = 0;
+
+    // Writes the given plants to path in the repository's file format
+    virtual void writePlants(const string &path, const PlantStore &plants) const = 0;
+
+    // Writes all plants (or a copy of them) to the base file through a
+    // temporary file, syncing both before the rename returns if requested
+    void saveToFile(bool sync = false) const { saveToFile(plants, sync); }
+    void saveToFile(const PlantStore &source, bool sync) const;
+
+    // Persists one mutation according to the persistence mode
+    void persist(PlantJournal::Operation operation, const Plant &plant);
+
+    // Waits for a running compaction and, in write-behind mode, writes the
+    // pending mutations and stops the writer; derived destructors call it
+    // while writePlants is still available
+    void close();
+
+    // Locks 'plants' against the write-behind copy; an empty lock in other modes
+    unique_lock<mutex> lockStore();
+
+private:
+    unique_ptr<PlantJournal> journal;
+
+    // Open batch: its journal records, written only on commit
+    bool batchOpen = false;
+    vector<pair<PlantJournal::Operation, Plant>> batchRecords;
+
+    thread compactor;
+    exception_ptr compactionError;
+
+    // Write-behind state. storeLock guards the changes of 'plants' and
+    // batchOpen against the writer's copy, and every field below.
+    thread backgroundWriter;
+    mutable mutex storeLock;
+    condition_variable writerWake;
+    condition_variable writeFinished;
+    bool writerStopping = false;
+    uint64_t mutationCount = 0;  // Committed mutations so far
+    uint64_t savedCount = 0;     // Mutations included in the file
+    uint64_t failedCount = 0;    // Mutations included in a failed save; retried on the next mutation or flush
+    size_t batchMutations = 0;   // Mutations of the open batch, counted on commit
+    exception_ptr writeError;    // Failed save, reported by flush
+    chrono::steady_clock::time_point openedAt = chrono::steady_clock::now();
+    uint64_t untakenMutations = 0; // Mutations the writer has not copied yet, their summed
+    double untakenTimeSum = 0;     // times and the oldest time (ms since openedAt)
+    double untakenOldest = 0;
+    PersistenceStats writeStats;
+    double latencySum = 0;
+
+    // Records committed mutations for the writer and wakes it
+    void markDirty(size_t mutations);
+
+    // Checks if the writer has something it may save now
+    bool writeDue() const { return !batchOpen && mutationCount > savedCount && mutationCount > failedCount; }
+
+    // Writer loop: copy under storeLock, save without it
+    void writeBehindLoop();
+
+    // Durability state. syncLock guards the counters; fileSyncLock keeps the
+    // group syncer away from the journal while it is rotated and from the
+    // base file while it is rewritten and renamed.
+    thread groupSyncer;
+    mutable mutex syncLock;
+    mutex fileSyncLock;
+    condition_variable syncerWake;
+    bool syncerStopping = false;
+    uint64_t writtenMutations = 0; // Mutations in the base file or the journal
+    uint64_t syncedMutations = 0;  // Of those, mutations known to be on the disk
+    uint64_t syncCount = 0;
+    chrono::steady_clock::time_point oldestUnsynced;
+
+    // Checks if writing the given number of committed mutations must sync them
+    bool syncRequired(size_t mutations, bool batchCommit);
+
+    // Counts written mutations; synced = the write included an fsync
+    void recordWrite(size_t mutations, bool synced);
+
+    // Syncs the file holding the written mutations (journal or base file)
+    void syncWritten();
+
+    // Group commit loop: syncs once the oldest unsynced mutation is due
+    void groupSyncLoop();
+
+    string journalPath() const { return filename + ".wal"; }
+    string compactingPath() const { return filename + ".wal.compacting"; }
+
+    // Applies journal records to 'plants' (add/update are upserts); returns their number
+    size_t replayJournal(const string &path);
+
+    // Starts a compaction if the journal reached compactAfter, keeping any error for flush()
+    void compactIfDue();
+
+    // Rotates the journal and writes a new base file on the compactor thread
+    void startCompaction();
+
+    // Joins a running compaction and rethrows its error, if any
+    void waitForCompaction();
+
+public:
+    // Adds a new plant to the repository
+    void addPlant(const Plant& plant) override;
+
+    // Removes a plant by name from the repository
+    void removePlant(const string& name) override;
+
+    // Updates a plant (by name) in the repository
+    void updatePlant(const Plant& plant) override;
+
+    // Retrieves a plant by name
+    Plant getPlantByName(const string &name) const override;
+
+    // Returns a vector with all plants in the repository
+    vector<Plant> getAllPlants() const override;
+
+    // Visits all plants in place
+    void forEachPlant(const function<void(const Plant&)> &visitor) const override { plants.forEach(visitor); }
+    size_t slotCount() const override { return plants.slotCount(); }
+    void forEachPlantInSlots(size_t first, size_t last, const function<void(const Plant&)> &visitor) const override {
+        plants.forEach(first, last, visitor);
+    }
+
+    // Checks if a plant with the given name exists in the repository
+    bool exists(const string& name) const override;
+
+    // Starts a batch; throws if one is already open
+    void beginBatch() override;
+
+    // Writes the batch with one file rewrite or one journal append
+    void commit() override;
+
+    // Restores the plants as they were before beginBatch
+    void rollback() override;
+
+    // Checks if a batch is currently open
+    bool inBatch() const override { return batchOpen; }
+
+    // Folds the journal into the base file now and waits for it (journaled mode only)
+    void compact();
+
+    // Write-behind mode: waits until the mutations committed so far are in the
+    // file and rethrows the error of a failed save (a later flush retries it).
+    // Throws if a batch is open. Unless the durability policy is None it then
+    // syncs every written mutation, in all modes. Journaled mode: also waits
+    // for a running compaction and rethrows the error of a failed one; its
+    // records stay in the compacting log and the next compaction retries them.
+    void flush() override;
+
+    // Write-behind latency and backlog, fsync count and unsynced mutations
+    PersistenceStats persistenceStats() const override;
+
+    // Destructor; waits for a running compaction
+    ~FilePlantRepository() override;
+};
@@ -0,0 +1,52 @@
+#include "file_sync.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+// Commits the file with _commit
+void syncFile(const string &path) {
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) { throw runtime_error("Could not open file " + path); }
+    int result = _commit(fd);
+    _close(fd);
+    if (result != 0) { throw runtime_error("Could not sync file " + path); }
+}
+
+// Directory entries are written through on Windows
+void syncDirectoryOf(const string &) {}
+
+#else
+
+// Any descriptor of the file syncs all of its written data, not just its own
+void syncFile(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw runtime_error("Could not open file " + path); }
+    int result = fsync(fd);
+    ::close(fd);
+    if (result != 0) { throw runtime_error("Could not sync file " + path); }
+}
+
+// Opens the parent directory and fsyncs it
+void syncDirectoryOf(const string &path) {
+    filesystem::path parent = filesystem::path(path).parent_path();
+    string directory = parent.empty() ? string(".") : parent.string();
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) { throw runtime_error("Could not open directory " + directory); }
+    int result = fsync(fd);
+    ::close(fd);
+    if (result != 0) { throw runtime_error("Could not sync directory " + directory); }
+}
+
+#endif
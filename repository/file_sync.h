@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+// Forces the data of the file at path from the OS cache to the disk (fsync);
+// throws runtime_error on failure
+void syncFile(const string &path);
+
+// Forces the directory entries of the directory holding path to the disk, so
+// a file created or renamed there survives a crash. No-op where directories
+// cannot be synced.
+void syncDirectoryOf(const string &path);
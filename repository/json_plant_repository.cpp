@@ -1,138 +1,181 @@
 #include "json_plant_repository.h"
+#include "json_stream.h"
 
-#include <QFile>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
 #include <stdexcept>
 
 using namespace std;
 
-// Constructor
-JSONPlantRepository::JSONPlantRepository(string filename)
-    : filename(move(filename)) { loadFromFile(); }
+namespace {
+
+// Thrown by the handler for a name it has already read
+struct DuplicatePlantName {
+    string name;
+};
+
+// Builds plants from the parse events of a {"plants": [ {...}, ... ]} document.
+// Unknown keys and non-object array elements are skipped, and missing fields
+// fall back to empty strings and zero, as the QJsonObject conversion did.
+class PlantJSONHandler : public JSONHandler {
+private:
+    PlantStore &plants;
+    int depth = 0;          // Number of open containers
+    bool rootChecked = false;
+    bool nextIsPlants = false;
+    int plantsDepth = -1;   // Depth of the "plants" array, -1 outside it
+    bool inPlant = false;
+    string currentKey;
+
+    string name, species;
+    int quantity = 0;
+    double price = 0;
+
+    // The first event must open the root object
+    void checkRoot(bool isObject) {
+        if (rootChecked) return;
+        rootChecked = true;
+        if (!isObject) throw invalid_argument("root is not an object");
+    }
 
-// Loads all plants from the JSON file into the 'plants' vector
-void JSONPlantRepository::loadFromFile() {
-    QFile file(QString::fromStdString(filename));
+    // True for values that are direct fields of the plant being read
+    bool isPlantField() const { return inPlant && depth == plantsDepth + 1; }
 
-    // Open file for reading
-    if (!file.open(QIODevice::ReadOnly)) {
-        throw runtime_error("Could not open file " + filename);
+    // A value that is not an array clears a pending "plants" key
+    void scalar() {
+        checkRoot(false);
+        nextIsPlants = false;
     }
-    QByteArray data = file.readAll();
-    QJsonDocument doc = QJsonDocument::fromJson(data);
 
-    // Check if document is valid
-    if (doc.isNull()) {
-        file.close();
-        throw runtime_error("File " + filename + " is not a valid JSON document");
+public:
+    explicit PlantJSONHandler(PlantStore &plants) : plants(plants) {}
+
+    void startObject() override {
+        checkRoot(true);
+        nextIsPlants = false;
+        ++depth;
+        if (plantsDepth >= 0 && depth == plantsDepth + 1) {
+            inPlant = true;
+            name.clear();
+            species.clear();
+            quantity = 0;
+            price = 0;
+        }
     }
 
-    // Check if root is a JSON object
-    if (!doc.isObject()) {
-        file.close();
-        throw runtime_error("File " + filename + " is not a valid JSON object");
+    void endObject() override {
+        if (isPlantField()) {
+            if (plants.contains(name)) throw DuplicatePlantName{name};
+            plants.add(Plant(move(name), move(species), quantity, price));
+            inPlant = false;
+        }
+        --depth;
     }
 
-    QJsonObject json = doc.object();
-    QJsonArray plantsArray = json["plants"].toArray();
-    plants.clear();
+    void startArray() override {
+        checkRoot(false);
+        ++depth;
+        if (nextIsPlants) plantsDepth = depth;
+        nextIsPlants = false;
+    }
 
-    // For each plant in the array, convert it from JSON and add to vector
-    for (const QJsonValue &plantJson : plantsArray) {
-        if (plantJson.isObject()) {
-            QJsonObject plantObject = plantJson.toObject();
-            plants.push_back(plantFromJson(plantObject));
-        }
+    void endArray() override {
+        if (depth == plantsDepth) plantsDepth = -1;
+        --depth;
     }
-    file.close();
-}
 
-// Saves all plants from the 'plants' vector into the JSON file
-void JSONPlantRepository::saveToFile() const {
-    QFile file(QString::fromStdString(filename));
+    void key(string_view key) override {
+        currentKey = key;
+        nextIsPlants = depth == 1 && key == "plants";
+    }
 
-    if (!file.open(QIODevice::WriteOnly)) {
-        throw runtime_error("Could not open file " + filename);
+    void stringValue(string_view value) override {
+        scalar();
+        if (!isPlantField()) return;
+        if (currentKey == "name") name = value;
+        else if (currentKey == "species") species = value;
     }
-    QJsonArray plantsArray;
 
-    // Convert each Plant to JSON and add to array
-    for (const auto &plant : plants) {
-        plantsArray.append(plantToJson(plant));
+    void numberValue(double value) override {
+        scalar();
+        if (!isPlantField()) return;
+        if (currentKey == "quantity") {
+            // Like QJsonValue::toInt, non-integral or out of range numbers read as 0
+            bool integral = value == floor(value) &&
+                value >= numeric_limits<int>::min() && value <= numeric_limits<int>::max();
+            quantity = integral ? static_cast<int>(value) : 0;
+        } else if (currentKey == "price") {
+            price = value;
+        }
     }
-    QJsonObject root;
-    root["plants"] = plantsArray;
 
-    // Create a JSON document and write it in indented form
-    QJsonDocument doc(root);
-    file.write(doc.toJson(QJsonDocument::Indented));
-    file.close();
-}
+    void boolValue(bool) override { scalar(); }
+    void nullValue() override { scalar(); }
+};
 
-// Converts a QJsonObject to a Plant object
-Plant JSONPlantRepository::plantFromJson(const QJsonObject &json) {
-    return Plant(
-        json["name"].toString().toStdString(),
-        json["species"].toString().toStdString(),
-        json["quantity"].toInt(),
-        json["price"].toDouble());
-}
+} // namespace
 
-// Converts a Plant object to a QJsonObject
-QJsonObject JSONPlantRepository::plantToJson(const Plant& plant) {
-    QJsonObject plantJson;
-    plantJson["name"] = QString::fromStdString(plant.getName());
-    plantJson["species"] = QString::fromStdString(plant.getSpecies());
-    plantJson["quantity"] = plant.getQuantity();
-    plantJson["price"] = plant.getPrice();
-    return plantJson;
-}
+// Constructor
+JSONPlantRepository::JSONPlantRepository(string filename, FileRepositoryOptions options)
+    : FilePlantRepository(move(filename), options) { open(); }
 
-// Adds a new plant to the repository and saves to file
-void JSONPlantRepository::addPlant(const Plant& plant) {
-    if (exists(plant.getName())) { throw DuplicatePlantException(plant.getName()); }
-    plants.push_back(plant);
-    saveToFile();
-}
+// Loads all plants from the JSON file into 'plants'
+// The file is parsed as a stream, so no document tree is built in memory
+void JSONPlantRepository::loadFromFile() {
+    ifstream file(filename, ios::binary);
 
-// Removes a plant by name and saves to file
-void JSONPlantRepository::removePlant(const string& name) {
-    auto it = ranges::find_if(plants, [&name](const Plant& p) {
-        return p.getName() == name;
-    });
-    if (it == plants.end()) { throw PlantNotFoundException(name); }
-    plants.erase(it);
-    saveToFile();
-}
+    // Open file for reading
+    if (!file.is_open()) {
+        throw runtime_error("Could not open file " + filename);
+    }
 
-// Updates a plant by name and saves to file
-void JSONPlantRepository::updatePlant(const Plant& plant) {
-    auto it = ranges::find_if(plants, [&plant](const Plant& p) {
-        return p.getName() == plant.getName();
-    });
-    if (it == plants.end()) { throw PlantNotFoundException(plant.getName()); }
-    *it = plant;
-    saveToFile();
+    plants.clear();
+    PlantJSONHandler handler(plants);
+    try {
+        JSONStreamReader(file).parse(handler);
+    } catch (const DuplicatePlantName &duplicate) {
+        // Same rule and message as the CSV loader
+        throw runtime_error("File " + filename + " contains plant '" + duplicate.name + "' more than once");
+    } catch (const invalid_argument &) {
+        // Check if root is a JSON object
+        throw runtime_error("File " + filename + " is not a valid JSON object");
+    } catch (const runtime_error &e) {
+        // Check if document is valid
+        throw runtime_error("File " + filename + " is not a valid JSON document (" + e.what() + ")");
+    }
 }
 
-// Returns the Plant object with the given name
-Plant JSONPlantRepository::getPlantByName(const string &name) const {
-    auto it = ranges::find_if(plants, [&name](const Plant& p) {
-        return p.getName() == name;
-    });
-    if (it == plants.end()) { throw PlantNotFoundException(name); }
-    return *it;
-}
+// Writes the given plants into a JSON file at path
+// Each plant is written as it is visited, without building a document first
+void JSONPlantRepository::writePlants(const string &path, const PlantStore &plants) const {
+    ofstream file(path, ios::binary);
 
-// Returns a vector of all plants in the repository
-vector<Plant> JSONPlantRepository::getAllPlants() const { return plants; }
+    if (!file.is_open()) {
+        throw runtime_error("Could not open file " + path);
+    }
 
-// Checks if a plant with the given name exists in the repository
-bool JSONPlantRepository::exists(const string& name) const {
-    return ranges::any_of(plants, [&name](const Plant& p)
-        { return p.getName() == name; });
-}
+    // Indented by default, compact when options.compactJson is set
+    JSONStreamWriter writer(file, !options.compactJson);
+    writer.startObject();
+    writer.key("plants");
+    writer.startArray();
+    plants.forEach([&writer](const Plant &plant) {
+        writer.startObject();
+        writer.key("name");
+        writer.value(plant.getName());
+        writer.key("species");
+        writer.value(plant.getSpecies());
+        writer.key("quantity");
+        writer.value(plant.getQuantity());
+        writer.key("price");
+        writer.value(plant.getPrice());
+        writer.endObject();
+    });
+    writer.endArray();
+    writer.endObject();
+    file << '\n';
 
+    file.close();
+    if (!file) { throw runtime_error("Could not write file " + path); }
+}
@@ -1,53 +1,24 @@
 #pragma once
 
-#include "plant_repository.h"
-#include <QJsonDocument>
-#include <QJsonObject>
+#include "file_plant_repository.h"
 #include <string>
 #include <vector>
 
 using namespace std;
 
 // Concrete implementation of PlantRepository that stores plants in a JSON file
-class JSONPlantRepository : public PlantRepository {
+class JSONPlantRepository : public FilePlantRepository {
 private:
-    string filename;
-    vector<Plant> plants;
+    // Loads all plants from the JSON file into 'plants'.
+    void loadFromFile() override;
 
-    // Loads all plants from the JSON file into the 'plants' vector.
-    void loadFromFile();
-
-    // Saves all plants from the 'plants' vector back to the JSON file.
-    void saveToFile() const;
-
-    // Converts a QJsonObject to a Plant object.
-    static Plant plantFromJson(const QJsonObject &json);
-
-    // Converts a Plant object to a QJsonObject.
-    static QJsonObject plantToJson(const Plant &plant);
+    // Writes the given plants to a JSON file at path.
+    void writePlants(const string &path, const PlantStore &plants) const override;
 
 public:
     // Constructor
-    explicit JSONPlantRepository(string filename);
-
-    // Adds a new plant to the repository
-    void addPlant(const Plant& plant) override;
-
-    // Removes a plant by name from the repository
-    void removePlant(const string& name) override;
-
-    // Updates a plant (by name) in the repository
-    void updatePlant(const Plant& plant) override;
-
-    // Retrieves a plant by name
-    Plant getPlantByName(const string &name) const override;
-
-    // Returns a vector with all plants in the repository
-    vector<Plant> getAllPlants() const override;
-
-    // Checks if a plant with the given name exists in the repository
-    bool exists(const string& name) const override;
+    explicit JSONPlantRepository(string filename, FileRepositoryOptions options = {});
 
     // Destructor
-    ~JSONPlantRepository() override = default;
+    ~JSONPlantRepository() override { close(); }
 };
@@ -0,0 +1,306 @@
+#include "json_stream.h"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+// Nesting deeper than this is rejected instead of exhausting the stack
+static constexpr int maxDepth = 512;
+
+// Constructor
+JSONStreamReader::JSONStreamReader(istream &in, size_t bufferSize)
+    : in(in), buffer(bufferSize) {}
+
+// Returns the next byte without consuming it, refilling the buffer as needed; -1 at end
+int JSONStreamReader::peek() {
+    if (position == length) {
+        offset += length;
+        in.read(buffer.data(), static_cast<streamsize>(buffer.size()));
+        length = static_cast<size_t>(in.gcount());
+        position = 0;
+        if (length == 0) return -1;
+    }
+    return static_cast<unsigned char>(buffer[position]);
+}
+
+// Consumes and returns the next byte; -1 at end
+int JSONStreamReader::get() {
+    int c = peek();
+    if (c >= 0) ++position;
+    return c;
+}
+
+void JSONStreamReader::skipWhitespace() {
+    for (int c = peek(); c == ' ' || c == '\t' || c == '\n' || c == '\r'; c = peek()) ++position;
+}
+
+void JSONStreamReader::expect(char c) {
+    if (get() != c) fail(string("expected '") + c + "'");
+}
+
+void JSONStreamReader::expectWord(const char *word) {
+    for (const char *p = word; *p; ++p)
+        if (get() != *p) fail(string("expected '") + word + "'");
+}
+
+void JSONStreamReader::fail(const string &what) const {
+    throw runtime_error("Invalid JSON at byte " + to_string(offset + position) + ": " + what);
+}
+
+// Parses a single document followed only by whitespace
+void JSONStreamReader::parse(JSONHandler &handler) {
+    skipWhitespace();
+    parseValue(handler, 0);
+    skipWhitespace();
+    if (peek() != -1) fail("unexpected data after the document");
+}
+
+// Dispatches on the first byte of a value
+void JSONStreamReader::parseValue(JSONHandler &handler, int depth) {
+    if (depth > maxDepth) fail("nesting too deep");
+    skipWhitespace();
+    int c = peek();
+    switch (c) {
+        case '{': parseObject(handler, depth + 1); break;
+        case '[': parseArray(handler, depth + 1); break;
+        case '"': parseString(); handler.stringValue(scratch); break;
+        case 't': expectWord("true"); handler.boolValue(true); break;
+        case 'f': expectWord("false"); handler.boolValue(false); break;
+        case 'n': expectWord("null"); handler.nullValue(); break;
+        case -1: fail("unexpected end of input");
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) parseNumber(handler);
+            else fail("unexpected character");
+    }
+}
+
+void JSONStreamReader::parseObject(JSONHandler &handler, int depth) {
+    expect('{');
+    handler.startObject();
+    skipWhitespace();
+    if (peek() == '}') {
+        ++position;
+        handler.endObject();
+        return;
+    }
+    while (true) {
+        skipWhitespace();
+        if (peek() != '"') fail("expected a key");
+        parseString();
+        handler.key(scratch);
+        skipWhitespace();
+        expect(':');
+        parseValue(handler, depth);
+        skipWhitespace();
+        int c = get();
+        if (c == '}') break;
+        if (c != ',') fail("expected ',' or '}'");
+    }
+    handler.endObject();
+}
+
+void JSONStreamReader::parseArray(JSONHandler &handler, int depth) {
+    expect('[');
+    handler.startArray();
+    skipWhitespace();
+    if (peek() == ']') {
+        ++position;
+        handler.endArray();
+        return;
+    }
+    while (true) {
+        parseValue(handler, depth);
+        skipWhitespace();
+        int c = get();
+        if (c == ']') break;
+        if (c != ',') fail("expected ',' or ']'");
+    }
+    handler.endArray();
+}
+
+// Reads a string into 'scratch', decoding escapes to UTF-8
+void JSONStreamReader::parseString() {
+    expect('"');
+    scratch.clear();
+    while (true) {
+        int c = get();
+        if (c == -1) fail("unterminated string");
+        if (c == '"') return;
+        if (c < 0x20) fail("control character in string");
+        if (c != '\\') {
+            scratch += static_cast<char>(c);
+            continue;
+        }
+        switch (get()) {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u': {
+                unsigned codePoint = parseHex4();
+                // Combine a UTF-16 surrogate pair
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+                    expect('\\');
+                    expect('u');
+                    unsigned low = parseHex4();
+                    if (low < 0xDC00 || low > 0xDFFF) fail("invalid surrogate pair");
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendCodePoint(codePoint);
+                break;
+            }
+            default: fail("invalid escape");
+        }
+    }
+}
+
+unsigned JSONStreamReader::parseHex4() {
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i) {
+        int c = get();
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else fail("invalid \\u escape");
+    }
+    return value;
+}
+
+void JSONStreamReader::appendCodePoint(unsigned codePoint) {
+    if (codePoint < 0x80) {
+        scratch += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        scratch += static_cast<char>(0xC0 | (codePoint >> 6));
+        scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        scratch += static_cast<char>(0xE0 | (codePoint >> 12));
+        scratch += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        scratch += static_cast<char>(0xF0 | (codePoint >> 18));
+        scratch += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        scratch += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Collects the characters of a number and converts them with from_chars
+void JSONStreamReader::parseNumber(JSONHandler &handler) {
+    scratch.clear();
+    for (int c = peek(); c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E' || (c >= '0' && c <= '9'); c = peek()) {
+        scratch += static_cast<char>(c);
+        ++position;
+    }
+    double value = 0;
+    auto [next, error] = from_chars(scratch.data(), scratch.data() + scratch.size(), value);
+    if (error != errc() || next != scratch.data() + scratch.size()) fail("invalid number '" + scratch + "'");
+    handler.numberValue(value);
+}
+
+// Constructor
+JSONStreamWriter::JSONStreamWriter(ostream &out, bool indented)
+    : out(out), indented(indented) {}
+
+// Starts a new line at the current nesting level
+void JSONStreamWriter::newline() {
+    if (!indented) return;
+    out << '\n';
+    for (size_t i = 0; i < hasElements.size(); ++i) out << "    ";
+}
+
+// Writes the separator before an array element or object key
+void JSONStreamWriter::beforeValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (hasElements.empty()) return;
+    if (hasElements.back()) out << ',';
+    hasElements.back() = true;
+    newline();
+}
+
+void JSONStreamWriter::startObject() {
+    beforeValue();
+    out << '{';
+    hasElements.push_back(false);
+}
+
+void JSONStreamWriter::endObject() {
+    bool hadElements = hasElements.back();
+    hasElements.pop_back();
+    if (hadElements) newline();
+    out << '}';
+}
+
+void JSONStreamWriter::startArray() {
+    beforeValue();
+    out << '[';
+    hasElements.push_back(false);
+}
+
+void JSONStreamWriter::endArray() {
+    bool hadElements = hasElements.back();
+    hasElements.pop_back();
+    if (hadElements) newline();
+    out << ']';
+}
+
+void JSONStreamWriter::key(string_view name) {
+    beforeValue();
+    writeString(name);
+    out << (indented ? ": " : ":");
+    afterKey = true;
+}
+
+void JSONStreamWriter::value(string_view text) {
+    beforeValue();
+    writeString(text);
+}
+
+// Doubles use the shortest form that reads back exactly; JSON has no NaN or infinity
+void JSONStreamWriter::value(double number) {
+    beforeValue();
+    if (!isfinite(number)) {
+        out << "null";
+        return;
+    }
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), number);
+    out.write(buffer, result.ptr - buffer);
+}
+
+void JSONStreamWriter::value(int number) {
+    beforeValue();
+    out << number;
+}
+
+// Writes a quoted string, escaping quotes, backslashes and control characters
+void JSONStreamWriter::writeString(string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            case '\b': out << "\\b"; break;
+            case '\f': out << "\\f"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+                else
+                    out << c;
+        }
+    }
+    out << '"';
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Receives parse events from JSONStreamReader (SAX style).
+// String views are only valid during the call.
+class JSONHandler {
+public:
+    virtual void startObject() = 0;
+    virtual void endObject() = 0;
+    virtual void startArray() = 0;
+    virtual void endArray() = 0;
+    virtual void key(string_view name) = 0;
+    virtual void stringValue(string_view value) = 0;
+    virtual void numberValue(double value) = 0;
+    virtual void boolValue(bool value) = 0;
+    virtual void nullValue() = 0;
+
+    virtual ~JSONHandler() = default; // Destructor
+};
+
+// Streaming JSON parser: reads the input through a fixed-size buffer and
+// reports values to a JSONHandler as they are read, so memory use does not
+// depend on the size of the document.
+class JSONStreamReader {
+private:
+    istream &in;
+    vector<char> buffer;
+    size_t position = 0;
+    size_t length = 0;
+    size_t offset = 0; // Bytes consumed before the current buffer, for error messages
+    string scratch;    // Reused for strings and numbers
+
+    int peek();
+    int get();
+    void skipWhitespace();
+    void expect(char c);
+    void expectWord(const char *word);
+    [[noreturn]] void fail(const string &what) const;
+
+    void parseValue(JSONHandler &handler, int depth);
+    void parseObject(JSONHandler &handler, int depth);
+    void parseArray(JSONHandler &handler, int depth);
+    void parseString();
+    void parseNumber(JSONHandler &handler);
+    void appendCodePoint(unsigned codePoint);
+    unsigned parseHex4();
+
+public:
+    // Constructor; bufferSize is the only memory the reader itself holds
+    explicit JSONStreamReader(istream &in, size_t bufferSize = 64 * 1024);
+
+    // Parses exactly one JSON document; throws runtime_error if it is invalid
+    void parse(JSONHandler &handler);
+};
+
+// Streaming JSON writer: values go straight to the output stream, with
+// optional indentation matching the layout QJsonDocument::Indented produced.
+class JSONStreamWriter {
+private:
+    ostream &out;
+    bool indented;
+    // One entry per open container: true once it has a first element
+    vector<bool> hasElements;
+    bool afterKey = false;
+
+    void beforeValue();
+    void newline();
+    void writeString(string_view value);
+
+public:
+    // Constructor
+    JSONStreamWriter(ostream &out, bool indented);
+
+    void startObject();
+    void endObject();
+    void startArray();
+    void endArray();
+    void key(string_view name);
+    void value(string_view text);
+    void value(double number);
+    void value(int number);
+};
@@ -0,0 +1,149 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+// Constructor; reads the whole file into the buffer
+MappedFile::MappedFile(const string &path) {
+    ifstream file(path, ios::binary);
+    if (!file.is_open()) { throw runtime_error("Could not open file " + path); }
+    stringstream ss;
+    ss << file.rdbuf();
+    buffer = ss.str();
+    bytes = buffer.data();
+    length = buffer.size();
+}
+
+// Destructor
+MappedFile::~MappedFile() = default;
+
+// Constructor; reads the file (or starts empty) into the buffer
+WritableMappedFile::WritableMappedFile(string path) : path(move(path)) {
+    ifstream file(this->path, ios::binary);
+    if (file.is_open()) {
+        stringstream ss;
+        ss << file.rdbuf();
+        buffer = ss.str();
+    } else if (!ofstream(this->path, ios::binary).is_open()) {
+        throw runtime_error("Could not open file " + this->path);
+    }
+    map();
+}
+
+void WritableMappedFile::map() {
+    bytes = buffer.empty() ? nullptr : buffer.data();
+    length = buffer.size();
+}
+
+void WritableMappedFile::unmap() {}
+
+// Resizes the in-memory copy
+void WritableMappedFile::resize(size_t newLength) {
+    buffer.resize(newLength);
+    map();
+}
+
+// Writes the whole buffer back to the file
+void WritableMappedFile::sync() {
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    if (!file) { throw runtime_error("Could not write file " + path); }
+}
+
+// Destructor
+WritableMappedFile::~WritableMappedFile() {
+    try { sync(); } catch (...) {}
+}
+
+#else
+
+// Constructor; maps the file read-only. Empty files are not mapped.
+MappedFile::MappedFile(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw runtime_error("Could not open file " + path); }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        throw runtime_error("Could not read file " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            throw runtime_error("Could not map file " + path);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char *>(mapping);
+    }
+    ::close(fd); // The mapping stays valid after closing the descriptor
+}
+
+// Destructor
+MappedFile::~MappedFile() {
+    if (length > 0) munmap(const_cast<char *>(bytes), length);
+}
+
+// Constructor; opens or creates the file and maps it read-write
+WritableMappedFile::WritableMappedFile(string path) : path(move(path)) {
+    descriptor = ::open(this->path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (descriptor < 0) { throw runtime_error("Could not open file " + this->path); }
+    struct stat info {};
+    if (fstat(descriptor, &info) != 0) {
+        ::close(descriptor);
+        throw runtime_error("Could not read file " + this->path);
+    }
+    length = static_cast<size_t>(info.st_size);
+    map();
+}
+
+void WritableMappedFile::map() {
+    bytes = nullptr;
+    if (length == 0) return;
+    void *mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED) { throw runtime_error("Could not map file " + path); }
+    bytes = static_cast<char *>(mapping);
+}
+
+void WritableMappedFile::unmap() {
+    if (bytes) munmap(bytes, length);
+    bytes = nullptr;
+}
+
+// Changes the file length with ftruncate and maps the new length
+void WritableMappedFile::resize(size_t newLength) {
+    unmap();
+    if (ftruncate(descriptor, static_cast<off_t>(newLength)) != 0) {
+        map();
+        throw runtime_error("Could not resize file " + path);
+    }
+    length = newLength;
+    map();
+}
+
+// Flushes dirty pages with msync
+void WritableMappedFile::sync() {
+    if (bytes && msync(bytes, length, MS_SYNC) != 0) { throw runtime_error("Could not write file " + path); }
+}
+
+// Destructor
+WritableMappedFile::~WritableMappedFile() {
+    unmap();
+    if (descriptor >= 0) ::close(descriptor);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Read-only memory mapping of a whole file.
+// Falls back to reading the file into memory where mmap is not available.
+class MappedFile {
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+    string buffer; // Used by the fallback only
+
+public:
+    // Maps the file at path; throws runtime_error if it cannot be opened
+    explicit MappedFile(const string &path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    // Returns the file contents
+    string_view view() const { return {bytes, length}; }
+
+    // Destructor; unmaps the file
+    ~MappedFile();
+};
+
+// Read-write shared mapping of a file that can be resized.
+// Writes go straight to the file's pages; sync() asks the OS to write them out.
+// Where mmap is not available the file is kept in memory and written back by sync().
+class WritableMappedFile {
+private:
+    string path;
+    char *bytes = nullptr;
+    size_t length = 0;
+    int descriptor = -1;
+    string buffer; // Used by the fallback only
+
+    // Maps the current file length
+    void map();
+
+    // Unmaps the file
+    void unmap();
+
+public:
+    // Opens the file at path, creating an empty one if it does not exist
+    explicit WritableMappedFile(string path);
+
+    WritableMappedFile(const WritableMappedFile&) = delete;
+    WritableMappedFile &operator=(const WritableMappedFile&) = delete;
+
+    // Start of the mapping (nullptr while the file is empty)
+    char *data() const { return bytes; }
+
+    // Length of the file
+    size_t size() const { return length; }
+
+    // Grows or shrinks the file and maps it again; data() may change
+    void resize(size_t newLength);
+
+    // Writes modified pages to the file
+    void sync();
+
+    // Destructor; writes back and unmaps the file
+    ~WritableMappedFile();
+};
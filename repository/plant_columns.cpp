@@ -0,0 +1,294 @@
+#include "plant_columns.h"
+
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Dead rows are rebuilt away once there are this many and they outnumber live rows
+static constexpr size_t compactAfterDead = 1024;
+
+// Number of selected rows
+size_t SelectionBitmap::count() const {
+    size_t total = 0;
+    for (uint64_t bits : words) total += static_cast<size_t>(popcount(bits));
+    return total;
+}
+
+// Intersects with a selection over the same columns
+SelectionBitmap &SelectionBitmap::operator&=(const SelectionBitmap &other) {
+    for (size_t i = 0; i < words.size(); ++i) words[i] &= other.words[i];
+    return *this;
+}
+
+// Unites with a selection over the same columns
+SelectionBitmap &SelectionBitmap::operator|=(const SelectionBitmap &other) {
+    for (size_t i = 0; i < words.size(); ++i) words[i] |= other.words[i];
+    return *this;
+}
+
+// Bits of the 64 prices starting at p that lie in [minPrice, maxPrice].
+// Comparisons with NaN are false, so NaN prices are never selected.
+static uint64_t priceBlock(const double *p, double minPrice, double maxPrice) {
+    uint64_t bits = 0;
+#if defined(__AVX2__)
+    const __m256d low = _mm256_set1_pd(minPrice), high = _mm256_set1_pd(maxPrice);
+    for (unsigned i = 0; i < 64; i += 4) {
+        __m256d values = _mm256_loadu_pd(p + i);
+        __m256d inside = _mm256_and_pd(_mm256_cmp_pd(values, low, _CMP_GE_OQ), _mm256_cmp_pd(values, high, _CMP_LE_OQ));
+        bits |= static_cast<uint64_t>(_mm256_movemask_pd(inside)) << i;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128d low = _mm_set1_pd(minPrice), high = _mm_set1_pd(maxPrice);
+    for (unsigned i = 0; i < 64; i += 2) {
+        __m128d values = _mm_loadu_pd(p + i);
+        __m128d inside = _mm_and_pd(_mm_cmpge_pd(values, low), _mm_cmple_pd(values, high));
+        bits |= static_cast<uint64_t>(_mm_movemask_pd(inside)) << i;
+    }
+#else
+    for (unsigned i = 0; i < 64; ++i)
+        bits |= static_cast<uint64_t>(p[i] >= minPrice && p[i] <= maxPrice) << i;
+#endif
+    return bits;
+}
+
+// Bits of the 64 quantities starting at q that lie in [minQuantity, maxQuantity]
+static uint64_t quantityBlock(const int32_t *q, int32_t minQuantity, int32_t maxQuantity) {
+    uint64_t bits = 0;
+#if defined(__AVX2__)
+    const __m256i low = _mm256_set1_epi32(minQuantity), high = _mm256_set1_epi32(maxQuantity);
+    for (unsigned i = 0; i < 64; i += 8) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(q + i));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, values), _mm256_cmpgt_epi32(values, high));
+        bits |= static_cast<uint64_t>(~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF) << i;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i low = _mm_set1_epi32(minQuantity), high = _mm_set1_epi32(maxQuantity);
+    for (unsigned i = 0; i < 64; i += 4) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(low, values), _mm_cmpgt_epi32(values, high));
+        bits |= static_cast<uint64_t>(~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF) << i;
+    }
+#else
+    for (unsigned i = 0; i < 64; ++i)
+        bits |= static_cast<uint64_t>(q[i] >= minQuantity && q[i] <= maxQuantity) << i;
+#endif
+    return bits;
+}
+
+// Bits of the 64 species codes starting at s that equal code
+static uint64_t speciesBlock(const uint32_t *s, uint32_t code) {
+    uint64_t bits = 0;
+#if defined(__AVX2__)
+    const __m256i wanted = _mm256_set1_epi32(static_cast<int>(code));
+    for (unsigned i = 0; i < 64; i += 8) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+        __m256i equal = _mm256_cmpeq_epi32(values, wanted);
+        bits |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal))) << i;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i wanted = _mm_set1_epi32(static_cast<int>(code));
+    for (unsigned i = 0; i < 64; i += 4) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        __m128i equal = _mm_cmpeq_epi32(values, wanted);
+        bits |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(equal))) << i;
+    }
+#else
+    for (unsigned i = 0; i < 64; ++i)
+        bits |= static_cast<uint64_t>(s[i] == code) << i;
+#endif
+    return bits;
+}
+
+// Sum of 64 quantities, widened to 64 bits
+static long long quantityBlockSum(const int32_t *q) {
+#if defined(__AVX2__)
+    __m256i sum = _mm256_setzero_si256();
+    for (unsigned i = 0; i < 64; i += 4)
+        sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i))));
+    alignas(32) long long lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i sum = _mm_setzero_si128();
+    for (unsigned i = 0; i < 64; i += 4) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i));
+        __m128i signs = _mm_srai_epi32(values, 31); // Sign extension without SSE4.1
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(values, signs));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(values, signs));
+    }
+    alignas(16) long long lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sum);
+    return lanes[0] + lanes[1];
+#else
+    long long sum = 0;
+    for (unsigned i = 0; i < 64; ++i) sum += q[i];
+    return sum;
+#endif
+}
+
+// Sum of quantity * price over 64 rows
+static double valueBlockSum(const int32_t *q, const double *p) {
+#if defined(__AVX2__)
+    __m256d sum = _mm256_setzero_pd();
+    for (unsigned i = 0; i < 64; i += 4) {
+        __m256d quantity = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i)));
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(quantity, _mm256_loadu_pd(p + i)));
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128d sum = _mm_setzero_pd();
+    for (unsigned i = 0; i < 64; i += 2) {
+        __m128d quantity = _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(q + i)));
+        sum = _mm_add_pd(sum, _mm_mul_pd(quantity, _mm_loadu_pd(p + i)));
+    }
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, sum);
+    return lanes[0] + lanes[1];
+#else
+    double sum = 0;
+    for (unsigned i = 0; i < 64; ++i) sum += q[i] * p[i];
+    return sum;
+#endif
+}
+
+// Constructor
+PlantColumns::PlantColumns(const PlantRepository &repository) : repository(repository) { rebuild(); }
+
+// Clears the columns and appends every plant in repository order
+void PlantColumns::rebuild() {
+    rowCount = 0;
+    deadRows = 0;
+    quantities.clear();
+    prices.clear();
+    speciesCodes.clear();
+    names.clear();
+    liveRows = SelectionBitmap();
+    rowByName.clear();
+    speciesDictionary.clear();
+    speciesByCode.clear();
+    repository.forEachPlant([this](const Plant &plant) { plantAdded(plant); });
+}
+
+// Looks up or assigns a species code
+uint32_t PlantColumns::encode(const string &species) {
+    auto [it, inserted] = speciesDictionary.try_emplace(species, static_cast<uint32_t>(speciesByCode.size()));
+    if (inserted) speciesByCode.push_back(species);
+    return it->second;
+}
+
+// Fills one row
+void PlantColumns::store(size_t row, const Plant &plant) {
+    quantities[row] = plant.getQuantity();
+    prices[row] = plant.getPrice();
+    speciesCodes[row] = encode(plant.getSpecies());
+}
+
+// Appends a row, growing the columns by a whole block of dead rows when full
+void PlantColumns::plantAdded(const Plant &plant) {
+    size_t row = rowCount++;
+    if (row == quantities.size()) {
+        size_t padded = row + 64;
+        quantities.resize(padded, 0);
+        prices.resize(padded, 0);
+        speciesCodes.resize(padded, noSpecies);
+        names.resize(padded);
+        liveRows.resize(padded / 64);
+    }
+    store(row, plant);
+    names[row] = plant.getName();
+    liveRows.word(row / 64) |= uint64_t{1} << (row % 64);
+    rowByName.emplace(plant.getName(), row);
+}
+
+// Turns the row into a dead row
+void PlantColumns::plantRemoved(const Plant &plant) {
+    auto it = rowByName.find(plant.getName());
+    size_t row = it->second;
+    rowByName.erase(it);
+    quantities[row] = 0;
+    prices[row] = 0;
+    speciesCodes[row] = noSpecies;
+    names[row].clear();
+    liveRows.word(row / 64) &= ~(uint64_t{1} << (row % 64));
+    ++deadRows;
+    compactIfNeeded();
+}
+
+// Rewrites the row in place
+void PlantColumns::plantUpdated(const Plant &, const Plant &newPlant) {
+    store(rowByName.at(newPlant.getName()), newPlant);
+}
+
+// Rebuilding from the repository restores repository order without dead rows
+void PlantColumns::compactIfNeeded() {
+    if (deadRows >= compactAfterDead && deadRows > rowByName.size()) rebuild();
+}
+
+// Builds a Plant from its row
+Plant PlantColumns::plantAt(size_t row) const {
+    return Plant(names[row], speciesByCode[speciesCodes[row]], quantities[row], prices[row]);
+}
+
+// Rows whose price is in [minPrice, maxPrice]
+SelectionBitmap PlantColumns::selectPriceRange(double minPrice, double maxPrice) const {
+    SelectionBitmap selection(liveRows.blocks());
+    for (size_t block = 0; block < selection.blocks(); ++block)
+        selection.word(block) = priceBlock(&prices[block * 64], minPrice, maxPrice) & liveRows.word(block);
+    return selection;
+}
+
+// Rows whose quantity is in [minQuantity, maxQuantity]
+SelectionBitmap PlantColumns::selectQuantityRange(int minQuantity, int maxQuantity) const {
+    SelectionBitmap selection(liveRows.blocks());
+    for (size_t block = 0; block < selection.blocks(); ++block)
+        selection.word(block) = quantityBlock(&quantities[block * 64], minQuantity, maxQuantity) & liveRows.word(block);
+    return selection;
+}
+
+// Rows of a species; an unknown species selects nothing without a scan
+SelectionBitmap PlantColumns::selectSpecies(const string &species) const {
+    SelectionBitmap selection(liveRows.blocks());
+    auto it = speciesDictionary.find(species);
+    if (it == speciesDictionary.end()) return selection;
+    for (size_t block = 0; block < selection.blocks(); ++block)
+        selection.word(block) = speciesBlock(&speciesCodes[block * 64], it->second) & liveRows.word(block);
+    return selection;
+}
+
+// Full blocks are summed with SIMD, partial blocks row by row
+long long PlantColumns::sumQuantity(const SelectionBitmap &selection) const {
+    long long sum = 0;
+    for (size_t block = 0; block < selection.blocks(); ++block) {
+        uint64_t bits = selection.word(block);
+        if (bits == ~uint64_t{0}) {
+            sum += quantityBlockSum(&quantities[block * 64]);
+            continue;
+        }
+        for (; bits; bits &= bits - 1) sum += quantities[block * 64 + static_cast<size_t>(countr_zero(bits))];
+    }
+    return sum;
+}
+
+// Full blocks are summed with SIMD, partial blocks row by row
+double PlantColumns::sumValue(const SelectionBitmap &selection) const {
+    double sum = 0;
+    for (size_t block = 0; block < selection.blocks(); ++block) {
+        uint64_t bits = selection.word(block);
+        if (bits == ~uint64_t{0}) {
+            sum += valueBlockSum(&quantities[block * 64], &prices[block * 64]);
+            continue;
+        }
+        for (; bits; bits &= bits - 1) {
+            size_t row = block * 64 + static_cast<size_t>(countr_zero(bits));
+            sum += quantities[row] * prices[row];
+        }
+    }
+    return sum;
+}
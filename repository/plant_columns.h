@@ -0,0 +1,120 @@
+#pragma once
+#include "../Model/plant.h"
+#include "plant_repository.h"
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// One bit per row of a PlantColumns; bit i of words[i / 64] selects row i
+class SelectionBitmap {
+private:
+    vector<uint64_t> words;
+
+public:
+    // Constructor; an empty selection over the given number of 64-row blocks
+    explicit SelectionBitmap(size_t blocks = 0) : words(blocks, 0) {}
+
+    // Number of 64-row blocks
+    size_t blocks() const { return words.size(); }
+
+    // Block access for the kernels
+    uint64_t word(size_t block) const { return words[block]; }
+    uint64_t &word(size_t block) { return words[block]; }
+
+    // Grows or shrinks to the given number of blocks; new rows are unselected
+    void resize(size_t blocks) { words.resize(blocks, 0); }
+
+    // Number of selected rows
+    size_t count() const;
+
+    // Keeps the rows selected in both (AND) or in either (OR)
+    SelectionBitmap &operator&=(const SelectionBitmap &other);
+    SelectionBitmap &operator|=(const SelectionBitmap &other);
+
+    // Calls visitor(row) for every selected row in ascending order
+    template <typename Visitor>
+    void forEach(Visitor &&visitor) const {
+        for (size_t block = 0; block < words.size(); ++block) {
+            for (uint64_t bits = words[block]; bits; bits &= bits - 1)
+                visitor(block * 64 + static_cast<size_t>(countr_zero(bits)));
+        }
+    }
+};
+
+// Column-oriented copy of a repository's plants, kept current as a listener.
+//
+// Quantities, prices and dictionary-coded species live in separate contiguous
+// arrays, so predicates and sums only touch the bytes they need and run on
+// 64-row blocks with SIMD (AVX2 or SSE2 when the build enables them). Every
+// kernel returns a SelectionBitmap restricted to live rows.
+//
+// Rows follow repository order: adds append, updates rewrite their row and
+// removals leave a dead row (zero quantity and price) until dead rows
+// outnumber live ones and the columns are rebuilt from the repository.
+class PlantColumns : public PlantRepository::Listener {
+private:
+    const PlantRepository &repository;
+    size_t rowCount = 0;                // Rows in use, live or dead
+    size_t deadRows = 0;
+
+    // Columns, padded with dead rows to a multiple of 64
+    vector<int32_t> quantities;
+    vector<double> prices;
+    vector<uint32_t> speciesCodes;
+    vector<string> names;
+    SelectionBitmap liveRows;
+
+    unordered_map<string, size_t> rowByName;
+    unordered_map<string, uint32_t> speciesDictionary;
+    vector<string> speciesByCode;
+
+    // Returns the code of a species, adding it to the dictionary if new
+    uint32_t encode(const string &species);
+
+    // Writes a plant's values into a row
+    void store(size_t row, const Plant &plant);
+
+    // Rebuilds the columns once dead rows outnumber live ones
+    void compactIfNeeded();
+
+public:
+    // Code of dead and padding rows; matches no species
+    static constexpr uint32_t noSpecies = UINT32_MAX;
+
+    // Constructor; copies the repository's plants with one scan
+    explicit PlantColumns(const PlantRepository &repository);
+
+    // Drops everything and copies the repository again
+    void rebuild();
+
+    // Listener callbacks
+    void plantAdded(const Plant &plant) override;
+    void plantRemoved(const Plant &plant) override;
+    void plantUpdated(const Plant &oldPlant, const Plant &newPlant) override;
+    void plantsReset() override { rebuild(); }
+
+    // Number of rows in use (live or dead) and of live rows
+    size_t rows() const { return rowCount; }
+    size_t size() const { return rowByName.size(); }
+
+    // Number of 64-row blocks every selection spans
+    size_t blocks() const { return liveRows.blocks(); }
+
+    // Builds the Plant stored in a live row
+    Plant plantAt(size_t row) const;
+
+    // Selection kernels; each result only contains live rows
+    SelectionBitmap selectAll() const { return liveRows; }
+    SelectionBitmap selectPriceRange(double minPrice, double maxPrice) const;
+    SelectionBitmap selectQuantityRange(int minQuantity, int maxQuantity) const;
+    SelectionBitmap selectSpecies(const string &species) const;
+
+    // Aggregate kernels over the selected rows
+    long long sumQuantity(const SelectionBitmap &selection) const;
+    double sumValue(const SelectionBitmap &selection) const; // Sum of quantity * price
+};
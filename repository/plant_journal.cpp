@@ -0,0 +1,155 @@
+#include "plant_journal.h"
+#include "file_sync.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// Cuts a torn record (no trailing newline) off the end of the file at path,
+// so that the next append starts a line of its own
+static void trimTornRecord(const string &path) {
+    uintmax_t size = filesystem::file_size(path);
+    if (size == 0) return;
+    ifstream in(path, ios::binary);
+    in.seekg(-1, ios::end);
+    if (in.get() == '\n') return;
+    in.seekg(0);
+    string existing(size, '\0');
+    in.read(existing.data(), static_cast<streamsize>(size));
+    in.close();
+    size_t lastRecord = existing.find_last_of('\n');
+    filesystem::resize_file(path, lastRecord == string::npos ? 0 : lastRecord + 1);
+}
+
+// Constructor; drops a torn record left by a crash, which replay skipped
+PlantJournal::PlantJournal(string path, size_t existingRecords)
+    : path(move(path)), records(existingRecords) {
+    if (filesystem::exists(this->path)) trimTornRecord(this->path);
+    out.open(this->path, ios::app);
+    if (!out.is_open()) { throw runtime_error("Could not open journal " + this->path); }
+}
+
+// Escapes the characters used as record and field separators
+string PlantJournal::escape(const string &field) {
+    string escaped;
+    escaped.reserve(field.size());
+    for (char c : field) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            default: escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Turns escape sequences back into the original characters
+string PlantJournal::unescape(const string &field) {
+    string result;
+    result.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] != '\\' || i + 1 == field.size()) {
+            result += field[i];
+            continue;
+        }
+        char next = field[++i];
+        result += next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+    }
+    return result;
+}
+
+// Formats a record; the cost is proportional to the size of the plant only
+void PlantJournal::write(Operation operation, const Plant &plant) {
+    if (operation == Operation::Remove) {
+        out << "R\t" << escape(plant.getName()) << '\n';
+    } else {
+        char price[32];
+        snprintf(price, sizeof(price), "%.17g", plant.getPrice());
+        out << (operation == Operation::Add ? "A\t" : "U\t")
+            << escape(plant.getName()) << '\t'
+            << escape(plant.getSpecies()) << '\t'
+            << plant.getQuantity() << '\t'
+            << price << '\n';
+    }
+    ++records;
+}
+
+// Pushes buffered records to the file
+void PlantJournal::flush() {
+    out.flush();
+    if (!out) { throw runtime_error("Could not write journal " + path); }
+}
+
+// Appends a single record
+void PlantJournal::append(Operation operation, const Plant &plant) {
+    write(operation, plant);
+    flush();
+}
+
+// Appends a batch of records
+void PlantJournal::appendAll(const vector<pair<Operation, Plant>> &batch) {
+    for (const auto &[operation, plant] : batch) write(operation, plant);
+    flush();
+}
+
+// Appends the complete records of the file at 'from' to the file at 'to'
+static void appendRecords(const string &from, const string &to) {
+    trimTornRecord(to); // It would swallow the first appended record
+    if (filesystem::file_size(from) == 0) return;
+    ifstream in(from, ios::binary);
+    ofstream out(to, ios::binary | ios::app);
+    out << in.rdbuf();
+    out.flush();
+    if (!in || !out) { throw runtime_error("Could not append journal " + from + " to " + to); }
+}
+
+// Moves the current journal aside so a snapshot can absorb it, then reopens an empty one
+void PlantJournal::rotate(const string &newPath, bool sync) {
+    out.close();
+    if (filesystem::exists(newPath)) {
+        appendRecords(path, newPath);
+        if (sync) syncFile(newPath);
+    } else {
+        filesystem::rename(path, newPath);
+    }
+    out.open(path, ios::trunc);
+    if (!out.is_open()) { throw runtime_error("Could not open journal " + path); }
+    records = 0;
+}
+
+// Replays the journal at path; a missing file is an empty journal
+size_t PlantJournal::replay(const string &path, const function<void(Operation, const Plant &)> &apply) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return 0;
+    size_t count = 0;
+
+    string line;
+    while (getline(in, line)) {
+        if (in.eof()) break; // Torn record from an interrupted append
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        vector<string> fields;
+        stringstream ss(line);
+        string field;
+        while (getline(ss, field, '\t')) fields.push_back(unescape(field));
+
+        const string &tag = fields[0];
+        if (tag == "R" && fields.size() == 2) {
+            apply(Operation::Remove, Plant(fields[1], "", 0, 0));
+        } else if ((tag == "A" || tag == "U") && fields.size() == 5) {
+            Plant plant(fields[1], fields[2], stoi(fields[3]), stod(fields[4]));
+            apply(tag == "A" ? Operation::Add : Operation::Update, plant);
+        } else {
+            throw runtime_error("Corrupt record in journal " + path);
+        }
+        ++count;
+    }
+    return count;
+}
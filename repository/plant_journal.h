@@ -0,0 +1,66 @@
+#pragma once
+#include "../Model/plant.h"
+
+#include <fstream>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Append-only write-ahead log of plant mutations.
+// Each mutation is one text line: an operation tag followed by tab-separated,
+// escaped fields. A torn last line (no trailing newline) is ignored on replay
+// and cut off when the journal is opened for appending.
+class PlantJournal {
+public:
+    // Kind of mutation stored in a record
+    enum class Operation { Add, Update, Remove };
+
+private:
+    string path;
+    ofstream out;
+    size_t records = 0;
+
+    // Escapes tabs, newlines and backslashes in a field
+    static string escape(const string &field);
+
+    // Reverses escape()
+    static string unescape(const string &field);
+
+    // Formats one record into the stream buffer without flushing
+    void write(Operation operation, const Plant &plant);
+
+    // Flushes buffered records and checks the stream
+    void flush();
+
+public:
+    // Opens (or creates) the journal at path for appending, dropping a torn
+    // last record; existingRecords is the number of complete records already
+    // in it (see replay)
+    explicit PlantJournal(string path, size_t existingRecords = 0);
+
+    // Appends one record and flushes it to the file
+    void append(Operation operation, const Plant &plant);
+
+    // Appends several records with a single flush
+    void appendAll(const vector<pair<Operation, Plant>> &batch);
+
+    // Number of records in the journal since it was created or rotated
+    size_t size() const { return records; }
+
+    // Path of the journal file
+    const string &getPath() const { return path; }
+
+    // Closes the journal, moves its records to newPath and starts an empty one.
+    // If newPath still exists (its compaction failed) the records are appended
+    // to it, after dropping a torn record at its end, so replaying newPath
+    // then the journal still yields every record in order. With sync set the
+    // appended file is synced before the journal is emptied.
+    void rotate(const string &newPath, bool sync = false);
+
+    // Reads every complete record of the journal at path in order and returns
+    // their number. Remove records carry a plant with only the name set.
+    static size_t replay(const string &path, const function<void(Operation, const Plant &)> &apply);
+};
@@ -1,11 +1,40 @@
 #pragma once
 #include "../Model/plant.h"
 
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <string>
+#include <stdexcept>
 
 using namespace std;
 
+// When written mutations are forced from the OS cache to the disk with fsync,
+// so that they survive a power loss or an OS crash (a crash of the process
+// alone never loses a written mutation)
+enum class DurabilityPolicy {
+    None,        // Never; the OS writes the cache back in its own time
+    PerBatch,    // When a batch commits; single mutations wait for the next commit or flush
+    GroupCommit, // Once groupCommitMutations are unsynced or the oldest is groupCommitMs old,
+                 // so one fsync covers every mutation written since the last
+    Always       // Before every mutation and commit returns
+};
+
+// How far persistence lags behind the mutations (see FilePlantRepository's
+// write-behind mode and durability policies); all zero for repositories that
+// write synchronously and never sync
+struct PersistenceStats {
+    uint64_t fileWrites = 0;       // Background saves completed
+    uint64_t mutationsWritten = 0; // Mutations made durable by them
+    uint64_t pendingMutations = 0; // Committed mutations not written yet
+    double lastLatencyMs = 0;      // Last save: its oldest mutation until the file was replaced
+    double meanLatencyMs = 0;      // Mutation until durable, averaged over all written mutations
+    double maxLatencyMs = 0;
+    uint64_t fileSyncs = 0;          // fsync rounds forcing written mutations to the disk
+    uint64_t unsyncedMutations = 0;  // Written mutations a power loss could still undo
+    string lastSaveError;            // Why the last background save failed; empty once one succeeds
+};
+
 // Abstract base class for plant repositories
 class PlantRepository {
 public:
@@ -22,6 +51,32 @@ public:
             : runtime_error("Plant with name '" + name + "' does not exist") {}
     };
 
+    // Observer of the changes applied to a repository, used to keep derived
+    // data (statistics, indexes) current without rescanning all plants
+    class Listener {
+    public:
+        // Called after a plant was added
+        virtual void plantAdded(const Plant &plant) = 0;
+
+        // Called after a plant was removed
+        virtual void plantRemoved(const Plant &plant) = 0;
+
+        // Called after a plant was replaced by a new version with the same name
+        virtual void plantUpdated(const Plant &oldPlant, const Plant &newPlant) = 0;
+
+        // Called when many plants changed at once (e.g. a batch rollback);
+        // derived data should be rebuilt from the repository
+        virtual void plantsReset() = 0;
+
+        virtual ~Listener() = default; // Destructor
+    };
+
+    // Registers a listener; it must outlive the registration
+    void addListener(Listener *listener) { listeners.push_back(listener); }
+
+    // Unregisters a listener
+    void removeListener(Listener *listener) { erase(listeners, listener); }
+
     // Adds a new plant to the repository
     virtual void addPlant(const Plant&) = 0;
 
@@ -37,9 +92,77 @@ public:
     // Returns a vector with all plants in the repository
     virtual vector<Plant> getAllPlants() const = 0;
 
+    // Calls visitor for every plant in repository order without copying the
+    // plants; the references are only valid during the call
+    virtual void forEachPlant(const function<void(const Plant&)> &visitor) const = 0;
+
+    // Number of storage slots, including the ones left empty by removals.
+    // Slot ranges partition repository order for parallel scans.
+    virtual size_t slotCount() const = 0;
+
+    // Calls visitor for the plants stored in slots [first, last), in repository
+    // order. Disjoint ranges may be visited from several threads at once as
+    // long as nothing mutates the repository meanwhile.
+    virtual void forEachPlantInSlots(size_t first, size_t last, const function<void(const Plant&)> &visitor) const = 0;
+
     // Checks if a plant with the given name exists in the repository
     virtual bool exists(const string &name) const = 0;
 
+    // Starts a batch: following mutations are validated and applied in memory
+    // only, and persisted together by commit()
+    virtual void beginBatch() = 0;
+
+    // Persists all mutations of the current batch with a single write
+    virtual void commit() = 0;
+
+    // Discards all mutations of the current batch
+    virtual void rollback() = 0;
+
+    // Checks if a batch is currently open
+    virtual bool inBatch() const = 0;
+
+    // Waits until every committed mutation is durable and reports a failed
+    // write; a no-op for repositories that write synchronously
+    virtual void flush() {}
+
+    // Persistence lag metrics
+    virtual PersistenceStats persistenceStats() const { return {}; }
+
+    // RAII batch: begins on construction, rolls back on destruction unless committed
+    class Batch {
+    private:
+        PlantRepository &repository;
+        bool finished = false;
+    public:
+        explicit Batch(PlantRepository &repository) : repository(repository) { repository.beginBatch(); }
+        Batch(const Batch&) = delete;
+        Batch &operator=(const Batch&) = delete;
+
+        // Persists the batch
+        void commit() { repository.commit(); finished = true; }
+
+        // Discards the batch
+        void rollback() { repository.rollback(); finished = true; }
+
+        // Destructor
+        ~Batch() { if (!finished && repository.inBatch()) repository.rollback(); }
+    };
+
     // Virtual destructor for proper cleanup of derived classes
     virtual ~PlantRepository() = default;
+
+protected:
+    // Checks if anyone listens, so implementations can skip copying old plants
+    bool hasListeners() const { return !listeners.empty(); }
+
+    // Notify the registered listeners of a change
+    void notifyAdded(const Plant &plant) const { for (auto *l : listeners) l->plantAdded(plant); }
+    void notifyRemoved(const Plant &plant) const { for (auto *l : listeners) l->plantRemoved(plant); }
+    void notifyUpdated(const Plant &oldPlant, const Plant &newPlant) const {
+        for (auto *l : listeners) l->plantUpdated(oldPlant, newPlant);
+    }
+    void notifyReset() const { for (auto *l : listeners) l->plantsReset(); }
+
+private:
+    vector<Listener *> listeners;
 };
@@ -0,0 +1,128 @@
+#include "plant_store.h"
+
+using namespace std;
+
+// Adds a plant at the end of the slots and indexes it by name
+bool PlantStore::add(const Plant &plant) {
+    auto [it, inserted] = index.try_emplace(plant.getName(), slots.size());
+    if (!inserted) return false;
+    slots.emplace_back(plant);
+    return true;
+}
+
+// Same as above, moving the plant into its slot
+bool PlantStore::add(Plant &&plant) {
+    auto [it, inserted] = index.try_emplace(plant.getName(), slots.size());
+    if (!inserted) return false;
+    slots.emplace_back(move(plant));
+    return true;
+}
+
+// Replaces the plant in its slot, keeping its position
+bool PlantStore::update(const Plant &plant) {
+    auto it = index.find(plant.getName());
+    if (it == index.end()) return false;
+    recordUndo(it->second);
+    slots[it->second] = plant;
+    return true;
+}
+
+// Empties the slot of the plant and drops it from the index
+bool PlantStore::remove(const string &name) {
+    auto it = index.find(name);
+    if (it == index.end()) return false;
+    recordUndo(it->second);
+    slots[it->second].reset();
+    index.erase(it);
+    ++holes;
+    compactIfNeeded();
+    return true;
+}
+
+// Returns a pointer to the stored plant or nullptr
+const Plant *PlantStore::find(const string &name) const {
+    auto it = index.find(name);
+    if (it == index.end()) return nullptr;
+    return &*slots[it->second];
+}
+
+// Returns a vector with all live plants in insertion order
+vector<Plant> PlantStore::toVector() const {
+    vector<Plant> result;
+    result.reserve(index.size());
+    forEach([&result](const Plant &plant) { result.push_back(plant); });
+    return result;
+}
+
+// Reserves room in both the slots and the index
+void PlantStore::reserve(size_t count) {
+    slots.reserve(count);
+    index.reserve(count);
+}
+
+// Removes all plants
+void PlantStore::clear() {
+    slots.clear();
+    index.clear();
+    holes = 0;
+}
+
+// Moves live plants to the front of the vector and re-points the index.
+// Runs only when more than half of the slots are empty, so the cost is
+// amortized over the removals that created the holes.
+void PlantStore::compactIfNeeded() {
+    if (batchOpen || holes < 32 || holes <= index.size()) return;
+
+    size_t next = 0;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (!slots[i]) continue;
+        if (i != next) {
+            slots[next] = move(slots[i]);
+            index[slots[next]->getName()] = next;
+        }
+        ++next;
+    }
+    slots.resize(next);
+    holes = 0;
+}
+
+// Only slots that existed before the batch need an undo entry; slots appended
+// during the batch are simply cut off on rollback
+void PlantStore::recordUndo(size_t slot) {
+    if (batchOpen && slot < batchSlots) batchUndo.try_emplace(slot, slots[slot]);
+}
+
+// Starts recording changes
+void PlantStore::beginBatch() {
+    batchOpen = true;
+    batchUndo.clear();
+    batchSlots = slots.size();
+    batchHoles = holes;
+}
+
+// Drops the undo log and catches up on postponed compaction
+void PlantStore::commitBatch() {
+    batchOpen = false;
+    batchUndo.clear();
+    compactIfNeeded();
+}
+
+// Puts every touched slot back and re-points the index at the restored plants
+void PlantStore::rollbackBatch() {
+    // Unindex everything the batch appended or changed...
+    for (size_t slot = batchSlots; slot < slots.size(); ++slot)
+        if (slots[slot]) index.erase(slots[slot]->getName());
+    for (const auto &[slot, original] : batchUndo)
+        if (slots[slot]) index.erase(slots[slot]->getName());
+
+    // ...then restore the original content and index it again
+    slots.resize(batchSlots);
+    for (auto &[slot, original] : batchUndo) {
+        slots[slot] = move(original);
+        if (slots[slot]) index[slots[slot]->getName()] = slot;
+    }
+
+    holes = batchHoles;
+    batchOpen = false;
+    batchUndo.clear();
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "../Model/plant.h"
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// In-memory plant storage shared by the file-backed repositories.
+// Plants are kept in insertion order in a vector of slots, with a hash index
+// from name to slot so lookups and mutations do not scan the whole vector.
+// Removed slots are left empty and compacted lazily, which keeps removal O(1)
+// amortized without reordering the remaining plants.
+class PlantStore {
+private:
+    vector<optional<Plant>> slots;
+    unordered_map<string, size_t> index;
+
+    // Number of empty slots left behind by removals
+    size_t holes = 0;
+
+    // Undo log of the open batch: original content of every slot it touched,
+    // plus the slot count and hole count when it started
+    bool batchOpen = false;
+    unordered_map<size_t, optional<Plant>> batchUndo;
+    size_t batchSlots = 0;
+    size_t batchHoles = 0;
+
+    // Remembers the content of a slot before the open batch first changes it
+    void recordUndo(size_t slot);
+
+    // Drops empty slots and rebuilds the index once holes outnumber live plants
+    void compactIfNeeded();
+
+public:
+    // Adds a plant at the end; returns false if the name is already taken
+    bool add(const Plant &plant);
+    bool add(Plant &&plant);
+
+    // Replaces the plant with the same name; returns false if it does not exist
+    bool update(const Plant &plant);
+
+    // Removes a plant by name; returns false if it does not exist
+    bool remove(const string &name);
+
+    // Returns the plant with the given name, or nullptr if it does not exist
+    const Plant *find(const string &name) const;
+
+    // Checks if a plant with the given name is stored
+    bool contains(const string &name) const { return index.contains(name); }
+
+    // Returns a copy of all plants in insertion order
+    vector<Plant> toVector() const;
+
+    // Calls visitor for every plant in insertion order
+    template <typename Visitor>
+    void forEach(Visitor &&visitor) const {
+        for (const auto &slot : slots)
+            if (slot) visitor(*slot);
+    }
+
+    // Calls visitor for the plants in slots [first, last), in insertion order
+    template <typename Visitor>
+    void forEach(size_t first, size_t last, Visitor &&visitor) const {
+        last = min(last, slots.size());
+        for (size_t slot = first; slot < last; ++slot)
+            if (slots[slot]) visitor(*slots[slot]);
+    }
+
+    // Number of slots, including the empty ones left by removals
+    size_t slotCount() const { return slots.size(); }
+
+    // Number of plants currently stored
+    size_t size() const { return index.size(); }
+
+    // Reserves room for the given number of plants
+    void reserve(size_t count);
+
+    // Removes all plants
+    void clear();
+
+    // Starts recording changes so they can be rolled back; compaction is
+    // postponed until the batch ends
+    void beginBatch();
+
+    // Keeps the changes made since beginBatch
+    void commitBatch();
+
+    // Restores the exact state (including order) from before beginBatch
+    void rollbackBatch();
+};
@@ -0,0 +1,65 @@
+#include "repository_converter.h"
+#include "binary_plant_repository.h"
+#include "csv_plant_repository.h"
+#include "json_plant_repository.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+// Returns the lower-case extension of path, including the dot
+static string extensionOf(const string &path) {
+    string extension = filesystem::path(path).extension().string();
+    for (char &c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return extension;
+}
+
+// Opens the repository matching the file extension
+unique_ptr<PlantRepository> RepositoryConverter::open(const string &path) {
+    string extension = extensionOf(path);
+    if (extension == ".csv") return make_unique<CSVPlantRepository>(path);
+    if (extension == ".json") return make_unique<JSONPlantRepository>(path);
+    if (extension == ".bin") return make_unique<BinaryPlantRepository>(path);
+    throw invalid_argument("Unknown inventory format for " + path);
+}
+
+// Adds all plants inside one batch, so the target is written once
+size_t RepositoryConverter::copy(const PlantRepository &source, PlantRepository &target) {
+    vector<Plant> plants = source.getAllPlants();
+    PlantRepository::Batch batch(target);
+    for (const auto &plant : plants) target.addPlant(plant);
+    batch.commit();
+    return plants.size();
+}
+
+// Creates an empty target file of the right format, then adds the plants in one batch
+size_t RepositoryConverter::write(const vector<Plant> &plants, const string &targetPath) {
+    string extension = extensionOf(targetPath);
+    if (extension == ".bin") {
+        // Written in one pass, without growing the file record by record
+        BinaryPlantRepository::writeFile(targetPath, plants);
+        return plants.size();
+    }
+    if (extension != ".csv" && extension != ".json") throw invalid_argument("Unknown inventory format for " + targetPath);
+
+    filesystem::remove(targetPath);
+    ofstream empty(targetPath);
+    if (extension == ".csv") empty << "Name, Species, Quantity, Price\n";
+    else empty << "{\"plants\": []}\n";
+    empty.close();
+
+    unique_ptr<PlantRepository> target = open(targetPath);
+    PlantRepository::Batch batch(*target);
+    for (const auto &plant : plants) target->addPlant(plant);
+    batch.commit();
+    return plants.size();
+}
+
+// Reads the source and writes its plants in the target's format
+size_t RepositoryConverter::convert(const string &sourcePath, const string &targetPath) {
+    unique_ptr<PlantRepository> source = open(sourcePath);
+    return write(source->getAllPlants(), targetPath);
+}
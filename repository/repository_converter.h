@@ -0,0 +1,29 @@
+#pragma once
+#include "plant_repository.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Converts inventories between the CSV, JSON and binary formats.
+// Every field is carried over exactly (prices are written in their shortest
+// round-trip form), so converting back and forth is lossless.
+class RepositoryConverter {
+public:
+    // Opens a repository chosen by file extension: .csv, .json or .bin
+    static unique_ptr<PlantRepository> open(const string &path);
+
+    // Copies every plant of source into target with a single batch;
+    // returns the number of plants copied
+    static size_t copy(const PlantRepository &source, PlantRepository &target);
+
+    // Writes the plants into a new file at targetPath, replacing it if it
+    // exists; the format is chosen by extension. Returns the number written.
+    static size_t write(const vector<Plant> &plants, const string &targetPath);
+
+    // Converts the inventory file at sourcePath into a new file at targetPath,
+    // replacing it if it exists. Formats are chosen by extension.
+    static size_t convert(const string &sourcePath, const string &targetPath);
+};
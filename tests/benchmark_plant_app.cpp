@@ -0,0 +1,842 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <random>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Model/plant.h"
+#include "../Repository/plant_store.h"
+#include "../Repository/csv_plant_repository.h"
+#include "../Repository/json_plant_repository.h"
+#include "../Repository/csv_parser.h"
+#include "../Repository/mapped_file.h"
+#include "../Repository/plant_columns.h"
+#include "../Controller/plant_controller.h"
+#include "../Controller/filter_expression.h"
+
+using namespace std;
+
+// Standalone benchmarks for the inventory data structures.
+// Build with optimizations and run without arguments; results go to stdout.
+
+// Heap allocations made by the process, counted by the operator new below
+static atomic<size_t> allocationCount{0};
+
+void *operator new(size_t size) {
+    ++allocationCount;
+    if (void *p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+// Not inlined, so GCC does not pair the free() with a new-expression and warn
+[[gnu::noinline]] void operator delete(void *p) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Returns the number of heap allocations made by fn
+template <typename Fn>
+size_t countAllocations(Fn &&fn) {
+    size_t before = allocationCount;
+    fn();
+    return allocationCount - before;
+}
+
+// Returns the elapsed time of fn in milliseconds
+template <typename Fn>
+double timeMs(Fn &&fn) {
+    auto start = chrono::steady_clock::now();
+    fn();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Builds count plants with unique names
+vector<Plant> makePlants(size_t count) {
+    static const char *species[] = {"Succulent", "Flower", "Grass", "Fern", "Cactus", "Herb", "Tree", "Vine"};
+    mt19937 rng(42);
+    uniform_int_distribution<int> quantity(0, 200);
+    uniform_real_distribution<double> price(1.0, 100.0);
+
+    vector<Plant> plants;
+    plants.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        plants.emplace_back("Plant" + to_string(i), species[i % 8], quantity(rng), price(rng));
+    return plants;
+}
+
+// Name lookups and add/remove: linear find_if over vector<Plant> vs. PlantStore
+void benchmarkNameIndex() {
+    printf("== Name lookup: linear scan vs. PlantStore hash index ==\n");
+    printf("%10s %18s %18s %14s\n", "plants", "scan ns/lookup", "index ns/lookup", "index add ms");
+
+    for (size_t count : {10'000u, 100'000u, 1'000'000u}) {
+        vector<Plant> plants = makePlants(count);
+        mt19937 rng(7);
+        uniform_int_distribution<size_t> pick(0, count - 1);
+        vector<string> keys;
+        for (int i = 0; i < 1000; ++i) keys.push_back("Plant" + to_string(pick(rng)));
+
+        size_t found = 0;
+        double scanMs = timeMs([&] {
+            for (const auto &key : keys)
+                found += ranges::any_of(plants, [&key](const Plant &p) { return p.getName() == key; });
+        });
+
+        PlantStore store;
+        double addMs = timeMs([&] {
+            store.reserve(count);
+            for (const auto &plant : plants) store.add(plant);
+        });
+        double indexMs = timeMs([&] {
+            for (int round = 0; round < 100; ++round)
+                for (const auto &key : keys) found += store.contains(key);
+        });
+
+        printf("%10zu %18.1f %18.1f %14.1f\n", count,
+               scanMs * 1e6 / keys.size(), indexMs * 1e6 / (keys.size() * 100), addMs);
+        if (found == 0) printf("(nothing found)\n");
+    }
+    printf("\n");
+}
+
+// Writes a CSV inventory file with the given plants
+void writeCSV(const string &filename, const vector<Plant> &plants) {
+    ofstream out(filename);
+    out << "Name, Species, Quantity, Price\n";
+    for (const auto &p : plants)
+        out << p.getName() << ',' << p.getSpecies() << ',' << p.getQuantity() << ',' << p.getPrice() << '\n';
+}
+
+// Cost of single updates: whole-file rewrite vs. journal append
+void benchmarkPersistenceModes() {
+    printf("== Update cost: rewrite vs. journaled persistence ==\n");
+    printf("%10s %16s %16s\n", "plants", "rewrite ms/op", "journal ms/op");
+
+    const string filename = "bench_plants.csv";
+    for (size_t count : {10'000u, 100'000u}) {
+        vector<Plant> plants = makePlants(count);
+        double perMode[2];
+        for (int journaled = 0; journaled < 2; ++journaled) {
+            writeCSV(filename, plants);
+            CSVPlantRepository repo(filename, {journaled ? PersistenceMode::Journaled : PersistenceMode::Rewrite, 1'000'000});
+            const int updates = 50;
+            perMode[journaled] = timeMs([&] {
+                for (int i = 0; i < updates; ++i)
+                    repo.updatePlant(Plant(plants[i].getName(), plants[i].getSpecies(), i, 2.5));
+            }) / updates;
+        }
+        printf("%10zu %16.3f %16.3f\n", count, perMode[0], perMode[1]);
+    }
+    remove(filename.c_str());
+    remove((filename + ".wal").c_str());
+    printf("\n");
+}
+
+// CSV load: the former ifstream/getline/stringstream/stoi loop vs. the mapped from_chars parser
+void benchmarkCSVLoad() {
+    printf("== CSV load: getline + stringstream vs. mmap + from_chars ==\n");
+    printf("%10s %14s %14s %18s\n", "plants", "getline ms", "mapped ms", "repository open ms");
+
+    const string filename = "bench_plants.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+
+        size_t loaded = 0;
+        double getlineMs = timeMs([&] {
+            ifstream file(filename);
+            string line;
+            getline(file, line); // Header
+            vector<Plant> plants;
+            while (getline(file, line)) {
+                stringstream ss(line);
+                string name, species, quantityStr, priceStr;
+                getline(ss, name, ',');
+                getline(ss, species, ',');
+                getline(ss, quantityStr, ',');
+                getline(ss, priceStr, ',');
+                plants.emplace_back(name, species, stoi(quantityStr), stod(priceStr));
+            }
+            loaded += plants.size();
+        });
+        double mappedMs = timeMs([&] {
+            MappedFile file(filename);
+            string_view body = file.view().substr(CSVParser::skipHeader(file.view()));
+            vector<Plant> plants;
+            plants.reserve(CSVParser::countLines(body) + 1);
+            CSVParser::parse(body, plants);
+            loaded += plants.size();
+        });
+        double openMs = timeMs([&] {
+            CSVPlantRepository repo(filename);
+            loaded += repo.exists("Plant0");
+        });
+        printf("%10zu %14.1f %14.1f %18.1f\n", count, getlineMs, mappedMs, openMs);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Parallel CSV load: repository open time by thread count
+void benchmarkParallelCSVLoad() {
+    printf("== Parallel CSV load (%u hardware threads) ==\n", thread::hardware_concurrency());
+    printf("%10s %10s %12s %10s\n", "plants", "threads", "open ms", "speedup");
+
+    const string filename = "bench_plants.csv";
+    const size_t count = 1'000'000;
+    writeCSV(filename, makePlants(count));
+
+    double baseline = 0;
+    unsigned maxThreads = max(1u, thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        size_t loaded = 0;
+        double ms = timeMs([&] {
+            CSVPlantRepository repo(filename, {PersistenceMode::Rewrite, 10000, threads});
+            loaded += repo.exists("Plant0");
+        });
+        if (threads == 1) baseline = ms;
+        printf("%10zu %10u %12.1f %9.2fx\n", count, threads, ms, baseline / ms);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Streaming JSON: save (indented and compact) and load times
+void benchmarkJSON() {
+    printf("== Streaming JSON repository ==\n");
+    printf("%10s %10s %12s %12s\n", "plants", "layout", "save ms", "load ms");
+
+    const string filename = "bench_plants.json";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        vector<Plant> plants = makePlants(count);
+        for (bool compact : {false, true}) {
+            FileRepositoryOptions options;
+            options.compactJson = compact;
+            ofstream(filename) << "{\"plants\": []}";
+            double saveMs;
+            {
+                JSONPlantRepository repo(filename, options);
+                repo.beginBatch();
+                for (const auto &plant : plants) repo.addPlant(plant);
+                saveMs = timeMs([&] { repo.commit(); });
+            }
+            size_t loaded = 0;
+            double loadMs = timeMs([&] {
+                JSONPlantRepository repo(filename, options);
+                loaded += repo.exists("Plant0");
+            });
+            printf("%10zu %10s %12.1f %12.1f\n", count, compact ? "compact" : "indented", saveMs, loadMs);
+        }
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Search and statistics on copies of the inventory vs. the visitor read path
+void benchmarkReadPath() {
+    printf("== Read path: getAllPlants() copies vs. forEachPlant visitor ==\n");
+    printf("%10s %-22s %12s %12s\n", "plants", "query", "allocations", "ms");
+
+    const string filename = "bench_read.csv";
+    for (size_t count : {10'000u, 100'000u}) {
+        vector<Plant> plants = makePlants(count);
+        // Long species names defeat the small string optimization, as real data would
+        for (auto &plant : plants) plant = Plant(plant.getName(), plant.getSpecies() + " (cultivated variety)",
+                                                 plant.getQuantity(), plant.getPrice());
+        writeCSV(filename, plants);
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+        const string term = "Plant1234";
+
+        size_t matches = 0;
+        auto report = [&](const char *query, auto &&fn) {
+            double ms = 0;
+            size_t allocations = countAllocations([&] { ms = timeMs(fn); });
+            printf("%10zu %-22s %12zu %12.2f\n", count, query, allocations, ms);
+        };
+        report("search (copy all)", [&] {
+            for (const auto &plant : controller.getAllPlants())
+                matches += plant.getName().find(term) != string::npos;
+        });
+        report("search (visitor)", [&] { matches += controller.searchPlants(term).size(); });
+        report("stats (3 full copies)", [&] {
+            double value = 0;
+            for (int i = 0; i < 3; ++i)
+                for (const auto &plant : controller.getAllPlants()) value += plant.getQuantity() * plant.getPrice();
+            matches += value > 0;
+        });
+        report("stats (incremental)", [&] {
+            matches += controller.getTotalUniquePlants() + controller.getTotalQuantity() +
+                       (controller.getTotalInventoryValue() > 0);
+        });
+        if (matches == 0) printf("unexpected: no matches\n");
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// searchPlants through the trigram index vs. a scan of every plant
+void benchmarkSearch() {
+    printf("== Substring search: scan vs. trigram index ==\n");
+    printf("%10s %10s %14s %14s %12s %10s\n", "plants", "term", "scan us/query", "index us/query", "index ms", "matches");
+
+    const string filename = "bench_search.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+        unique_ptr<PlantController> controller;
+        double buildMs = timeMs([&] { controller = make_unique<PlantController>(make_unique<CSVPlantRepository>(filename)); });
+
+        for (const string term : {"plant12345", "ant9999", "Cactus"}) {
+            const int queries = 20;
+            size_t scanned = 0, matches = 0;
+            double scanMs = timeMs([&] {
+                for (int i = 0; i < queries; ++i)
+                    controller->forEachPlant([&](const Plant &plant) {
+                        scanned += plant.getName().find(term) != string::npos ||
+                                   plant.getSpecies().find(term) != string::npos;
+                    });
+            });
+            double indexMs = timeMs([&] {
+                for (int i = 0; i < queries; ++i) matches = controller->searchPlants(term, true).size();
+            });
+            printf("%10zu %10s %14.1f %14.1f %12.1f %10zu\n", count, term.c_str(),
+                   scanMs * 1000 / queries, indexMs * 1000 / queries, buildMs, matches);
+        }
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Filter + sum: virtual matches() per plant vs. bitmap kernels on PlantColumns
+void benchmarkColumnar() {
+    printf("== Filter and aggregate: virtual matches loop vs. columnar kernels ==\n");
+    printf("%10s %-34s %12s %12s %10s\n", "plants", "filters", "loop ms", "columns ms", "matches");
+
+    const string filename = "bench_columns.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+        CSVPlantRepository repository(filename);
+        PlantColumns columns(repository);
+        FilterTotals loopTotals, columnTotals;
+
+        struct Case {
+            const char *label;
+            vector<shared_ptr<PlantFilter>> filters;
+        };
+        const Case cases[] = {
+            {"price in [20, 60]", {make_shared<PricePlantFilter>(20, 60)}},
+            {"price AND quantity >= 50", {make_shared<PricePlantFilter>(20, 60), make_shared<MinQuantityPlantFilter>(50)}},
+            {"price AND quantity AND species",
+             {make_shared<PricePlantFilter>(20, 60), make_shared<MinQuantityPlantFilter>(50),
+              make_shared<SpeciesPlantFilter>("Fern")}}};
+
+        for (const auto &test : cases) {
+            AndPlantFilter combined(test.filters);
+            const int queries = 10;
+            double loopMs = timeMs([&] {
+                for (int i = 0; i < queries; ++i) {
+                    loopTotals = {};
+                    repository.forEachPlant([&](const Plant &plant) {
+                        if (!combined.matches(plant)) return;
+                        ++loopTotals.plants;
+                        loopTotals.quantity += plant.getQuantity();
+                        loopTotals.value += plant.getQuantity() * plant.getPrice();
+                    });
+                }
+            });
+            double columnMs = timeMs([&] {
+                for (int i = 0; i < queries; ++i) {
+                    SelectionBitmap rows = columns.selectPriceRange(20, 60);
+                    if (test.filters.size() > 1) rows &= columns.selectQuantityRange(50, numeric_limits<int>::max());
+                    if (test.filters.size() > 2) rows &= columns.selectSpecies("Fern");
+                    columnTotals = {rows.count(), columns.sumQuantity(rows), columns.sumValue(rows)};
+                }
+            });
+            if (loopTotals.plants != columnTotals.plants || loopTotals.quantity != columnTotals.quantity)
+                printf("mismatch: %zu vs %zu plants\n", loopTotals.plants, columnTotals.plants);
+            printf("%10zu %-34s %12.2f %12.2f %10zu\n", count, test.label, loopMs / queries, columnMs / queries,
+                   columnTotals.plants);
+        }
+
+        // Whole-inventory sums: the selection is all ones, so every block takes the SIMD path
+        const int queries = 10;
+        double sumMs = timeMs([&] {
+            for (int i = 0; i < queries; ++i) {
+                SelectionBitmap rows = columns.selectAll();
+                columnTotals = {rows.count(), columns.sumQuantity(rows), columns.sumValue(rows)};
+            }
+        });
+        printf("%10zu %-34s %12s %12.2f %10zu\n", count, "sum of all plants", "-", sumMs / queries, columnTotals.plants);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Per-plant predicate cost: AndPlantFilter (virtual calls) vs. an inlined filter expression
+void benchmarkFilterExpressions() {
+    printf("== Filter predicates: AndPlantFilter vs. filter expression ==\n");
+    printf("%10s %-32s %14s %14s %10s\n", "plants", "filters", "virtual ns", "expression ns", "matches");
+
+    for (size_t count : {100'000u, 1'000'000u}) {
+        vector<Plant> plants = makePlants(count);
+        AndPlantFilter runtime({make_shared<PricePlantFilter>(20, 60), make_shared<MinQuantityPlantFilter>(50),
+                                make_shared<SpeciesPlantFilter>("Fern")});
+        auto expression = priceBetween(20, 60) && quantityAtLeast(50) && speciesIs("Fern");
+
+        const int rounds = 10;
+        size_t virtualMatches = 0, expressionMatches = 0;
+        double virtualMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i)
+                for (const auto &plant : plants) virtualMatches += runtime.matches(plant);
+        });
+        double expressionMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i)
+                for (const auto &plant : plants) expressionMatches += expression(plant);
+        });
+        printf("%10zu %-32s %14.2f %14.2f %10zu\n", count, "price AND quantity AND species",
+               virtualMs * 1e6 / (rounds * count), expressionMs * 1e6 / (rounds * count), expressionMatches / rounds);
+        if (virtualMatches != expressionMatches) printf("mismatch: %zu vs %zu\n", virtualMatches, expressionMatches);
+    }
+    printf("\n");
+}
+
+// Partitioned scans: ParallelScan::collect on pools of increasing size
+void benchmarkParallelScan() {
+    printf("== Parallel scan: filter over slot ranges on a work-stealing pool ==\n");
+    printf("(%u hardware threads)\n", thread::hardware_concurrency());
+    printf("%10s %8s %12s %10s\n", "plants", "threads", "ms/query", "matches");
+
+    const string filename = "bench_parallel.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+        CSVPlantRepository repository(filename);
+        OrPlantFilter filter({make_shared<NamePlantFilter>("777"), make_shared<AndPlantFilter>(vector<shared_ptr<PlantFilter>>{
+                                  make_shared<SpeciesPlantFilter>("Herb"), make_shared<PricePlantFilter>(10, 12)})});
+        auto predicate = [&filter](const Plant &plant) { return filter.matches(plant); };
+
+        for (unsigned threads : {0u, 1u, 3u, 7u}) {
+            WorkStealingPool pool(threads);
+            const int queries = 10;
+            size_t matches = 0;
+            double ms = timeMs([&] {
+                for (int i = 0; i < queries; ++i) matches = ParallelScan::collect(repository, &pool, predicate).size();
+            });
+            printf("%10zu %8u %12.2f %10zu\n", count, threads + 1, ms / queries, matches);
+        }
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Query VM: per-plant cost against the equivalent PlantFilter tree, and compile vs. cached
+void benchmarkQuery() {
+    printf("== Text query: bytecode VM vs. PlantFilter tree ==\n");
+    printf("%10s %14s %14s %14s %12s %10s\n", "plants", "tree ns", "vm ns", "compile us", "query ms", "matches");
+
+    const string text = "species = \"Fern\" and price < 20 and qty >= 50 or name ~ \"plant777\"";
+    OrPlantFilter tree({make_shared<AndPlantFilter>(vector<shared_ptr<PlantFilter>>{
+                            make_shared<SpeciesPlantFilter>("Fern"), make_shared<PricePlantFilter>(-1e300, 19.999999),
+                            make_shared<MinQuantityPlantFilter>(50)}),
+                        make_shared<NamePlantFilter>("Plant777")});
+
+    const string filename = "bench_query.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        vector<Plant> plants = makePlants(count);
+        QueryProgram program = QueryProgram::compile(text);
+
+        const int rounds = 10;
+        size_t treeMatches = 0, vmMatches = 0;
+        double treeMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i)
+                for (const auto &plant : plants) treeMatches += tree.matches(plant);
+        });
+        double vmMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i)
+                for (const auto &plant : plants) vmMatches += program.matches(plant);
+        });
+        const int compiles = 10000;
+        double compileMs = timeMs([&] {
+            for (int i = 0; i < compiles; ++i) program = QueryProgram::compile(text);
+        });
+
+        writeCSV(filename, plants);
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+        size_t matches = controller.query(text).size(); // Compiles and caches
+        double queryMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i) matches = controller.query(text).size();
+        });
+        printf("%10zu %14.2f %14.2f %14.2f %12.2f %10zu\n", count, treeMs * 1e6 / (rounds * count),
+               vmMs * 1e6 / (rounds * count), compileMs * 1000 / compiles, queryMs / rounds, matches);
+        if (treeMatches != vmMatches) printf("mismatch: %zu vs %zu\n", treeMatches, vmMatches);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// One page of an ordered result: copy-and-sort everything vs. index order / top-K selection
+void benchmarkPages() {
+    printf("== Ordered pages: getAllPlants + sort vs. getPlantsPage ==\n");
+    printf("%10s %-28s %12s %12s\n", "plants", "page", "sort ms", "page ms");
+
+    const string filename = "bench_pages.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+
+        struct Case {
+            const char *label;
+            PlantPageRequest request;
+        };
+        const Case cases[] = {{"top 50 by value", {PlantSortKey::Value, true, 0, 50}},
+                              {"page 3 by price (index)", {PlantSortKey::Price, false, 100, 50}},
+                              {"page 3 by species (index)", {PlantSortKey::Species, true, 100, 50}},
+                              {"page 3 by name (top-K)", {PlantSortKey::Name, false, 100, 50}}};
+        for (const auto &test : cases) {
+            const int rounds = 5;
+            double sortMs = timeMs([&] {
+                for (int i = 0; i < rounds; ++i) {
+                    vector<Plant> plants = controller.getAllPlants();
+                    ranges::stable_sort(plants, [&test](const Plant &a, const Plant &b) {
+                        switch (test.request.key) {
+                        case PlantSortKey::Value: return a.getQuantity() * a.getPrice() > b.getQuantity() * b.getPrice();
+                        case PlantSortKey::Price: return a.getPrice() < b.getPrice();
+                        case PlantSortKey::Species: return a.getSpecies() > b.getSpecies();
+                        default: return a.getName() < b.getName();
+                        }
+                    });
+                }
+            });
+            size_t rows = 0;
+            double pageMs = timeMs([&] {
+                for (int i = 0; i < rounds; ++i) rows += controller.getPlantsPage(test.request).size();
+            });
+            printf("%10zu %-28s %12.2f %12.3f\n", count, test.label, sortMs / rounds, pageMs / rounds);
+            if (rows != rounds * test.request.limit) printf("short page: %zu rows\n", rows / rounds);
+        }
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Per-species aggregates: incrementally maintained groups vs. a one-shot group-by scan
+void benchmarkGroupBy() {
+    printf("== Group-by: maintained species totals vs. one-shot scans ==\n");
+    printf("%10s %16s %16s %16s %8s\n", "plants", "maintained us", "species scan ms", "price bands ms", "groups");
+
+    const string filename = "bench_groups.csv";
+    for (size_t count : {100'000u, 1'000'000u}) {
+        writeCSV(filename, makePlants(count));
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+        controller.enableParallelScans();
+
+        const int rounds = 10;
+        size_t groups = 0;
+        double maintainedMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i) groups = controller.getSpeciesTotals().size();
+        });
+        double speciesMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i) controller.groupPlants([](const Plant &plant) { return plant.getSpecies(); });
+        });
+        double bandsMs = timeMs([&] {
+            for (int i = 0; i < rounds; ++i)
+                controller.groupPlants([](const Plant &plant) { return to_string(static_cast<int>(plant.getPrice()) / 10); });
+        });
+        printf("%10zu %16.2f %16.2f %16.2f %8zu\n", count, maintainedMs * 1000 / rounds, speciesMs / rounds,
+               bandsMs / rounds, groups);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Undo history size over a long session of stock adjustments, with and without coalescing
+void benchmarkUndoHistory() {
+    printf("== Undo history: 200k stock updates over 1000 plants ==\n");
+    printf("%12s %10s %12s %10s %12s\n", "coalescing", "entries", "bytes", "B/entry", "updates/s");
+
+    const string filename = "bench_undo.csv";
+    for (bool coalesce : {false, true}) {
+        writeCSV(filename, makePlants(1000));
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+        UndoHistoryLimits limits;
+        limits.maxEntries = SIZE_MAX;
+        limits.maxBytes = SIZE_MAX;
+        limits.coalesceUpdates = coalesce;
+        controller.setUndoHistoryLimits(limits);
+
+        vector<Plant> plants = controller.getAllPlants();
+        mt19937 rng(5);
+        const int updates = 200'000;
+        controller.beginBatch();
+        double ms = timeMs([&] {
+            for (int i = 0; i < updates; ++i) {
+                // Runs of adjustments to one plant, as when stock is counted shelf by shelf
+                const Plant &plant = plants[(i / 8) % plants.size()];
+                controller.updatePlant(plant.getName(), plant.getSpecies(), static_cast<int>(rng() % 100), plant.getPrice());
+            }
+        });
+        controller.commitBatch();
+        UndoHistoryUsage usage = controller.getUndoHistoryUsage();
+        printf("%12s %10zu %12zu %10.1f %12.0f\n", coalesce ? "on" : "off", usage.undoEntries, usage.bytes,
+               static_cast<double>(usage.bytes) / usage.undoEntries, updates / ms * 1000);
+    }
+    // The previous command kept two full Plant copies per update and never coalesced
+    size_t fullCopy = 2 * sizeof(void*) + 2 * sizeof(Plant);
+    printf("%12s %10d %12zu %10zu %12s\n", "full copies", 200'000, 200'000 * fullCopy, fullCopy, "-");
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// A delivery of 800 new SKUs: one command (and one file write) per plant vs. one bulk edit
+void benchmarkBulkEdits() {
+    printf("== Bulk edits: 800-SKU delivery into a 10k-plant CSV ==\n");
+    printf("%14s %12s %12s %14s\n", "mode", "apply ms", "undo ms", "undo entries");
+
+    const string filename = "bench_bulk.csv";
+    vector<PlantEdit> delivery;
+    for (int i = 0; i < 800; ++i) delivery.push_back(PlantEdit::add(Plant("Sku" + to_string(i), "Herb", 10, 4.5)));
+
+    for (bool bulk : {false, true}) {
+        writeCSV(filename, makePlants(10'000));
+        PlantController controller(make_unique<CSVPlantRepository>(filename));
+        double applyMs = timeMs([&] {
+            if (bulk) {
+                controller.applyEdits(delivery);
+                return;
+            }
+            for (const PlantEdit &edit : delivery)
+                controller.addPlant(edit.plant.getName(), edit.plant.getSpecies(), edit.plant.getQuantity(),
+                                    edit.plant.getPrice());
+        });
+        size_t entries = controller.getUndoHistoryUsage().undoEntries;
+        double undoMs = timeMs([&] {
+            for (size_t i = 0; i < entries; ++i) controller.undo();
+        });
+        printf("%14s %12.1f %12.1f %14zu\n", bulk ? "applyEdits" : "addPlant x800", applyMs, undoMs, entries);
+    }
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Lookups per second with and without concurrent mode, and with readers racing a writer
+void benchmarkConcurrentReads() {
+    printf("== Concurrent access: getPlantByName on 100k plants, 1s per row ==\n");
+    printf("%22s %10s %14s %12s\n", "mode", "readers", "lookups/s", "writes/s");
+
+    const string filename = "bench_concurrent.csv";
+    writeCSV(filename, makePlants(100'000));
+    PlantController controller(make_unique<CSVPlantRepository>(filename, FileRepositoryOptions{PersistenceMode::Journaled, 1'000'000}));
+
+    auto run = [&](const char *mode, int readers, bool withWriter) {
+        atomic<bool> stop{false};
+        atomic<size_t> lookups{0}, writes{0};
+        vector<thread> threads;
+        for (int r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r] {
+                mt19937 rng(r);
+                size_t local = 0;
+                while (!stop) {
+                    controller.getPlantByName("Plant" + to_string(rng() % 100'000));
+                    ++local;
+                }
+                lookups += local;
+            });
+        }
+        if (withWriter) {
+            threads.emplace_back([&] {
+                mt19937 rng(99);
+                while (!stop) {
+                    controller.updatePlant("Plant" + to_string(rng() % 100'000), "Herb", static_cast<int>(rng() % 50), 3.0);
+                    ++writes;
+                }
+            });
+        }
+        this_thread::sleep_for(chrono::seconds(1));
+        stop = true;
+        for (auto &thread : threads) thread.join();
+        printf("%22s %10d %14zu %12zu\n", mode, readers, lookups.load(), writes.load());
+    };
+
+    run("plain", 1, false);
+    controller.enableConcurrentAccess();
+    for (int readers : {1, 4}) run("concurrent", readers, false);
+    for (int readers : {1, 4}) run("concurrent + writer", readers, true);
+    controller.disableConcurrentAccess();
+    remove(filename.c_str());
+    remove((filename + ".wal").c_str());
+    printf("\n");
+}
+
+// Snapshot costs: publication per update, a held version, iteration and export vs. the live inventory
+void benchmarkSnapshots() {
+    printf("== Copy-on-write snapshots (1M plants) ==\n");
+
+    const string filename = "bench_snapshots.csv";
+    const string exportFile = "bench_snapshots_export.csv";
+    writeCSV(filename, makePlants(1'000'000));
+    PlantController controller(make_unique<CSVPlantRepository>(filename, FileRepositoryOptions{PersistenceMode::Journaled, 10'000'000}));
+
+    const int updates = 20'000;
+    mt19937 rng(8);
+    auto update = [&] {
+        controller.updatePlant("Plant" + to_string(rng() % 1'000'000), "Herb", static_cast<int>(rng() % 50), 3.0);
+    };
+    double updateMs = timeMs([&] { for (int i = 0; i < updates; ++i) update(); });
+    printf("  update + publish         %10.2f us\n", updateMs * 1000 / updates);
+
+    double loadUs = timeMs([&] { for (int i = 0; i < 100'000; ++i) controller.snapshot(); }) * 10;
+    printf("  snapshot() load          %10.3f us\n", loadUs / 1000);
+
+    size_t count = 0;
+    double liveMs = timeMs([&] { controller.forEachPlant([&count](const Plant &) { ++count; }); });
+    auto held = controller.snapshot();
+    double iterateMs = timeMs([&] { held->forEach([&count](const Plant &) { ++count; }); });
+    printf("  iterate live / snapshot  %10.2f / %.2f ms\n", liveMs, iterateMs);
+
+    // Writer keeps updating while another thread exports the held version
+    atomic<bool> exporting{true};
+    size_t during = 0;
+    thread writer([&] {
+        while (exporting) {
+            update();
+            ++during;
+        }
+    });
+    double exportMs = timeMs([&] { held->exportTo(exportFile); });
+    exporting = false;
+    writer.join();
+    printf("  export 1M to CSV         %10.2f ms (%zu updates applied meanwhile)\n", exportMs, during);
+
+    remove(filename.c_str());
+    remove((filename + ".wal").c_str());
+    remove(exportFile.c_str());
+    printf("\n");
+}
+
+// Mutation latency with a full rewrite per mutation vs. the write-behind thread,
+// and how long a write-behind mutation takes to reach the file
+void benchmarkWriteBehind() {
+    printf("== Write-behind persistence (100k plants) ==\n");
+
+    const string filename = "bench_write_behind.csv";
+    auto plants = makePlants(100'000);
+    struct Result {
+        double mutationMs, flushMs;
+        PersistenceStats stats;
+    };
+    auto run = [&](PersistenceMode mode, int updates) {
+        writeCSV(filename, plants);
+        CSVPlantRepository repo(filename, FileRepositoryOptions{mode});
+        double mutationMs = timeMs([&] {
+            for (int i = 0; i < updates; ++i)
+                repo.updatePlant(Plant(plants[i].getName(), plants[i].getSpecies(), i, 2.5));
+        }) / updates;
+        double flushMs = timeMs([&] { repo.flush(); });
+        return Result{mutationMs, flushMs, repo.persistenceStats()};
+    };
+
+    Result rewrite = run(PersistenceMode::Rewrite, 50);
+    Result writeBehind = run(PersistenceMode::WriteBehind, 20'000);
+    const PersistenceStats &stats = writeBehind.stats;
+    printf("  mutation, rewrite        %10.3f ms\n", rewrite.mutationMs);
+    printf("  mutation, write-behind   %10.3f ms\n", writeBehind.mutationMs);
+    printf("  final flush              %10.2f ms\n", writeBehind.flushMs);
+    printf("  file writes / mutations  %10llu / %llu\n", static_cast<unsigned long long>(stats.fileWrites),
+           static_cast<unsigned long long>(stats.mutationsWritten));
+    printf("  durable latency mean/max %10.2f / %.2f ms\n", stats.meanLatencyMs, stats.maxLatencyMs);
+
+    remove(filename.c_str());
+    printf("\n");
+}
+
+// Mutations per second under each durability policy, journaled, in the
+// working directory: one thread on the repository, then four threads through
+// the controller's writer queue
+void benchmarkDurability() {
+    printf("== Durability policies (journaled, 10k plants, local disk) ==\n");
+    printf("%14s %16s %16s %12s\n", "policy", "1 thread mut/s", "4 threads mut/s", "fsyncs");
+
+    const string filename = "bench_durability.csv";
+    auto plants = makePlants(10'000);
+    auto options = [](DurabilityPolicy durability) {
+        FileRepositoryOptions result{PersistenceMode::Journaled, 1'000'000};
+        result.durability = durability;
+        return result;
+    };
+    // Updates for about half a second; PerBatch commits every 100
+    auto measure = [&](PlantController &controller, int threads, bool batched) {
+        atomic<bool> stop{false};
+        atomic<size_t> total{0};
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                mt19937 rng(t);
+                size_t local = 0;
+                while (!stop) {
+                    if (batched) {
+                        vector<PlantEdit> edits;
+                        for (int i = 0; i < 100; ++i)
+                            edits.push_back(PlantEdit::update(Plant(plants[rng() % plants.size()].getName(), "Herb", i, 2.0)));
+                        controller.applyEdits(edits);
+                        local += edits.size();
+                    } else {
+                        controller.updatePlant(plants[rng() % plants.size()].getName(), "Herb", static_cast<int>(local % 50), 2.0);
+                        ++local;
+                    }
+                }
+                total += local;
+            });
+        }
+        this_thread::sleep_for(chrono::milliseconds(500));
+        stop = true;
+        for (auto &worker : workers) worker.join();
+        return total / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    const pair<const char *, DurabilityPolicy> policies[] = {{"none", DurabilityPolicy::None},
+                                                             {"per batch", DurabilityPolicy::PerBatch},
+                                                             {"group commit", DurabilityPolicy::GroupCommit},
+                                                             {"always", DurabilityPolicy::Always}};
+    for (auto [name, policy] : policies) {
+        writeCSV(filename, plants);
+        remove((filename + ".wal").c_str());
+        PlantController controller(make_unique<CSVPlantRepository>(filename, options(policy)));
+        bool batched = policy == DurabilityPolicy::PerBatch;
+        double single = measure(controller, 1, batched);
+        controller.enableConcurrentAccess();
+        double concurrent = measure(controller, 4, batched);
+        controller.disableConcurrentAccess();
+        printf("%14s %16.0f %16.0f %12llu\n", name, single, concurrent,
+               static_cast<unsigned long long>(controller.getPersistenceStats().fileSyncs));
+    }
+
+    remove(filename.c_str());
+    remove((filename + ".wal").c_str());
+    printf("\n");
+}
+
+int main() {
+    benchmarkNameIndex();
+    benchmarkPersistenceModes();
+    benchmarkCSVLoad();
+    benchmarkParallelCSVLoad();
+    benchmarkJSON();
+    benchmarkReadPath();
+    benchmarkSearch();
+    benchmarkColumnar();
+    benchmarkFilterExpressions();
+    benchmarkParallelScan();
+    benchmarkQuery();
+    benchmarkPages();
+    benchmarkGroupBy();
+    benchmarkUndoHistory();
+    benchmarkBulkEdits();
+    benchmarkConcurrentReads();
+    benchmarkSnapshots();
+    benchmarkWriteBehind();
+    benchmarkDurability();
+    return 0;
+}
@@ -1,13 +1,23 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <map>
+#include <random>
+#include <thread>
 
 #include "../Model/plant.h"
 #include "../Repository/plant_repository.h"
 #include "../Repository/csv_plant_repository.h"
 #include "../Repository/json_plant_repository.h"
+#include "../Repository/binary_plant_repository.h"
+#include "../Repository/repository_converter.h"
 #include "../Controller/plant_controller.h"
 #include  "../Controller/filter.h"
+#include "../Controller/filter_expression.h"
 
 using namespace std;
 
@@ -53,6 +63,311 @@ TEST(CSVPlantRepositoryTest, AddUpdateRemoveCRUD) {
     deleteTestFiles(testFile);
 }
 
+TEST(CSVPlantRepositoryTest, RemoveKeepsOrderAndIndex) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    {
+        CSVPlantRepository repo(testFile);
+        for (int i = 0; i < 100; ++i)
+            repo.addPlant(Plant("Plant" + to_string(i), "Species", i, 1.0));
+
+        // Remove every plant except multiples of 10, enough to trigger compaction
+        for (int i = 0; i < 100; ++i)
+            if (i % 10 != 0) repo.removePlant("Plant" + to_string(i));
+
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 10);
+        for (int i = 0; i < 10; ++i)
+            ASSERT_EQ(all[i].getName(), "Plant" + to_string(i * 10));
+
+        // Lookups still resolve to the right plant after compaction
+        ASSERT_EQ(repo.getPlantByName("Plant90").getQuantity(), 90);
+        ASSERT_FALSE(repo.exists("Plant5"));
+        repo.addPlant(Plant("Plant5", "Species", 5, 1.0));
+        ASSERT_EQ(repo.getAllPlants().back().getName(), "Plant5");
+    }
+    {
+        // Reloading the file gives the same order
+        CSVPlantRepository repo(testFile);
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 11);
+        ASSERT_EQ(all.front().getName(), "Plant0");
+        ASSERT_EQ(all.back().getName(), "Plant5");
+    }
+    deleteTestFiles(testFile);
+}
+
+// Counts the lines of a text file (0 if it does not exist)
+size_t countLines(const string &filename) {
+    ifstream in(filename);
+    size_t lines = 0;
+    string line;
+    while (getline(in, line)) ++lines;
+    return lines;
+}
+
+TEST(CSVPlantRepositoryTest, JournaledModeAppendsAndReplays) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+    deleteTestFiles(testFile + ".wal");
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    FileRepositoryOptions journaled{PersistenceMode::Journaled, 1000};
+    {
+        CSVPlantRepository repo(testFile, journaled);
+        repo.addPlant(Plant("Aloe", "Succulent", 5, 15.5));
+        repo.addPlant(Plant("Rose", "Flower", 10, 8.9));
+        repo.addPlant(Plant("Lily", "Flower", 8, 4.5));
+        repo.updatePlant(Plant("Aloe", "Succulent", 7, 17.25));
+        repo.removePlant("Rose");
+
+        // The base file is untouched, every mutation is one journal record
+        ASSERT_EQ(countLines(testFile), 1);
+        ASSERT_EQ(countLines(testFile + ".wal"), 5);
+    }
+    {
+        // Replaying the journal restores the same state
+        CSVPlantRepository repo(testFile, journaled);
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 2);
+        ASSERT_EQ(all[0].getName(), "Aloe");
+        ASSERT_EQ(all[0].getQuantity(), 7);
+        ASSERT_DOUBLE_EQ(all[0].getPrice(), 17.25);
+        ASSERT_EQ(all[1].getName(), "Lily");
+
+        // Compaction folds the journal into the base file
+        repo.compact();
+        ASSERT_EQ(countLines(testFile), 3);
+        ASSERT_EQ(countLines(testFile + ".wal"), 0);
+    }
+    {
+        // Background compaction triggers after compactAfter records
+        CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Journaled, 4});
+        for (int i = 0; i < 10; ++i)
+            repo.addPlant(Plant("Plant" + to_string(i), "Species", i, 1.0));
+    }
+    {
+        // Opening in rewrite mode folds any leftover journal once
+        CSVPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 12);
+        ASSERT_EQ(countLines(testFile), 13);
+        ifstream wal(testFile + ".wal");
+        ASSERT_FALSE(wal.is_open());
+    }
+    {
+        // Records already in the journal count towards compactAfter after a reopen
+        {
+            CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Journaled, 1000});
+            for (int i = 0; i < 3; ++i) repo.updatePlant(Plant("Plant" + to_string(i), "Species", 50, 1.0));
+        }
+        CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Journaled, 4});
+        repo.updatePlant(Plant("Plant3", "Species", 50, 1.0));
+        repo.flush();
+        ASSERT_EQ(countLines(testFile + ".wal"), 0);
+    }
+    {
+        // A failed compaction keeps its log, never fails a mutation and is
+        // reported by flush; later rotations append to its log until one succeeds
+        filesystem::create_directory(testFile + ".tmp"); // The new base file cannot be written
+        {
+            CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Journaled, 4});
+            for (int i = 20; i < 28; ++i) repo.addPlant(Plant("Plant" + to_string(i), "Species", i, 1.0));
+            EXPECT_THROW(repo.flush(), runtime_error);
+            repo.flush(); // Reported once
+            ASSERT_EQ(countLines(testFile + ".wal.compacting"), 8);
+        }
+        {
+            CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Journaled, 4});
+            ASSERT_EQ(repo.getAllPlants().size(), 20);
+            filesystem::remove(testFile + ".tmp");
+            repo.removePlant("Plant20");
+            repo.flush();
+            ASSERT_FALSE(filesystem::exists(testFile + ".wal.compacting"));
+        }
+        CSVPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 19);
+        ASSERT_EQ(countLines(testFile), 20);
+    }
+    {
+        // A torn record left by a crash is cut off before the next append
+        {
+            ofstream wal(testFile + ".wal", ios::binary);
+            wal << "U\tPlant21\tSpecies\t5";
+        }
+        {
+            CSVPlantRepository repo(testFile, journaled);
+            ASSERT_EQ(repo.getPlantByName("Plant21").getQuantity(), 21);
+            repo.updatePlant(Plant("Plant22", "Species", 1, 1.0));
+        }
+        CSVPlantRepository repo(testFile, journaled);
+        ASSERT_EQ(repo.getPlantByName("Plant21").getQuantity(), 21);
+        ASSERT_EQ(repo.getPlantByName("Plant22").getQuantity(), 1);
+        ASSERT_EQ(countLines(testFile + ".wal"), 1);
+    }
+    deleteTestFiles(testFile);
+    deleteTestFiles(testFile + ".wal");
+}
+
+TEST(CSVPlantRepositoryTest, BatchCommitAndRollback) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Aloe,Succulent,5,15.5\n";
+    out << "Rose,Flower,10,8.9\n";
+    out << "Lily,Flower,8,4.5\n";
+    out.close();
+
+    {
+        CSVPlantRepository repo(testFile);
+
+        // Nothing is written until commit
+        repo.beginBatch();
+        for (int i = 0; i < 50; ++i)
+            repo.addPlant(Plant("Plant" + to_string(i), "Species", i, 1.0));
+        repo.removePlant("Rose");
+        ASSERT_EQ(countLines(testFile), 4);
+        repo.commit();
+        ASSERT_EQ(countLines(testFile), 53);
+
+        // Rollback restores the exact previous state, including order
+        repo.beginBatch();
+        repo.removePlant("Aloe");
+        repo.updatePlant(Plant("Lily", "Flower", 1, 1.0));
+        for (int i = 0; i < 50; ++i) repo.removePlant("Plant" + to_string(i));
+        repo.addPlant(Plant("Rose", "Flower", 3, 3.0));
+        repo.rollback();
+
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 52);
+        ASSERT_EQ(all[0].getName(), "Aloe");
+        ASSERT_EQ(all[1].getName(), "Lily");
+        ASSERT_EQ(all[1].getQuantity(), 8);
+        ASSERT_EQ(all[2].getName(), "Plant0");
+        ASSERT_FALSE(repo.exists("Rose"));
+        ASSERT_EQ(countLines(testFile), 53);
+
+        // A failing mutation inside an RAII batch rolls everything back
+        try {
+            PlantRepository::Batch batch(repo);
+            repo.addPlant(Plant("Fern", "Fern", 1, 1.0));
+            repo.addPlant(Plant("Aloe", "Succulent", 1, 1.0));
+            batch.commit();
+        } catch (const PlantRepository::DuplicatePlantException &) {}
+        ASSERT_FALSE(repo.inBatch());
+        ASSERT_FALSE(repo.exists("Fern"));
+        EXPECT_THROW(repo.commit(), runtime_error);
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(CSVPlantRepositoryTest, QuotedFieldsRoundTrip) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    ofstream out(testFile, ios::out | ios::binary);
+    out << "Name, Species, Quantity, Price\r\n";
+    out << "\"Aloe, Blue\",Succulent,5,15.5\r\n";
+    out << "\"Say \"\"Hi\"\"\",Flower, 3 ,2.25\r\n";
+    out << "\r\n";
+    out << "Fern,\"Multi\nline\",1,0.1";
+    out.close();
+
+    {
+        CSVPlantRepository repo(testFile);
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 3);
+        ASSERT_EQ(all[0].getName(), "Aloe, Blue");
+        ASSERT_EQ(all[1].getName(), "Say \"Hi\"");
+        ASSERT_EQ(all[1].getQuantity(), 3);
+        ASSERT_EQ(all[2].getSpecies(), "Multi\nline");
+        ASSERT_DOUBLE_EQ(all[2].getPrice(), 0.1);
+
+        // Saving quotes the fields again
+        repo.addPlant(Plant("Rose, Red", "Flower", 2, 8.9));
+    }
+    {
+        CSVPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 4);
+        ASSERT_EQ(repo.getPlantByName("Aloe, Blue").getQuantity(), 5);
+        ASSERT_EQ(repo.getPlantByName("Rose, Red").getSpecies(), "Flower");
+        ASSERT_DOUBLE_EQ(repo.getPlantByName("Fern").getPrice(), 0.1);
+    }
+
+    // Malformed numbers are reported with their line
+    out.open(testFile, ios::out | ios::trunc);
+    out << "Name,Species,Quantity,Price\nAloe,Succulent,5,15.5\nRose,Flower,ten,8.9\n";
+    out.close();
+    try {
+        CSVPlantRepository repo(testFile);
+        FAIL() << "Expected a parse error";
+    } catch (const runtime_error &e) {
+        ASSERT_NE(string(e.what()).find("line 3"), string::npos);
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(CSVPlantRepositoryTest, ParallelLoadKeepsOrderAndRejectsDuplicates) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    // Large enough to be split into several chunks
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 100000; ++i)
+        out << "Plant" << i << ",Species" << i % 7 << "," << i << "," << i * 0.5 << "\n";
+    out.close();
+
+    {
+        CSVPlantRepository sequential(testFile);
+        CSVPlantRepository parallel(testFile, FileRepositoryOptions{PersistenceMode::Rewrite, 10000, 4});
+        auto expected = sequential.getAllPlants();
+        auto actual = parallel.getAllPlants();
+        ASSERT_EQ(actual.size(), 100000);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQ(actual[i].getName(), expected[i].getName());
+            ASSERT_EQ(actual[i].getQuantity(), expected[i].getQuantity());
+        }
+    }
+
+    // A duplicate far from the original lands in another chunk and is still caught
+    out.open(testFile, ios::out | ios::app);
+    out << "Plant0,Species0,1,1\n";
+    out.close();
+    EXPECT_THROW(CSVPlantRepository repo(testFile, FileRepositoryOptions{PersistenceMode::Rewrite, 10000, 4}), runtime_error);
+    EXPECT_THROW(CSVPlantRepository repo(testFile), runtime_error);
+
+    // Numbers the former stoi / stod loader accepted still load the same way
+    out.open(testFile, ios::out | ios::trunc);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Aloe,Succulent,5.0,+15.5\n";
+    out << "Rose,Flower,+10, 8.9 \n";
+    out << "Lily,Flower,3,x\n";
+    out.close();
+    EXPECT_THROW(CSVPlantRepository repo(testFile), runtime_error);
+    out.open(testFile, ios::out | ios::trunc);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Aloe,Succulent,5.0,+15.5\n";
+    out << "Rose,Flower,+10, 8.9 \n";
+    out.close();
+    {
+        CSVPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getPlantByName("Aloe").getQuantity(), 5);
+        ASSERT_DOUBLE_EQ(repo.getPlantByName("Aloe").getPrice(), 15.5);
+        ASSERT_EQ(repo.getPlantByName("Rose").getQuantity(), 10);
+    }
+    deleteTestFiles(testFile);
+}
+
 TEST(JSONPlantRepository, AddUpdateRemoveCRUD) {
     const string testFile = "test_plants.json";
     deleteTestFiles(testFile); // Delete the file if it exists
@@ -87,6 +402,198 @@ TEST(JSONPlantRepository, AddUpdateRemoveCRUD) {
     deleteTestFiles(testFile);
 }
 
+TEST(JSONPlantRepository, StreamingReadAndCompactWrite) {
+    const string testFile = "test_plants.json";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    ofstream out(testFile, ios::out);
+    out << R"({"version": 2, "meta": {"plants": [1]}, "plants": [
+        {"name": "Aloe \"Vera\"", "species": "Succulent", "quantity": 5, "price": 15.5, "tags": ["a", {"b": null}]},
+        42,
+        {"name": "Fl\u00f6te \ud83c\udf35", "quantity": 2.5},
+        {"price": 1e1, "name": "Rose", "species": "Flower", "quantity": 10}
+    ]})";
+    out.close();
+
+    FileRepositoryOptions compact;
+    compact.compactJson = true;
+    {
+        JSONPlantRepository repo(testFile, compact);
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 3);
+        ASSERT_EQ(all[0].getName(), "Aloe \"Vera\"");
+        ASSERT_EQ(all[0].getQuantity(), 5);
+        ASSERT_EQ(all[1].getName(), "Fl\xc3\xb6te \xf0\x9f\x8c\xb5");
+        ASSERT_EQ(all[1].getSpecies(), "");
+        ASSERT_EQ(all[1].getQuantity(), 0);
+        ASSERT_DOUBLE_EQ(all[2].getPrice(), 10.0);
+
+        repo.updatePlant(Plant("Rose", "Flower", 11, 0.1));
+    }
+
+    // Compact output is a single line and reads back losslessly
+    ASSERT_EQ(countLines(testFile), 1);
+    {
+        JSONPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 3);
+        ASSERT_EQ(repo.getPlantByName("Rose").getPrice(), 0.1);
+        ASSERT_EQ(repo.getPlantByName("Aloe \"Vera\"").getSpecies(), "Succulent");
+    }
+
+    out.open(testFile, ios::out | ios::trunc);
+    out << R"({"plants": [{"name": "Aloe",]})";
+    out.close();
+    EXPECT_THROW(JSONPlantRepository repo(testFile), runtime_error);
+
+    out.open(testFile, ios::out | ios::trunc);
+    out << R"([{"name": "Aloe"}])";
+    out.close();
+    EXPECT_THROW(JSONPlantRepository repo(testFile), runtime_error);
+
+    // Duplicate names are rejected as in CSV files
+    out.open(testFile, ios::out | ios::trunc);
+    out << R"({"plants": [{"name": "Aloe"}, {"name": "Rose"}, {"name": "Aloe"}]})";
+    out.close();
+    EXPECT_THROW(JSONPlantRepository repo(testFile), runtime_error);
+    deleteTestFiles(testFile);
+}
+
+TEST(BinaryPlantRepositoryTest, AddUpdateRemoveCRUD) {
+    const string testFile = "test_plants.bin";
+    deleteTestFiles(testFile); // Start from a fresh file
+
+    {
+        BinaryPlantRepository repo(testFile);
+        repo.addPlant(Plant("Aloe", "Succulent", 5, 15.5));
+        repo.addPlant(Plant("Rose", "Flower", 10, 8.9));
+        repo.addPlant(Plant("Lily", "Flower", 8, 4.5));
+
+        repo.updatePlant(Plant("Aloe", "Succulent", 7, 17.5));
+        repo.updatePlant(Plant("Lily", "Bulb", 9, 4.75));
+        repo.removePlant("Rose");
+
+        EXPECT_THROW(repo.addPlant(Plant("Aloe", "Succulent", 1, 13)), PlantRepository::DuplicatePlantException);
+        EXPECT_THROW(repo.removePlant("Rose"), PlantRepository::PlantNotFoundException);
+
+        // Rollback restores records and header
+        repo.beginBatch();
+        repo.removePlant("Aloe");
+        repo.addPlant(Plant("Fern", "Fern", 1, 1.0));
+        repo.updatePlant(Plant("Lily", "Flower", 0, 0));
+        repo.rollback();
+        ASSERT_FALSE(repo.exists("Fern"));
+        ASSERT_EQ(repo.getPlantByName("Lily").getSpecies(), "Bulb");
+    }
+    {
+        // Reopening maps the same data; nothing is parsed
+        BinaryPlantRepository repo(testFile);
+        auto all = repo.getAllPlants();
+        ASSERT_EQ(all.size(), 2);
+        ASSERT_EQ(all[0].getName(), "Aloe");
+        ASSERT_EQ(all[0].getQuantity(), 7);
+        ASSERT_DOUBLE_EQ(all[0].getPrice(), 17.5);
+        ASSERT_EQ(all[1].getName(), "Lily");
+        ASSERT_EQ(all[1].getSpecies(), "Bulb");
+
+        // Growing past the initial capacity and compacting after many removals
+        for (int i = 0; i < 5000; ++i)
+            repo.addPlant(Plant("Plant" + to_string(i), string(i % 50, 'x'), i, i * 0.25));
+        for (int i = 0; i < 4000; ++i) repo.removePlant("Plant" + to_string(i));
+        ASSERT_EQ(repo.getAllPlants().size(), 1002);
+        ASSERT_DOUBLE_EQ(repo.getPlantByName("Plant4999").getPrice(), 4999 * 0.25);
+    }
+    {
+        BinaryPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 1002);
+        ASSERT_EQ(repo.getAllPlants()[2].getName(), "Plant4000");
+    }
+
+    // Opening a clean file reads only its header; verify() catches a flipped byte
+    {
+        fstream corrupt(testFile, ios::in | ios::out | ios::binary);
+        corrupt.seekp(72 + 16);
+        corrupt.put('\x7f');
+    }
+    {
+        BinaryPlantRepository repo(testFile);
+        EXPECT_THROW(repo.verify(), runtime_error);
+    }
+    deleteTestFiles(testFile);
+
+    // A copy taken while the file is open looks like a crash: it is flagged
+    // dirty, and a torn record costs that plant only
+    const string crashFile = "test_crash.bin";
+    deleteTestFiles(crashFile);
+    {
+        BinaryPlantRepository repo(testFile);
+        for (int i = 0; i < 10; ++i) repo.addPlant(Plant("Plant" + to_string(i), "Herb", i, 1.5));
+        repo.updatePlant(Plant("Plant3", "Herb", 30, 2.5));
+        filesystem::copy_file(testFile, crashFile);
+    }
+    {
+        fstream torn(crashFile, ios::in | ios::out | ios::binary);
+        torn.seekp(72 + 3 * 48 + 24); // Price of Plant3
+        torn.write("\xff\xff\xff\xff", 4);
+    }
+    {
+        BinaryPlantRepository repo(crashFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 9);
+        ASSERT_FALSE(repo.exists("Plant3"));
+        ASSERT_EQ(repo.getPlantByName("Plant4").getQuantity(), 4);
+        repo.verify();
+    }
+    {
+        BinaryPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 10);
+        ASSERT_EQ(repo.getPlantByName("Plant3").getQuantity(), 30);
+        repo.verify();
+    }
+    deleteTestFiles(crashFile);
+    deleteTestFiles(testFile);
+
+    // Species replaced by updates count as garbage and are compacted away too
+    {
+        BinaryPlantRepository repo(testFile);
+        repo.addPlant(Plant("Aloe", "Succulent", 5, 15.5));
+        for (int i = 0; i < 50000; ++i) repo.updatePlant(Plant("Aloe", i % 2 ? "Succulent" : "Cactus", i, 15.5));
+        repo.verify();
+    }
+    ASSERT_LT(filesystem::file_size(testFile), 256 * 1024);
+    {
+        BinaryPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getPlantByName("Aloe").getSpecies(), "Succulent");
+        repo.verify();
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(RepositoryConverterTest, LosslessRoundTrip) {
+    const string csvFile = "test_convert.csv", binFile = "test_convert.bin";
+    const string jsonFile = "test_convert.json", backFile = "test_convert_back.csv";
+
+    ofstream out(csvFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "\"Aloe, Blue\",Succulent,5,0.1\n";
+    out << "Rose,Flower,10,8.123456789012345\n";
+    out << "Lily,\"Say \"\"Hi\"\"\",0,1e-7\n";
+    out.close();
+
+    ASSERT_EQ(RepositoryConverter::convert(csvFile, binFile), 3);
+    ASSERT_EQ(RepositoryConverter::convert(binFile, jsonFile), 3);
+    ASSERT_EQ(RepositoryConverter::convert(jsonFile, backFile), 3);
+
+    auto original = RepositoryConverter::open(csvFile)->getAllPlants();
+    auto converted = RepositoryConverter::open(backFile)->getAllPlants();
+    ASSERT_EQ(converted.size(), original.size());
+    for (size_t i = 0; i < original.size(); ++i) {
+        ASSERT_EQ(converted[i].getName(), original[i].getName());
+        ASSERT_EQ(converted[i].getSpecies(), original[i].getSpecies());
+        ASSERT_EQ(converted[i].getQuantity(), original[i].getQuantity());
+        ASSERT_EQ(converted[i].getPrice(), original[i].getPrice()); // Bit-exact
+    }
+    for (const auto &file : {csvFile, binFile, jsonFile, backFile}) deleteTestFiles(file);
+}
+
 TEST(PlantControllerTest, AddUpdateRemoveUndoRedo) {
     const string testFile = "test_plants.csv";
     deleteTestFiles(testFile); // Delete the file if it exists
@@ -230,3 +737,1313 @@ TEST(PlantControllerTest, Statistics) {
     }
     deleteTestFiles(testFile);
 }
+
+TEST(PlantControllerTest, IncrementalStatisticsStayInSync) {
+    const string csvFile = "test_plants.csv", binFile = "test_plants.bin";
+    deleteTestFiles(csvFile);
+    deleteTestFiles(binFile);
+
+    ofstream out(csvFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Lily,Flower,8,4.5\n";
+    out.close();
+
+    vector<unique_ptr<PlantRepository>> repos;
+    repos.push_back(make_unique<CSVPlantRepository>(csvFile));
+    repos.push_back(make_unique<BinaryPlantRepository>(binFile));
+    repos.back()->addPlant(Plant("Lily", "Flower", 8, 4.5));
+    for (auto &repo : repos) {
+        PlantController controller(move(repo));
+        controller.setStatsCrossCheck(true); // Every read below is verified by a full scan
+
+        controller.addPlant("Bamboo", "Grass", 15, 20.0);
+        controller.addPlant("Rose", "Flower", 10, 0.1);
+        controller.updatePlant("Rose", "Flower", 3, 0.7);
+        controller.removePlant("Bamboo");
+        controller.undo();
+        controller.undo();
+        controller.redo();
+        ASSERT_NO_THROW(controller.getTotalInventoryValue());
+
+        controller.beginBatch();
+        controller.addPlant("Aloe", "Succulent", 5, 15.5);
+        controller.removePlant("Rose");
+        controller.rollbackBatch();
+
+        ASSERT_EQ(controller.getTotalUniquePlants(), 3);
+        ASSERT_EQ(controller.getTotalQuantity(), 8 + 15 + 3);
+        ASSERT_NEAR(controller.getTotalInventoryValue(), 8*4.5 + 15*20.0 + 3*0.7, 1e-9);
+    }
+    deleteTestFiles(csvFile);
+    deleteTestFiles(binFile);
+}
+
+TEST(PlantControllerTest, SpeciesIndex) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Lily,Flower,8,4.5\n";
+    out << "Aloe,Succulent,5,15.5\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.addPlant("Rose", "Flower", 0, 8.9);
+        controller.addPlant("Bamboo", "Grass", 15, 20.0);
+        controller.addPlant("Tulip", "Flower", 3, 2.0);
+        controller.updatePlant("Bamboo", "Flower", 15, 20.0);
+        controller.removePlant("Rose");
+        controller.undo(); // Rose comes back at the end
+
+        ASSERT_EQ(controller.getSpecies(), vector<string>({"Flower", "Succulent"}));
+        ASSERT_EQ(controller.countBySpecies("Flower"), 4);
+        ASSERT_EQ(controller.countBySpecies("Grass"), 0);
+
+        // Index lookups return plants in the same order as a scan
+        vector<string> names;
+        for (const auto &plant : controller.getPlantsBySpecies("Flower")) names.push_back(plant.getName());
+        ASSERT_EQ(names, vector<string>({"Lily", "Bamboo", "Tulip", "Rose"}));
+
+        vector<shared_ptr<PlantFilter>> filters = {
+            make_shared<StockAvailabilityPlantFilter>(true), make_shared<SpeciesPlantFilter>("Flower")};
+        names.clear();
+        for (const auto &plant : controller.filterPlants(filters)) names.push_back(plant.getName());
+        ASSERT_EQ(names, vector<string>({"Lily", "Bamboo", "Tulip"}));
+        ASSERT_EQ(controller.filterPlants({make_shared<SpeciesPlantFilter>("Cactus")}).size(), 0);
+
+        controller.beginBatch();
+        controller.addPlant("Cactus", "Cactus", 1, 1.0);
+        controller.removePlant("Aloe");
+        controller.rollbackBatch();
+        ASSERT_EQ(controller.getSpecies(), vector<string>({"Flower", "Succulent"}));
+        ASSERT_EQ(controller.getPlantsBySpecies("Succulent")[0].getName(), "Aloe");
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, PriceAndQuantityIndexes) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        mt19937 rng(3);
+        for (int i = 0; i < 300; ++i) {
+            string name = "Plant" + to_string(rng() % 60);
+            double price = (rng() % 40) / 2.0; // Plenty of equal prices
+            int quantity = rng() % 10;
+            bool exists = ranges::any_of(controller.getAllPlants(), [&](const Plant &p) { return p.getName() == name; });
+            if (rng() % 5 == 0) {
+                try { controller.undo(); } catch (const runtime_error &) {} // Nothing to undo
+            } else if (!exists) {
+                controller.addPlant(name, "Herb", quantity, price);
+            } else if (rng() % 2) {
+                controller.updatePlant(name, "Herb", quantity, price);
+            } else {
+                controller.removePlant(name);
+            }
+        }
+        auto all = controller.getAllPlants();
+
+        // Band query in price order, exactly the plants a scan finds
+        auto band = controller.getPlantsByPriceRange(5, 7.5);
+        ASSERT_TRUE(ranges::is_sorted(band, {}, &Plant::getPrice));
+        ASSERT_EQ(band.size(), ranges::count_if(all, [](const Plant &p) { return p.getPrice() >= 5 && p.getPrice() <= 7.5; }));
+        ASSERT_TRUE(controller.getPlantsByPriceRange(8, 2).empty());
+
+        // Indexed filters return the same plants in the same order as a scan
+        auto names = [](const vector<Plant> &plants) {
+            vector<string> result;
+            for (const auto &plant : plants) result.push_back(plant.getName());
+            return result;
+        };
+        vector<shared_ptr<PlantFilter>> filters = {
+            make_shared<NamePlantFilter>("1"), make_shared<PricePlantFilter>(2, 12)};
+        vector<Plant> expected;
+        for (const auto &plant : all)
+            if (plant.getName().find('1') != string::npos && plant.getPrice() >= 2 && plant.getPrice() <= 12)
+                expected.push_back(plant);
+        ASSERT_EQ(names(controller.filterPlants(filters)), names(expected));
+
+        expected.clear();
+        for (const auto &plant : all) if (plant.getQuantity() >= 6) expected.push_back(plant);
+        ASSERT_EQ(names(controller.filterPlants({make_shared<MinQuantityPlantFilter>(6)})), names(expected));
+        ASSERT_EQ(controller.getPlantsByMinQuantity(6).size(), expected.size());
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, TrigramSearchMatchesScan) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        const vector<string> species = {"Succulent", "Flower", "Blue Fern", "fern"};
+        controller.beginBatch();
+        for (int i = 0; i < 3000; ++i)
+            controller.addPlant((i % 3 ? "Plant" : "PLANT") + to_string(i), species[i % 4], 1, 1.0);
+        controller.commitBatch();
+        for (int i = 0; i < 3000; i += 2) controller.removePlant((i % 3 ? "Plant" : "PLANT") + to_string(i));
+        controller.updatePlant("Plant1", "Ferny Tree", 1, 1.0);
+
+        auto names = [](const vector<Plant> &plants) {
+            vector<string> result;
+            for (const auto &plant : plants) result.push_back(plant.getName());
+            return result;
+        };
+        auto lower = [](string text) {
+            for (char &c : text) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            return text;
+        };
+        auto all = controller.getAllPlants();
+        for (const string term : {"ant12", "PLANT29", "Fern", "fern", "nt", "x", "", "Ferny", "lant999", "zzz"}) {
+            vector<Plant> exact, folded;
+            for (const auto &plant : all) {
+                if (plant.getName().find(term) != string::npos || plant.getSpecies().find(term) != string::npos)
+                    exact.push_back(plant);
+                if (lower(plant.getName()).find(lower(term)) != string::npos ||
+                    lower(plant.getSpecies()).find(lower(term)) != string::npos)
+                    folded.push_back(plant);
+            }
+            ASSERT_EQ(names(controller.searchPlants(term)), names(exact)) << term;
+            ASSERT_EQ(names(controller.searchPlants(term, true)), names(folded)) << term;
+        }
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, FilterPlannerMatchesScan) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 2000; ++i)
+        out << "Plant" << i << ",Species" << i % 40 << "," << i % 7 << "," << (i % 100) / 4.0 << "\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        vector<shared_ptr<PlantFilter>> pool = {
+            make_shared<SpeciesPlantFilter>("Species3"), make_shared<SpeciesPlantFilter>("Species17"),
+            make_shared<PricePlantFilter>(10, 10.5), make_shared<PricePlantFilter>(0, 20),
+            make_shared<MinQuantityPlantFilter>(6), make_shared<StockAvailabilityPlantFilter>(false),
+            make_shared<NamePlantFilter>("Plant19"), make_shared<NamePlantFilter>("3"),
+            make_shared<OrPlantFilter>(vector<shared_ptr<PlantFilter>>{
+                make_shared<SpeciesPlantFilter>("Species5"), make_shared<MinQuantityPlantFilter>(5)})};
+
+        auto all = controller.getAllPlants();
+        mt19937 rng(11);
+        for (int round = 0; round < 200; ++round) {
+            vector<shared_ptr<PlantFilter>> filters;
+            for (size_t count = 1 + rng() % 3; filters.size() < count;) filters.push_back(pool[rng() % pool.size()]);
+            bool useAnd = rng() % 2;
+
+            shared_ptr<PlantFilter> combined = useAnd ? shared_ptr<PlantFilter>(make_shared<AndPlantFilter>(filters))
+                                                      : make_shared<OrPlantFilter>(filters);
+            vector<string> expected, actual;
+            for (const auto &plant : all) if (combined->matches(plant)) expected.push_back(plant.getName());
+            for (const auto &plant : controller.filterPlants(filters, useAnd)) actual.push_back(plant.getName());
+            ASSERT_EQ(actual, expected) << combined->describe();
+        }
+
+        // A selective species filter seeds the candidates; the broad price range is only checked
+        auto explanation = controller.explainFilter(
+            {make_shared<PricePlantFilter>(0, 20), make_shared<SpeciesPlantFilter>("Species3")});
+        EXPECT_NE(explanation.plan.find("  index species = \"Species3\""), string::npos) << explanation.plan;
+        EXPECT_NE(explanation.plan.find("  check price in [0, 20]"), string::npos) << explanation.plan;
+        EXPECT_EQ(explanation.actualRows, 40);
+
+        // Two indexed filters under the limit are intersected
+        explanation = controller.explainFilter(
+            {make_shared<SpeciesPlantFilter>("Species3"), make_shared<PricePlantFilter>(10, 10.5)});
+        EXPECT_NE(explanation.plan.find("intersect index"), string::npos) << explanation.plan;
+
+        // Nothing selective: a scan with the checks ordered by rank
+        explanation = controller.explainFilter({make_shared<NamePlantFilter>("3"), make_shared<MinQuantityPlantFilter>(1)}, false);
+        EXPECT_NE(explanation.plan.find("scan all plants"), string::npos) << explanation.plan;
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, ColumnarFiltersMatchScan) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 3000; ++i)
+        out << "Plant" << i << ",Species" << i % 30 << "," << i % 9 << "," << (i % 80) / 4.0 << "\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        vector<shared_ptr<PlantFilter>> pool = {
+            make_shared<PricePlantFilter>(0, 15), make_shared<PricePlantFilter>(5, 5.75),
+            make_shared<MinQuantityPlantFilter>(4), make_shared<StockAvailabilityPlantFilter>(true),
+            make_shared<StockAvailabilityPlantFilter>(false), make_shared<SpeciesPlantFilter>("Species4"),
+            make_shared<SpeciesPlantFilter>("Unknown"),
+            make_shared<OrPlantFilter>(vector<shared_ptr<PlantFilter>>{
+                make_shared<SpeciesPlantFilter>("Species7"), make_shared<PricePlantFilter>(19, 20)})};
+
+        // Filter results (in order) and totals must equal a scalar scan
+        mt19937 rng(5);
+        auto verify = [&]() {
+            auto all = controller.getAllPlants();
+            for (int round = 0; round < 50; ++round) {
+                vector<shared_ptr<PlantFilter>> filters;
+                for (size_t count = 1 + rng() % 3; filters.size() < count;) filters.push_back(pool[rng() % pool.size()]);
+                bool useAnd = rng() % 2;
+                shared_ptr<PlantFilter> combined = useAnd ? shared_ptr<PlantFilter>(make_shared<AndPlantFilter>(filters))
+                                                          : make_shared<OrPlantFilter>(filters);
+
+                vector<string> expected, actual;
+                long long quantity = 0;
+                double value = 0;
+                for (const auto &plant : all) {
+                    if (!combined->matches(plant)) continue;
+                    expected.push_back(plant.getName());
+                    quantity += plant.getQuantity();
+                    value += plant.getQuantity() * plant.getPrice();
+                }
+                for (const auto &plant : controller.filterPlants(filters, useAnd)) actual.push_back(plant.getName());
+                ASSERT_EQ(actual, expected) << combined->describe();
+
+                FilterTotals totals = controller.getFilterTotals(filters, useAnd);
+                EXPECT_EQ(totals.plants, expected.size());
+                EXPECT_EQ(totals.quantity, quantity);
+                EXPECT_NEAR(totals.value, value, 1e-6 * max(1.0, value));
+            }
+        };
+        verify();
+
+        // Broad range filters run on the columns
+        auto explanation = controller.explainFilter({make_shared<PricePlantFilter>(0, 15), make_shared<MinQuantityPlantFilter>(1)});
+        EXPECT_NE(explanation.plan.find("scan columns (vectorized)"), string::npos) << explanation.plan;
+
+        // A name filter has no kernel, so totals fall back to filterPlants
+        FilterTotals named = controller.getFilterTotals({make_shared<NamePlantFilter>("Plant12")});
+        EXPECT_EQ(named.plants, controller.filterPlants({make_shared<NamePlantFilter>("Plant12")}).size());
+
+        // Enough removals to rebuild the columns, then updates and new rows
+        controller.beginBatch();
+        for (int i = 0; i < 3000; i += 3) {
+            controller.removePlant("Plant" + to_string(i));
+            controller.removePlant("Plant" + to_string(i + 1));
+        }
+        for (int i = 2; i < 300; i += 3) controller.updatePlant("Plant" + to_string(i), "Species4", 100, 1.5);
+        for (int i = 0; i < 100; ++i) controller.addPlant("New" + to_string(i), "Species7", i, 19.5);
+        controller.commitBatch();
+        verify();
+
+        // A rolled back batch resets the columns from the repository
+        controller.beginBatch();
+        for (int i = 2; i < 600; i += 3) controller.removePlant("Plant" + to_string(i));
+        controller.rollbackBatch();
+        verify();
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, ExpressionFiltersMatchRuntimeFilters) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 500; ++i)
+        out << "Plant" << i << ",Species" << i % 5 << "," << i % 6 << "," << (i % 40) / 2.0 << "\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        auto names = [](const vector<Plant> &plants) {
+            vector<string> result;
+            for (const auto &plant : plants) result.push_back(plant.getName());
+            return result;
+        };
+
+        auto expression = priceBetween(5, 15) && speciesIs("Species2") && inStock();
+        vector<shared_ptr<PlantFilter>> runtime = {make_shared<PricePlantFilter>(5, 15),
+                                                   make_shared<SpeciesPlantFilter>("Species2"),
+                                                   make_shared<StockAvailabilityPlantFilter>(true)};
+        EXPECT_EQ(names(controller.filterPlants(expression)), names(controller.filterPlants(runtime)));
+        EXPECT_FALSE(controller.filterPlants(expression).empty());
+
+        auto either = nameContains("Plant4") || quantityAtLeast(5);
+        EXPECT_EQ(names(controller.filterPlants(either)),
+                  names(controller.filterPlants({make_shared<NamePlantFilter>("Plant4"), make_shared<MinQuantityPlantFilter>(5)},
+                                                false)));
+
+        // Negation has no runtime counterpart; compare with the complement
+        auto negated = !outOfStock() && !speciesIs("Species0");
+        size_t expected = 0;
+        for (const auto &plant : controller.getAllPlants())
+            expected += plant.getQuantity() > 0 && plant.getSpecies() != "Species0";
+        EXPECT_EQ(controller.filterPlants(negated).size(), expected);
+
+        // Wrapped expressions work wherever a PlantFilter does
+        auto wrapped = toPlantFilter(expression);
+        EXPECT_EQ(names(controller.filterPlants({wrapped})), names(controller.filterPlants(expression)));
+        EXPECT_EQ(wrapped->describe(), "((price in [5, 15] AND species = \"Species2\") AND in stock)");
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, ParallelScansKeepRepositoryOrder) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 60000; ++i)
+        out << "Plant" << i << ",Species" << i % 12 << "," << i % 10 << "," << (i % 50) / 2.0 << "\n";
+    out.close();
+
+    {
+        CSVPlantRepository repository(testFile);
+        repository.beginBatch();
+        for (int i = 0; i < 60000; i += 7) repository.removePlant("Plant" + to_string(i)); // Empty slots
+        repository.commit();
+
+        // Partitions are scanned by several threads and joined in slot order
+        WorkStealingPool pool(3);
+        auto predicate = [](const Plant &plant) { return plant.getQuantity() > 4 && plant.getSpecies() != "Species3"; };
+        vector<string> expected, actual;
+        repository.forEachPlant([&](const Plant &plant) {
+            if (predicate(plant)) expected.push_back(plant.getName());
+        });
+        for (const auto &plant : ParallelScan::collect(repository, &pool, predicate)) actual.push_back(plant.getName());
+        EXPECT_EQ(actual, expected);
+
+        // Nested runs and errors reach the caller
+        atomic<size_t> calls{0};
+        pool.run(8, [&](size_t) { pool.run(8, [&](size_t) { ++calls; }); });
+        EXPECT_EQ(calls, 64u);
+        EXPECT_THROW(pool.run(16, [](size_t i) { if (i == 5) throw runtime_error("task failed"); }), runtime_error);
+    }
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        vector<shared_ptr<PlantFilter>> filters = {make_shared<MinQuantityPlantFilter>(3), make_shared<NamePlantFilter>("9")};
+        auto sequentialFilter = controller.filterPlants(filters, false);
+        auto sequentialSearch = controller.searchPlants("pl", true);
+
+        controller.enableParallelScans(1);
+        auto names = [](const vector<Plant> &plants) {
+            vector<string> result;
+            for (const auto &plant : plants) result.push_back(plant.getName());
+            return result;
+        };
+        EXPECT_EQ(names(controller.filterPlants(filters, false)), names(sequentialFilter));
+        EXPECT_EQ(names(controller.searchPlants("pl", true)), names(sequentialSearch));
+        EXPECT_EQ(controller.filterPlants(quantityAtLeast(3) || nameContains("9")).size(), sequentialFilter.size());
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, QueryLanguage) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 400; ++i)
+        out << (i % 10 == 0 ? "Aloe" : "Plant") << i << "," << (i % 3 ? "Succulent" : "Fern") << "," << i % 8 << ","
+            << (i % 30) + 0.5 << "\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        auto all = controller.getAllPlants();
+        auto check = [&](const string &text, const function<bool(const Plant &)> &expected) {
+            vector<string> wanted, actual;
+            for (const auto &plant : all) if (expected(plant)) wanted.push_back(plant.getName());
+            for (const auto &plant : controller.query(text)) actual.push_back(plant.getName());
+            EXPECT_EQ(actual, wanted) << text;
+            EXPECT_EQ(controller.query(text).size(), wanted.size()) << text; // Cached program
+        };
+
+        // "and" binds tighter than "or"; ~ ignores case
+        check("species = \"Succulent\" and price < 20 and qty >= 5 or name ~ \"aloe\"", [](const Plant &p) {
+            return (p.getSpecies() == "Succulent" && p.getPrice() < 20 && p.getQuantity() >= 5) ||
+                   p.getName().find("Aloe") != string::npos;
+        });
+        check("NOT (species != \"Fern\" OR quantity <= 2) and name !~ \"0\"", [](const Plant &p) {
+            return p.getSpecies() == "Fern" && p.getQuantity() > 2 && p.getName().find('0') == string::npos;
+        });
+        check("price >= 29.5 or price = 0.5", [](const Plant &p) { return p.getPrice() >= 29.5 || p.getPrice() == 0.5; });
+        check("name = \"Plant7\"", [](const Plant &p) { return p.getName() == "Plant7"; });
+
+        // Short-circuiting compiles to forward jumps
+        auto program = QueryProgram::compile("qty > 1 and price < 5 or species ~ \"fern\"");
+        EXPECT_EQ(program.disassemble(), "0: quantity > 1\n1: jump_if_false 3\n2: price < 5\n3: jump_if_true 5\n"
+                                         "4: species ~ \"fern\"\n");
+
+        // Errors point at the offending column
+        EXPECT_THROW(controller.query(""), invalid_argument);
+        EXPECT_THROW(controller.query("color = \"red\""), invalid_argument);
+        EXPECT_THROW(controller.query("price ~ 5"), invalid_argument);
+        EXPECT_THROW(controller.query("name < \"x\""), invalid_argument);
+        EXPECT_THROW(controller.query("(qty > 1"), invalid_argument);
+        try {
+            controller.query("qty > 1 and name = \"open");
+            FAIL() << "unterminated string accepted";
+        } catch (const invalid_argument &e) {
+            EXPECT_EQ(string(e.what()), "Query error at column 20: unterminated string");
+        }
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, SortedPagesAndTopK) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    for (int i = 0; i < 700; ++i)
+        out << "Plant" << (i * 37) % 700 << ",Species" << i % 9 << "," << i % 13 << "," << (i % 20) / 4.0 << "\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.removePlant("Plant37");
+        controller.updatePlant("Plant74", "Species0", 20, 4.75);
+
+        // Reference: a stable sort of everything, reversed for descending
+        auto reference = [](vector<Plant> plants, const PlantPageRequest &request) {
+            auto key = [&request](const Plant &p) -> tuple<string, double> {
+                switch (request.key) {
+                case PlantSortKey::Name: return {p.getName(), 0};
+                case PlantSortKey::Species: return {p.getSpecies(), 0};
+                case PlantSortKey::Quantity: return {"", p.getQuantity()};
+                case PlantSortKey::Price: return {"", p.getPrice()};
+                case PlantSortKey::Value: return {"", p.getQuantity() * p.getPrice()};
+                }
+                return {};
+            };
+            ranges::stable_sort(plants, {}, key);
+            if (request.descending) ranges::reverse(plants);
+            vector<string> names;
+            for (size_t i = request.offset; i < plants.size() && names.size() < request.limit; ++i)
+                names.push_back(plants[i].getName());
+            return names;
+        };
+        auto names = [](const vector<Plant> &plants) {
+            vector<string> result;
+            for (const auto &plant : plants) result.push_back(plant.getName());
+            return result;
+        };
+
+        vector<shared_ptr<PlantFilter>> filters = {make_shared<MinQuantityPlantFilter>(4), make_shared<SpeciesPlantFilter>("Species2")};
+        auto all = controller.getAllPlants();
+        auto matching = controller.filterPlants(filters);
+        for (auto key : {PlantSortKey::Name, PlantSortKey::Species, PlantSortKey::Quantity, PlantSortKey::Price, PlantSortKey::Value}) {
+            for (bool descending : {false, true}) {
+                for (auto [offset, limit] : {pair<size_t, size_t>{0, 10}, {95, 30}, {690, 50}, {0, 1000}, {5, 0}}) {
+                    PlantPageRequest request{key, descending, offset, limit};
+                    EXPECT_EQ(names(controller.getPlantsPage(request)), reference(all, request))
+                        << static_cast<int>(key) << " " << descending << " " << offset;
+                    EXPECT_EQ(names(controller.getPlantsPage(request, filters)), reference(matching, request));
+                }
+            }
+        }
+
+        auto top = controller.getTopPlants(PlantSortKey::Value, 3);
+        ASSERT_EQ(top.size(), 3);
+        EXPECT_EQ(top[0].getName(), "Plant74");
+
+        // NaN sorts after every number in ascending order
+        TopKSelector selector({PlantSortKey::Price, false, 0, 3});
+        selector.offer(Plant("A", "S", 1, nan("")));
+        selector.offer(Plant("B", "S", 1, 2.0));
+        selector.offer(Plant("C", "S", 1, 1.0));
+        selector.offer(Plant("D", "S", 1, 3.0));
+        EXPECT_EQ(names(selector.takePage()), (vector<string>{"C", "B", "D"}));
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, SpeciesTotalsAndGroupBy) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Lily,Flower,8,4.5\n";
+    out << "Rose,Flower,10,2.5\n";
+    out << "Bamboo,Grass,15,20\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.setStatsCrossCheck(true); // Every read below is compared with a full group-by
+
+        GroupTotals flower = controller.getSpeciesTotals("Flower");
+        EXPECT_EQ(flower.plants, 2);
+        EXPECT_EQ(flower.quantity, 18);
+        EXPECT_DOUBLE_EQ(flower.value, 8 * 4.5 + 10 * 2.5);
+        EXPECT_DOUBLE_EQ(flower.minPrice, 2.5);
+        EXPECT_DOUBLE_EQ(flower.maxPrice, 4.5);
+        EXPECT_DOUBLE_EQ(flower.averagePrice, 3.5);
+
+        // Removing the cheapest plant moves the minimum; undo brings it back
+        controller.removePlant("Rose");
+        EXPECT_DOUBLE_EQ(controller.getSpeciesTotals("Flower").minPrice, 4.5);
+        controller.undo();
+        EXPECT_DOUBLE_EQ(controller.getSpeciesTotals("Flower").minPrice, 2.5);
+
+        // Moving a plant to another species updates both groups; empty groups disappear
+        controller.updatePlant("Bamboo", "Flower", 1, 30);
+        auto groups = controller.getSpeciesTotals();
+        ASSERT_EQ(groups.size(), 1);
+        EXPECT_EQ(groups[0].key, "Flower");
+        EXPECT_DOUBLE_EQ(groups[0].maxPrice, 30);
+        EXPECT_EQ(controller.getSpeciesTotals("Grass").plants, 0);
+        EXPECT_TRUE(isnan(controller.getSpeciesTotals("Grass").averagePrice));
+        controller.undo();
+
+        controller.beginBatch();
+        controller.addPlant("Aloe", "Succulent", 5, 15.5);
+        controller.removePlant("Lily");
+        controller.rollbackBatch();
+        EXPECT_EQ(controller.getSpeciesTotals().size(), 2);
+
+        controller.beginBatch();
+        for (int i = 0; i < 40000; ++i) controller.addPlant("Plant" + to_string(i), "Species" + to_string(i % 7), i % 11, (i % 100) / 2.0);
+        controller.commitBatch();
+        EXPECT_NO_THROW(controller.getSpeciesTotals());
+
+        // Price bands, sequential and on a pool, against a plain scan
+        auto band = [](const Plant &plant) { return to_string(static_cast<int>(plant.getPrice()) / 10 * 10) + "+"; };
+        map<string, pair<size_t, long long>> expected;
+        for (const auto &plant : controller.getAllPlants()) {
+            auto &entry = expected[band(plant)];
+            ++entry.first;
+            entry.second += plant.getQuantity();
+        }
+        auto sequential = controller.groupPlants(band);
+        controller.enableParallelScans(1);
+        for (const auto &groups : {sequential, controller.groupPlants(band)}) {
+            ASSERT_EQ(groups.size(), expected.size());
+            for (const auto &group : groups) {
+                EXPECT_EQ(group.plants, expected[group.key].first) << group.key;
+                EXPECT_EQ(group.quantity, expected[group.key].second) << group.key;
+            }
+        }
+
+        CSVPlantRepository repository(testFile);
+        WorkStealingPool pool(3);
+        auto parallel = SpeciesStats::groupBy(repository, &pool, band);
+        ASSERT_EQ(parallel.size(), sequential.size());
+        for (size_t i = 0; i < parallel.size(); ++i) {
+            EXPECT_EQ(parallel[i].key, sequential[i].key);
+            EXPECT_EQ(parallel[i].plants, sequential[i].plants);
+            EXPECT_NEAR(parallel[i].value, sequential[i].value, 1e-6);
+            EXPECT_DOUBLE_EQ(parallel[i].minPrice, sequential[i].minPrice);
+            EXPECT_DOUBLE_EQ(parallel[i].maxPrice, sequential[i].maxPrice);
+            EXPECT_NEAR(parallel[i].averagePrice, sequential[i].averagePrice, 1e-9);
+        }
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, BatchUndoHistory) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile); // Delete the file if it exists
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    {
+        auto repo = make_unique<CSVPlantRepository>(testFile);
+        PlantController controller(move(repo));
+
+        controller.addPlant("Lily", "Flower", 8, 4.5);
+        controller.undo();
+
+        // A rolled back batch leaves no undo entries and keeps the redo stack
+        controller.beginBatch();
+        controller.addPlant("Bamboo", "Grass", 15, 20.0);
+        controller.addPlant("Rose", "Flower", 10, 8.9);
+        EXPECT_THROW(controller.undo(), runtime_error);
+        controller.rollbackBatch();
+        ASSERT_EQ(controller.getAllPlants().size(), 0);
+        EXPECT_THROW(controller.undo(), runtime_error);
+        controller.redo();
+        ASSERT_EQ(controller.getAllPlants().size(), 1);
+
+        // A committed batch is persisted once and its commands can be undone
+        controller.beginBatch();
+        controller.addPlant("Bamboo", "Grass", 15, 20.0);
+        controller.addPlant("Rose", "Flower", 10, 8.9);
+        ASSERT_EQ(countLines(testFile), 2);
+        controller.commitBatch();
+        ASSERT_EQ(countLines(testFile), 4);
+        controller.undo();
+        ASSERT_FALSE(controller.getAllPlants().back().getName() == "Rose");
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, BoundedUndoHistory) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    // An update stores only the changed fields
+    {
+        const string species(40, 'S');
+        CSVPlantRepository repo(testFile);
+        Plant before("Rose with a rather long name to leave the SSO buffer", species, 3, 1.5);
+        Plant after("Rose with a rather long name to leave the SSO buffer", species, 9, 1.5);
+        repo.addPlant(before);
+        UpdatePlantCommand cmd(&repo, before, after);
+        ASSERT_EQ(cmd.changedFields(), UpdatePlantCommand::Quantity);
+        ASSERT_LT(cmd.memoryUsage(), 2 * (sizeof(Plant) + plantHeapBytes(before)));
+        cmd.execute();
+        ASSERT_EQ(repo.getPlantByName(after.getName()).getQuantity(), 9);
+        cmd.undo();
+        ASSERT_EQ(repo.getPlantByName(after.getName()).getQuantity(), 3);
+    }
+    deleteTestFiles(testFile);
+    out.open(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.setStatsCrossCheck(true);
+
+        // Consecutive updates of one plant share an entry; undo restores the first state
+        controller.addPlant("Rose", "Flower", 10, 2.0);
+        controller.updatePlant("Rose", "Flower", 7, 2.0);
+        controller.updatePlant("Rose", "Flower", 4, 2.0);
+        controller.updatePlant("Rose", "Shrub", 4, 2.5);
+        ASSERT_EQ(controller.getUndoHistoryUsage().undoEntries, 2);
+        controller.undo();
+        Plant rose = controller.getPlantByName("Rose");
+        ASSERT_EQ(rose.getSpecies(), "Flower");
+        ASSERT_EQ(rose.getQuantity(), 10);
+        ASSERT_DOUBLE_EQ(rose.getPrice(), 2.0);
+        ASSERT_EQ(controller.getSpeciesTotals("Shrub").plants, 0);
+        controller.redo();
+        rose = controller.getPlantByName("Rose");
+        ASSERT_EQ(rose.getSpecies(), "Shrub");
+        ASSERT_EQ(rose.getQuantity(), 4);
+        ASSERT_DOUBLE_EQ(rose.getPrice(), 2.5);
+
+        // Another plant in between, or coalescing turned off, keeps separate entries
+        controller.addPlant("Lily", "Flower", 1, 1.0);
+        controller.updatePlant("Rose", "Shrub", 5, 2.5);
+        controller.updatePlant("Lily", "Flower", 2, 1.0);
+        controller.updatePlant("Rose", "Shrub", 6, 2.5);
+        ASSERT_EQ(controller.getUndoHistoryUsage().undoEntries, 6);
+        UndoHistoryLimits limits;
+        limits.coalesceUpdates = false;
+        controller.setUndoHistoryLimits(limits);
+        controller.updatePlant("Rose", "Shrub", 7, 2.5);
+        ASSERT_EQ(controller.getUndoHistoryUsage().undoEntries, 7);
+        controller.undo();
+        ASSERT_EQ(controller.getPlantByName("Rose").getQuantity(), 6);
+
+        // The entry cap drops the oldest entries first
+        limits.maxEntries = 3;
+        controller.setUndoHistoryLimits(limits);
+        UndoHistoryUsage usage = controller.getUndoHistoryUsage();
+        ASSERT_EQ(usage.undoEntries, 3);
+        ASSERT_EQ(usage.redoEntries, 1);
+        for (int i = 0; i < 3; ++i) controller.undo();
+        EXPECT_THROW(controller.undo(), runtime_error);
+        ASSERT_EQ(controller.getPlantByName("Rose").getQuantity(), 4);
+        ASSERT_EQ(controller.getPlantByName("Lily").getQuantity(), 1);
+        for (int i = 0; i < 4; ++i) controller.redo();
+        ASSERT_EQ(controller.getPlantByName("Rose").getQuantity(), 7);
+
+        // The byte cap bounds the reported memory; a zero cap disables undo
+        limits.maxEntries = 1000;
+        limits.maxBytes = 600;
+        controller.setUndoHistoryLimits(limits);
+        controller.beginBatch();
+        for (int i = 0; i < 50; ++i) controller.addPlant("Plant" + to_string(i), "Herb", i, 1.0);
+        controller.commitBatch();
+        usage = controller.getUndoHistoryUsage();
+        ASSERT_LE(usage.bytes, 600u);
+        ASSERT_GT(usage.undoEntries, 0u);
+        ASSERT_LT(usage.undoEntries, 50u);
+        limits.maxBytes = 0;
+        controller.setUndoHistoryLimits(limits);
+        usage = controller.getUndoHistoryUsage();
+        ASSERT_EQ(usage.undoEntries, 0u);
+        ASSERT_EQ(usage.bytes, 0u);
+        controller.updatePlant("Rose", "Shrub", 1, 2.5);
+        EXPECT_THROW(controller.undo(), runtime_error);
+    }
+    {
+        // An entry that became the top through undo, redo, a batch or bulk edits
+        // is a finished edit; later updates never fold into it
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.addPlant("Fern", "Fern", 10, 1.0);
+        controller.updatePlant("Fern", "Fern", 12, 1.0);
+        controller.updatePlant("Rose", "Shrub", 3, 2.5);
+        controller.undo();
+        controller.updatePlant("Fern", "Fern", 15, 1.0);
+        controller.undo();
+        ASSERT_EQ(controller.getPlantByName("Fern").getQuantity(), 12);
+        controller.redo();
+        controller.updatePlant("Fern", "Fern", 16, 1.0);
+        controller.undo();
+        ASSERT_EQ(controller.getPlantByName("Fern").getQuantity(), 15);
+
+        controller.beginBatch();
+        controller.updatePlant("Fern", "Fern", 17, 1.0);
+        controller.commitBatch();
+        controller.updatePlant("Fern", "Fern", 18, 1.0);
+        controller.undo();
+        ASSERT_EQ(controller.getPlantByName("Fern").getQuantity(), 17);
+
+        controller.applyEdits({PlantEdit::update(Plant("Fern", "Fern", 19, 1.0))});
+        controller.updatePlant("Fern", "Fern", 20, 1.0);
+        controller.undo();
+        ASSERT_EQ(controller.getPlantByName("Fern").getQuantity(), 19);
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, BulkEditsAreOneUnit) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Aloe,Succulent,5,15.5\n";
+    out << "Rose,Flower,10,8.9\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.setStatsCrossCheck(true);
+
+        // A delivery: new plants, a restock and a removal, written once
+        vector<PlantEdit> delivery;
+        for (int i = 0; i < 800; ++i)
+            delivery.push_back(PlantEdit::add(Plant("Sku" + to_string(i), "Herb", i % 7, 2.5)));
+        delivery.push_back(PlantEdit::update(Plant("Aloe", "Succulent", 25, 15.5)));
+        delivery.push_back(PlantEdit::update(Plant("Sku3", "Herb", 40, 3.0))); // Added above
+        delivery.push_back(PlantEdit::remove("Rose"));
+        controller.applyEdits(delivery);
+        ASSERT_EQ(countLines(testFile), 802);
+        ASSERT_EQ(controller.getTotalUniquePlants(), 801);
+        ASSERT_EQ(controller.getPlantByName("Sku3").getQuantity(), 40);
+        ASSERT_EQ(controller.getUndoHistoryUsage().undoEntries, 1);
+
+        // One undo reverts all of it, in reverse order; redo applies it again
+        controller.undo();
+        ASSERT_EQ(countLines(testFile), 3);
+        auto all = controller.getAllPlants();
+        ASSERT_EQ(all.size(), 2);
+        ASSERT_EQ(all[0].getQuantity(), 5);
+        ASSERT_EQ(all[1].getName(), "Rose");
+        controller.redo();
+        ASSERT_EQ(controller.getTotalUniquePlants(), 801);
+        ASSERT_EQ(controller.getPlantByName("Sku3").getQuantity(), 40);
+        ASSERT_FALSE(ranges::any_of(controller.getAllPlants(), [](const Plant &p) { return p.getName() == "Rose"; }));
+
+        // A failing edit in the middle leaves nothing applied and no undo entry
+        vector<PlantEdit> repricing = {
+            PlantEdit::update(Plant("Aloe", "Succulent", 25, 9.99)),
+            PlantEdit::add(Plant("Fern", "Fern", 1, 1.0)),
+            PlantEdit::update(Plant("Missing", "Herb", 1, 1.0)),
+            PlantEdit::remove("Sku0"),
+        };
+        EXPECT_THROW(controller.applyEdits(repricing), PlantRepository::PlantNotFoundException);
+        repricing[2] = PlantEdit::update(Plant("Sku1", "Herb", -1, 1.0));
+        EXPECT_THROW(controller.applyEdits(repricing), invalid_argument);
+        ASSERT_DOUBLE_EQ(controller.getPlantByName("Aloe").getPrice(), 15.5);
+        ASSERT_EQ(controller.getTotalUniquePlants(), 801);
+        ASSERT_EQ(countLines(testFile), 802);
+        ASSERT_EQ(controller.getUndoHistoryUsage().undoEntries, 1);
+
+        // Inside an open batch the edits join it, and a failure reverts only them
+        controller.beginBatch();
+        controller.addPlant("Palm", "Tree", 2, 30.0);
+        repricing[2] = PlantEdit::add(Plant("Palm", "Tree", 1, 1.0)); // Duplicate
+        EXPECT_THROW(controller.applyEdits(repricing), PlantRepository::DuplicatePlantException);
+        ASSERT_TRUE(controller.getPlantByName("Palm").getQuantity() == 2);
+        ASSERT_DOUBLE_EQ(controller.getPlantByName("Aloe").getPrice(), 15.5);
+        controller.applyEdits({PlantEdit::remove("Palm"), PlantEdit::remove("Sku0")});
+        controller.commitBatch();
+        ASSERT_EQ(countLines(testFile), 801);
+        controller.undo();
+        ASSERT_EQ(controller.getTotalUniquePlants(), 802);
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, ConcurrentReadersAndWriterQueue) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    const int plants = 200;
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Counter,Meta,0,1\n";
+    out << "Mirror,Meta,0,1\n";
+    out << "Scratch,Meta,0,1\n";
+    for (int i = 0; i < plants; ++i) out << "Plant" << i << ",Herb,10,2.5\n";
+    out.close();
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        controller.enableConcurrentAccess();
+        const int stock = plants * 10; // Moved around, never created or lost
+
+        // Every step moves one unit between two plants and bumps Counter and
+        // Mirror to the step number, all in one bulk edit. Readers must only
+        // ever see whole steps, in order.
+        const int steps = 300;
+        atomic<bool> done{false};
+        atomic<int> failures{0};
+        auto check = [&failures](bool ok) { if (!ok) ++failures; };
+
+        vector<thread> readers;
+        for (int r = 0; r < 6; ++r) {
+            readers.emplace_back([&, r] {
+                int lastSeen = 0;
+                for (int round = 0; !done || round < 5; ++round) {
+                    // One read is one consistent state
+                    auto all = controller.getAllPlants();
+                    int counter = -1, mirror = -2, moved = 0;
+                    for (const Plant &plant : all) {
+                        if (plant.getName() == "Counter") counter = plant.getQuantity();
+                        else if (plant.getName() == "Mirror") mirror = plant.getQuantity();
+                        else if (plant.getSpecies() == "Herb") moved += plant.getQuantity();
+                    }
+                    check(counter == mirror && moved == stock && counter >= lastSeen);
+                    lastSeen = max(lastSeen, counter);
+
+                    // A later read never goes back: the statistics come from a state at
+                    // least as new as lastSeen and at most as new as the next lookup
+                    int total = controller.getTotalQuantity();
+                    int after = controller.getPlantByName("Counter").getQuantity();
+                    int step = (total - stock) / 2;
+                    check((total - stock) % 2 == 0 && step >= lastSeen && step <= after);
+                    lastSeen = after;
+
+                    // Index, query and scan paths see a whole plant set too
+                    check(controller.countBySpecies("Herb") == plants);
+                    check(controller.getPlantsByPriceRange(2.5, 2.5).size() == plants);
+                    check(controller.query("species = \"Meta\" and qty >= 0").size() == 3);
+                    check(controller.searchPlants(r % 2 ? "Mirror" : "mirror", r % 2 == 0).size() == 1);
+                }
+            });
+        }
+
+        thread writer([&] {
+            mt19937 rng(11);
+            for (int step = 1; step <= steps; ++step) {
+                string from = "Plant" + to_string(rng() % plants);
+                string to = "Plant" + to_string(rng() % plants);
+                int fromQuantity = controller.getPlantByName(from).getQuantity();
+                if (from == to || fromQuantity == 0) to = from;
+                int toQuantity = controller.getPlantByName(to).getQuantity();
+                vector<PlantEdit> edits = {
+                    PlantEdit::update(Plant("Counter", "Meta", step, 1)),
+                    PlantEdit::update(Plant(from, "Herb", fromQuantity - (from != to), 2.5)),
+                    PlantEdit::update(Plant(to, "Herb", toQuantity + (from != to), 2.5)),
+                    PlantEdit::update(Plant("Mirror", "Meta", step, 1)),
+                };
+                controller.applyEdits(edits);
+                if (step % 25 == 0) {
+                    controller.updatePlant("Scratch", "Meta", 0, 2.0);
+                    controller.undo();
+                    controller.redo();
+                }
+            }
+            done = true;
+        });
+
+        writer.join();
+        for (auto &reader : readers) reader.join();
+        ASSERT_EQ(failures.load(), 0);
+        ASSERT_EQ(controller.getPlantByName("Counter").getQuantity(), steps);
+        controller.setStatsCrossCheck(true);
+        ASSERT_EQ(controller.getTotalQuantity(), stock + 2 * steps);
+
+        // Mutations from many threads are applied one by one; errors reach their caller
+        vector<thread> writers;
+        atomic<int> duplicates{0};
+        for (int w = 0; w < 4; ++w) {
+            writers.emplace_back([&, w] {
+                for (int i = 0; i < 20; ++i) {
+                    try {
+                        controller.addPlant("New" + to_string(i), "Herb", w, 1.0);
+                    } catch (const PlantRepository::DuplicatePlantException &) {
+                        ++duplicates;
+                    }
+                }
+            });
+        }
+        for (auto &thread : writers) thread.join();
+        ASSERT_EQ(duplicates.load(), 60);
+        ASSERT_EQ(controller.getTotalUniquePlants(), plants + 3 + 20);
+        controller.disableConcurrentAccess();
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(PlantControllerTest, CopyOnWriteSnapshots) {
+    const string testFile = "test_plants.csv";
+    const string exportFiles[] = {"test_export.csv", "test_export.json", "test_export.bin"};
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out << "Aloe,Succulent,5,15.5\n";
+    out << "Rose,Flower,10,8.9\n";
+    out.close();
+
+    auto samePlants = [](const vector<Plant> &a, const vector<Plant> &b) {
+        return ranges::equal(a, b, [](const Plant &x, const Plant &y) {
+            return x.getName() == y.getName() && x.getSpecies() == y.getSpecies() &&
+                   x.getQuantity() == y.getQuantity() && x.getPrice() == y.getPrice();
+        });
+    };
+
+    {
+        PlantController controller(make_unique<CSVPlantRepository>(testFile));
+        auto first = controller.snapshot();
+        ASSERT_EQ(first->size(), 2);
+
+        // Later edits leave a held version untouched
+        controller.updatePlant("Aloe", "Succulent", 1, 1.0);
+        controller.removePlant("Rose");
+        controller.addPlant("Lily", "Flower", 8, 4.5);
+        auto firstPlants = first->getAllPlants();
+        ASSERT_EQ(firstPlants.size(), 2);
+        ASSERT_EQ(firstPlants[0].getQuantity(), 5);
+        ASSERT_EQ(firstPlants[1].getName(), "Rose");
+        auto latest = controller.snapshot();
+        ASSERT_EQ(latest->getVersion(), first->getVersion() + 3);
+        ASSERT_TRUE(samePlants(latest->getAllPlants(), controller.getAllPlants()));
+
+        // A bulk edit is published as one version; failed calls publish nothing new
+        vector<PlantEdit> edits;
+        for (int i = 0; i < 3000; ++i) edits.push_back(PlantEdit::add(Plant("Plant" + to_string(i), "Herb", i % 9, 1.5)));
+        controller.applyEdits(edits);
+        ASSERT_EQ(controller.snapshot()->getVersion(), latest->getVersion() + 1);
+        EXPECT_THROW(controller.addPlant("Lily", "Flower", 1, 1.0), PlantRepository::DuplicatePlantException);
+        ASSERT_EQ(controller.snapshot()->getVersion(), latest->getVersion() + 1);
+
+        // Removals, updates, undo and rollback keep the snapshot equal to the
+        // repository, in order, through the rebuild once most slots are empty
+        mt19937 rng(17);
+        controller.beginBatch();
+        for (int i = 0; i < 3000; ++i) {
+            string name = "Plant" + to_string(i);
+            if (rng() % 6) controller.removePlant(name);
+            else if (rng() % 2) controller.updatePlant(name, "Tree", 3, 9.5);
+        }
+        controller.commitBatch();
+        ASSERT_TRUE(samePlants(controller.snapshot()->getAllPlants(), controller.getAllPlants()));
+        controller.beginBatch();
+        controller.removePlant("Aloe");
+        controller.rollbackBatch();
+        controller.undo();
+        controller.addPlant("Fern", "Fern", 2, 3.0);
+        auto current = controller.snapshot();
+        ASSERT_TRUE(samePlants(current->getAllPlants(), controller.getAllPlants()));
+        ASSERT_EQ(current->size(), static_cast<size_t>(controller.getTotalUniquePlants()));
+
+        // Exports in every format reload as the same plants
+        for (const string &file : exportFiles) {
+            ASSERT_EQ(controller.exportSnapshot(file), current->size());
+            ASSERT_TRUE(samePlants(RepositoryConverter::open(file)->getAllPlants(), current->getAllPlants()));
+        }
+
+        // Readers iterate versions without locks while a writer keeps editing
+        controller.enableConcurrentAccess();
+        controller.applyEdits({PlantEdit::add(Plant("Counter", "Meta", 0, 1)), PlantEdit::add(Plant("Mirror", "Meta", 0, 1))});
+        atomic<bool> done{false};
+        atomic<int> failures{0};
+        vector<thread> readers;
+        for (int r = 0; r < 4; ++r) {
+            readers.emplace_back([&] {
+                uint64_t lastVersion = 0;
+                int lastCounter = 0;
+                for (int round = 0; !done || round < 5; ++round) {
+                    auto version = controller.snapshot();
+                    int counter = -1, mirror = -2;
+                    version->forEach([&](const Plant &plant) {
+                        if (plant.getName() == "Counter") counter = plant.getQuantity();
+                        if (plant.getName() == "Mirror") mirror = plant.getQuantity();
+                    });
+                    if (counter != mirror || counter < lastCounter || version->getVersion() < lastVersion) ++failures;
+                    lastCounter = counter;
+                    lastVersion = version->getVersion();
+                }
+            });
+        }
+        weak_ptr<const InventorySnapshot> early = controller.snapshot();
+        for (int step = 1; step <= 200; ++step) {
+            controller.applyEdits({PlantEdit::update(Plant("Counter", "Meta", step, 1)),
+                                   PlantEdit::update(Plant("Mirror", "Meta", step, 1))});
+        }
+        // Old versions are freed while readers keep loading new ones
+        for (int retry = 0; retry < 1000 && !early.expired(); ++retry) {
+            controller.applyEdits({PlantEdit::update(Plant("Counter", "Meta", 200, 1 + retry % 2)),
+                                   PlantEdit::update(Plant("Mirror", "Meta", 200, 1 + retry % 2))});
+        }
+        EXPECT_TRUE(early.expired());
+        done = true;
+        for (auto &reader : readers) reader.join();
+        ASSERT_EQ(failures.load(), 0);
+        controller.disableConcurrentAccess();
+    }
+    deleteTestFiles(testFile);
+    for (const string &file : exportFiles) deleteTestFiles(file);
+}
+
+TEST(CSVPlantRepositoryTest, WriteBehindPersistence) {
+    const string testFile = "test_plants.csv";
+    deleteTestFiles(testFile);
+
+    ofstream out(testFile, ios::out);
+    out << "Name,Species,Quantity,Price\n";
+    out.close();
+
+    FileRepositoryOptions writeBehind{PersistenceMode::WriteBehind};
+    {
+        CSVPlantRepository repo(testFile, writeBehind);
+
+        // Many quick mutations are coalesced into few saves
+        for (int i = 0; i < 2000; ++i) repo.addPlant(Plant("Plant" + to_string(i), "Herb", i % 7, 2.5));
+        for (int i = 0; i < 2000; i += 2) repo.updatePlant(Plant("Plant" + to_string(i), "Tree", 1, 3.0));
+        repo.flush();
+        ASSERT_EQ(countLines(testFile), 2001);
+        PersistenceStats stats = repo.persistenceStats();
+        ASSERT_EQ(stats.mutationsWritten, 3000);
+        ASSERT_EQ(stats.pendingMutations, 0);
+        ASSERT_GE(stats.fileWrites, 1);
+        ASSERT_LT(stats.fileWrites, stats.mutationsWritten);
+        ASSERT_GE(stats.maxLatencyMs, stats.lastLatencyMs);
+        ASSERT_GT(stats.meanLatencyMs, 0);
+
+        // An open batch is never saved and flush refuses to wait for it
+        repo.beginBatch();
+        for (int i = 0; i < 1000; ++i) repo.removePlant("Plant" + to_string(i));
+        ASSERT_THROW(repo.flush(), runtime_error);
+        this_thread::sleep_for(chrono::milliseconds(20));
+        ASSERT_EQ(countLines(testFile), 2001);
+        repo.commit();
+        repo.flush();
+        ASSERT_EQ(countLines(testFile), 1001);
+
+        // A rolled back batch leaves nothing to write
+        repo.beginBatch();
+        repo.removePlant("Plant1999");
+        repo.rollback();
+        ASSERT_EQ(repo.persistenceStats().pendingMutations, 0);
+
+        // A failed save is reported by the stats and by flush, and retried
+        filesystem::create_directory(testFile + ".tmp"); // The file cannot be replaced
+        repo.updatePlant(Plant("Plant1998", "Fern", 7, 9.75));
+        EXPECT_THROW(repo.flush(), runtime_error);
+        ASSERT_FALSE(repo.persistenceStats().lastSaveError.empty());
+        ASSERT_EQ(repo.persistenceStats().pendingMutations, 1);
+        filesystem::remove(testFile + ".tmp");
+        repo.flush();
+        ASSERT_TRUE(repo.persistenceStats().lastSaveError.empty());
+
+        // Destruction writes what is still pending
+        repo.updatePlant(Plant("Plant1999", "Fern", 42, 9.75));
+        repo.addPlant(Plant("Aloe", "Succulent", 5, 15.5));
+    }
+    {
+        CSVPlantRepository repo(testFile);
+        ASSERT_EQ(repo.getAllPlants().size(), 1001);
+        ASSERT_EQ(repo.getPlantByName("Plant1999").getQuantity(), 42);
+        ASSERT_TRUE(repo.exists("Aloe"));
+    }
+    {
+        // Through the controller, with the undo history and a concurrent writer
+        PlantController controller(make_unique<CSVPlantRepository>(testFile, writeBehind));
+        controller.enableConcurrentAccess();
+        controller.removePlant("Aloe");
+        controller.undo();
+        controller.updatePlant("Plant1999", "Fern", 1, 9.75);
+        controller.flush();
+        ASSERT_EQ(controller.getPersistenceStats().pendingMutations, 0);
+        ASSERT_EQ(CSVPlantRepository(testFile).getPlantByName("Plant1999").getQuantity(), 1);
+        controller.disableConcurrentAccess();
+    }
+    deleteTestFiles(testFile);
+}
+
+TEST(CSVPlantRepositoryTest, DurabilityPolicies) {
+    const string testFile = "test_plants.csv";
+    auto reset = [&] {
+        deleteTestFiles(testFile);
+        deleteTestFiles(testFile + ".wal");
+        ofstream out(testFile, ios::out);
+        out << "Name,Species,Quantity,Price\n";
+    };
+    auto options = [](PersistenceMode mode, DurabilityPolicy durability) {
+        FileRepositoryOptions result{mode};
+        result.durability = durability;
+        result.groupCommitMutations = 10;
+        result.groupCommitMs = 60'000;
+        return result;
+    };
+    auto addPlants = [](PlantRepository &repo, int first, int count) {
+        for (int i = first; i < first + count; ++i) repo.addPlant(Plant("Plant" + to_string(i), "Herb", i, 1.5));
+    };
+
+    for (PersistenceMode mode : {PersistenceMode::Rewrite, PersistenceMode::Journaled}) {
+        reset();
+        {
+            CSVPlantRepository repo(testFile, options(mode, DurabilityPolicy::None));
+            addPlants(repo, 0, 5);
+            repo.flush();
+            ASSERT_EQ(repo.persistenceStats().fileSyncs, 0);
+        }
+        reset();
+        {
+            // Every mutation and commit syncs
+            CSVPlantRepository repo(testFile, options(mode, DurabilityPolicy::Always));
+            addPlants(repo, 0, 5);
+            repo.beginBatch();
+            addPlants(repo, 5, 5);
+            repo.commit();
+            PersistenceStats stats = repo.persistenceStats();
+            ASSERT_EQ(stats.fileSyncs, 6);
+            ASSERT_EQ(stats.unsyncedMutations, 0);
+        }
+        reset();
+        {
+            // Single mutations wait for the next commit, which syncs them too
+            CSVPlantRepository repo(testFile, options(mode, DurabilityPolicy::PerBatch));
+            addPlants(repo, 0, 3);
+            ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 3);
+            repo.beginBatch();
+            addPlants(repo, 3, 4);
+            repo.commit();
+            PersistenceStats stats = repo.persistenceStats();
+            ASSERT_EQ(stats.fileSyncs, 1);
+            ASSERT_EQ(stats.unsyncedMutations, 0);
+        }
+        reset();
+        {
+            // One sync per groupCommitMutations; flush syncs the rest
+            CSVPlantRepository repo(testFile, options(mode, DurabilityPolicy::GroupCommit));
+            addPlants(repo, 0, 25);
+            PersistenceStats stats = repo.persistenceStats();
+            ASSERT_EQ(stats.fileSyncs, 2);
+            ASSERT_EQ(stats.unsyncedMutations, 5);
+            repo.flush();
+            ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 0);
+            ASSERT_EQ(repo.persistenceStats().fileSyncs, 3);
+        }
+        {
+            CSVPlantRepository repo(testFile, options(mode, DurabilityPolicy::GroupCommit));
+            ASSERT_EQ(repo.getAllPlants().size(), 25);
+        }
+    }
+
+    // The syncer thread bounds how long a mutation stays unsynced
+    reset();
+    {
+        FileRepositoryOptions groupCommit = options(PersistenceMode::Journaled, DurabilityPolicy::GroupCommit);
+        groupCommit.groupCommitMs = 5;
+        CSVPlantRepository repo(testFile, groupCommit);
+        addPlants(repo, 0, 3);
+        for (int wait = 0; wait < 400 && repo.persistenceStats().unsyncedMutations > 0; ++wait)
+            this_thread::sleep_for(chrono::milliseconds(5));
+        ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 0);
+        ASSERT_EQ(repo.persistenceStats().fileSyncs, 1);
+    }
+
+    // Write-behind saves are synced, and compactions keep everything on replay
+    reset();
+    {
+        CSVPlantRepository repo(testFile, options(PersistenceMode::WriteBehind, DurabilityPolicy::GroupCommit));
+        addPlants(repo, 0, 20);
+        repo.flush();
+        PersistenceStats stats = repo.persistenceStats();
+        ASSERT_GE(stats.fileSyncs, 1);
+        ASSERT_EQ(stats.fileSyncs, stats.fileWrites);
+        ASSERT_EQ(stats.unsyncedMutations, 0);
+    }
+    {
+        FileRepositoryOptions compacting = options(PersistenceMode::Journaled, DurabilityPolicy::GroupCommit);
+        compacting.compactAfter = 8;
+        CSVPlantRepository repo(testFile, compacting);
+        addPlants(repo, 20, 20);
+    }
+    ASSERT_EQ(CSVPlantRepository(testFile).getAllPlants().size(), 40);
+
+    // Rewrites and renames of the base file interleave with the syncer's rounds
+    reset();
+    {
+        FileRepositoryOptions groupCommit = options(PersistenceMode::Rewrite, DurabilityPolicy::GroupCommit);
+        groupCommit.groupCommitMs = 0;
+        CSVPlantRepository repo(testFile, groupCommit);
+        addPlants(repo, 0, 200);
+        repo.flush();
+        ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 0);
+    }
+    ASSERT_EQ(CSVPlantRepository(testFile).getAllPlants().size(), 200);
+    deleteTestFiles(testFile);
+    deleteTestFiles(testFile + ".wal");
+    deleteTestFiles(testFile + ".wal.compacting");
+
+    // The binary repository syncs its mapping on flush unless the policy is None
+    const string binFile = "test_plants.bin";
+    deleteTestFiles(binFile);
+    {
+        BinaryPlantRepository repo(binFile, DurabilityPolicy::None);
+        addPlants(repo, 0, 3);
+        repo.flush();
+        ASSERT_EQ(repo.persistenceStats().fileSyncs, 0);
+    }
+    deleteTestFiles(binFile);
+    {
+        BinaryPlantRepository repo(binFile, DurabilityPolicy::PerBatch);
+        addPlants(repo, 0, 3);
+        ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 3);
+        repo.beginBatch();
+        addPlants(repo, 3, 4);
+        repo.rollback();
+        ASSERT_EQ(repo.persistenceStats().unsyncedMutations, 3);
+        repo.flush();
+        PersistenceStats stats = repo.persistenceStats();
+        ASSERT_EQ(stats.fileSyncs, 1);
+        ASSERT_EQ(stats.unsyncedMutations, 0);
+    }
+    {
+        BinaryPlantRepository repo(binFile, DurabilityPolicy::Always);
+        addPlants(repo, 3, 2);
+        repo.beginBatch();
+        addPlants(repo, 5, 2);
+        repo.commit();
+        ASSERT_EQ(repo.persistenceStats().fileSyncs, 3);
+        ASSERT_EQ(repo.getAllPlants().size(), 7);
+    }
+    deleteTestFiles(binFile);
+}
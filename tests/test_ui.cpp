@@ -18,6 +18,7 @@ private slots:
     void testValidationErrors();
     void testFiltering();
     void testSearch();
+    void testQuery();
     void testStatsLabel();
     void resetApp();
 private:
@@ -198,6 +199,23 @@ void MainWindowTest::testSearch() {
     QCOMPARE(table->rowCount(), 0);
 }
 
+void MainWindowTest::testQuery() {
+    auto queryEdit = window->findChild<QLineEdit*>("queryEdit");
+    auto queryButton = window->findChild<QPushButton*>("queryButton");
+    auto table = window->findChild<QTableWidget*>("tableWidget");
+
+    QVERIFY(queryEdit && queryButton && table);
+
+    queryEdit->setText("species = \"Herb\" and qty > 0");
+    QTest::mouseClick(queryButton, Qt::LeftButton);
+    QCOMPARE(table->rowCount(), 1);
+    QCOMPARE(table->item(0, 0)->text(), "InStocky");
+
+    queryEdit->setText("name ~ \"stocky\" or price > 100");
+    QTest::mouseClick(queryButton, Qt::LeftButton);
+    QCOMPARE(table->rowCount(), 2);
+}
+
 void MainWindowTest::testStatsLabel() {
     auto statsLabel = window->findChild<QLabel*>("statsLabel");
     QVERIFY(statsLabel);
@@ -2,8 +2,10 @@
 #include "ui_mainwindow.h"
 #include "../Repository/csv_plant_repository.h"
 #include "../Repository/json_plant_repository.h"
+#include "../Repository/binary_plant_repository.h"
 
 #include <QMessageBox>
+#include <QTimer>
 #include <QString>
 #include <QHeaderView>
 #include <vector>
@@ -21,7 +23,7 @@ MainWindow::MainWindow(QWidget *parent)
 // Destructor
 MainWindow::~MainWindow() { delete centralWidget; }
 
-// Sets up the first screen where the user chooses between CSV and JSON repository
+// Sets up the first screen where the user chooses between CSV, JSON and binary repository
 void MainWindow::setupRepoSelection() {
     QWidget *selectionWidget = new QWidget(this);
     QVBoxLayout *selectLayout = new QVBoxLayout();
@@ -29,7 +31,7 @@ void MainWindow::setupRepoSelection() {
     QLabel *chooseLabel = new QLabel("Choose repository type");
     repoTypeCombo = new QComboBox();
     repoTypeCombo->setObjectName("repoTypeCombo");
-    repoTypeCombo->addItems({"CSV", "JSON"});
+    repoTypeCombo->addItems({"CSV", "JSON", "Binary"});
     startButton = new QPushButton("Start");
     startButton->setObjectName("startButton");
 
@@ -46,14 +48,18 @@ void MainWindow::setupRepoSelection() {
 // Initializes the controller based on user repo selection and shows main UI
 void MainWindow::startApp() {
     QString repoType = repoTypeCombo->currentText();
+    // Text files are rewritten in the background, so edits never wait for the disk
+    FileRepositoryOptions writeBehind{PersistenceMode::WriteBehind};
     if (repoType == "CSV") {
-        controller = make_unique<PlantController>(make_unique<CSVPlantRepository>("plants.csv"));
+        controller = make_unique<PlantController>(make_unique<CSVPlantRepository>("plants.csv", writeBehind));
+    } else if (repoType == "JSON") {
+        controller = make_unique<PlantController>(make_unique<JSONPlantRepository>("plants.json", writeBehind));
     } else {
-        controller = make_unique<PlantController>(make_unique<JSONPlantRepository>("plants.json"));
+        controller = make_unique<PlantController>(make_unique<BinaryPlantRepository>("plants.bin"));
     }
     appStarted = true;
     setupUI();
-    loadTable(controller->getAllPlants());
+    loadAllPlants();
 }
 
 // Sets up the main application interface
@@ -122,9 +128,8 @@ void MainWindow::setupUI() {
     speciesFilterCombo->addItem("All");
 
     // Populate with unique species from current data
-    for (const auto& p : controller->getAllPlants())
-        if (speciesFilterCombo->findText(QString::fromStdString(p.getSpecies())) == -1)
-            speciesFilterCombo->addItem(QString::fromStdString(p.getSpecies()));
+    for (const auto &species : controller->getSpecies())
+        speciesFilterCombo->addItem(QString::fromStdString(species));
     filterLayout->addWidget(new QLabel("Species:"));
     filterLayout->addWidget(speciesFilterCombo);
 
@@ -144,6 +149,18 @@ void MainWindow::setupUI() {
     searchLayout->addWidget(searchEdit);
     mainLayout->addLayout(searchLayout);
 
+    // Query area
+    QHBoxLayout *queryLayout = new QHBoxLayout();
+    queryEdit = new QLineEdit();
+    queryEdit->setObjectName("queryEdit");
+    queryEdit->setPlaceholderText("species = \"Succulent\" and price < 20 or name ~ \"aloe\"");
+    queryButton = new QPushButton("Query");
+    queryButton->setObjectName("queryButton");
+    queryLayout->addWidget(new QLabel("Query:"));
+    queryLayout->addWidget(queryEdit);
+    queryLayout->addWidget(queryButton);
+    mainLayout->addLayout(queryLayout);
+
     // Status message label
     statusLabel = new QLabel();
     statusLabel->setObjectName("statusLabel");
@@ -175,25 +192,42 @@ void MainWindow::setupUI() {
     connect(redoButton, &QPushButton::clicked, this, &MainWindow::onRedo);
     connect(filterButton, &QPushButton::clicked, this, &MainWindow::onFilter);
     connect(clearFilterButton, &QPushButton::clicked, this, &MainWindow::onClearFilter);
+    connect(queryButton, &QPushButton::clicked, this, &MainWindow::onQuery);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &MainWindow::onQuery);
+    // Quick search ignores case and is answered from the controller's substring index
     connect(searchEdit, &QLineEdit::textChanged, [this](const QString &text) {
-        loadTable(controller->searchPlants(text.toStdString()));
+        loadTable(controller->searchPlants(text.toStdString(), true));
     });
 
     centralWidget->setLayout(mainLayout);
+
+    // Edits are saved in the background; keep the user informed about it
+    auto saveStatusTimer = new QTimer(this);
+    connect(saveStatusTimer, &QTimer::timeout, this, &MainWindow::updateSaveStatus);
+    saveStatusTimer->start(500);
 }
 
 
 // Populates the table with plant data
 void MainWindow::loadTable(const vector<Plant> &plants) {
     tableWidget->setRowCount(0);
-    for (const auto &p : plants) {
-        int row = tableWidget->rowCount();
-        tableWidget->insertRow(row);
-        tableWidget->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(p.getName())));
-        tableWidget->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(p.getSpecies())));
-        tableWidget->setItem(row, 2, new QTableWidgetItem(QString::number(p.getQuantity())));
-        tableWidget->setItem(row, 3, new QTableWidgetItem(QString::number(p.getPrice(), 'f', 2)));
-    }
+    for (const auto &p : plants) addTableRow(p);
+}
+
+// Populates the table with every plant, visiting them in place instead of copying
+void MainWindow::loadAllPlants() {
+    tableWidget->setRowCount(0);
+    controller->forEachPlant([this](const Plant &p) { addTableRow(p); });
+}
+
+// Appends one plant as a table row
+void MainWindow::addTableRow(const Plant &p) {
+    int row = tableWidget->rowCount();
+    tableWidget->insertRow(row);
+    tableWidget->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(p.getName())));
+    tableWidget->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(p.getSpecies())));
+    tableWidget->setItem(row, 2, new QTableWidgetItem(QString::number(p.getQuantity())));
+    tableWidget->setItem(row, 3, new QTableWidgetItem(QString::number(p.getPrice(), 'f', 2)));
 }
 
 // Clears all input fields in the form
@@ -204,6 +238,25 @@ void MainWindow::clearInputs() {
     priceEdit->clear();
 }
 
+// Waits for the background save; if it fails the user may keep the window open and retry
+void MainWindow::closeEvent(QCloseEvent *event) {
+    if (controller) {
+        try {
+            controller->flush();
+        } catch (const exception &e) {
+            auto answer = QMessageBox::critical(
+                this, "Save failed",
+                QString("Your changes could not be saved:\n%1\n\nClose anyway and lose them?").arg(e.what()),
+                QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+            if (answer == QMessageBox::No) {
+                event->ignore();
+                return;
+            }
+        }
+    }
+    event->accept();
+}
+
 // Displays an error dialog with the given message
 void MainWindow::showError(const QString &msg) {
     QMessageBox::warning(this, "Error", msg);
@@ -217,7 +270,7 @@ void MainWindow::onAdd() {
             speciesEdit->text().toStdString(),
             quantityEdit->text().toInt(),
             priceEdit->text().toDouble());
-        loadTable(controller->getAllPlants());
+        loadAllPlants();
         clearInputs();
         updateSpeciesCombo();
         updateStats();
@@ -232,7 +285,7 @@ void MainWindow::onUpdate() {
             speciesEdit->text().toStdString(),
             quantityEdit->text().toInt(),
             priceEdit->text().toDouble());
-        loadTable(controller->getAllPlants());
+        loadAllPlants();
         clearInputs();
         updateSpeciesCombo();
         updateStats();
@@ -243,7 +296,7 @@ void MainWindow::onUpdate() {
 void MainWindow::onRemove() {
     try {
         controller->removePlant(nameEdit->text().toStdString());
-        loadTable(controller->getAllPlants());
+        loadAllPlants();
         clearInputs();
         updateSpeciesCombo();
         updateStats();
@@ -254,7 +307,7 @@ void MainWindow::onRemove() {
 void MainWindow::onUndo() {
     try {
         controller->undo();
-        loadTable(controller->getAllPlants());
+        loadAllPlants();
     } catch (const exception &e) { showError(e.what()); }
 }
 
@@ -262,7 +315,7 @@ void MainWindow::onUndo() {
 void MainWindow::onRedo() {
     try {
         controller->redo();
-        loadTable(controller->getAllPlants());
+        loadAllPlants();
     } catch (const exception &e) { showError(e.what()); }
 }
 
@@ -294,7 +347,19 @@ void MainWindow::onFilter() {
 void MainWindow::onClearFilter() {
     filterCombo->setCurrentIndex(0);
     speciesFilterCombo->setCurrentIndex(0);
-    loadTable(controller->getAllPlants());
+    loadAllPlants();
+}
+
+// Slot for Query button; an empty query shows all plants
+void MainWindow::onQuery() {
+    string text = queryEdit->text().trimmed().toStdString();
+    if (text.empty()) {
+        loadAllPlants();
+        return;
+    }
+    try {
+        loadTable(controller->query(text));
+    } catch (const exception &e) { showError(e.what()); }
 }
 
 // Updates the species combo box with all unique species from the repository
@@ -305,11 +370,9 @@ void MainWindow::updateSpeciesCombo() {
     speciesFilterCombo->clear();
     speciesFilterCombo->addItem("All");
 
-    set<QString> uniqueSpecies;
-    for (const auto &p : controller->getAllPlants())
-        uniqueSpecies.insert(QString::fromStdString(p.getSpecies()));
-    for (const auto &s : uniqueSpecies)
-        speciesFilterCombo->addItem(s);
+    // The species index lists each species once, already sorted
+    for (const auto &species : controller->getSpecies())
+        speciesFilterCombo->addItem(QString::fromStdString(species));
 
     // Restore selection if possible
     int idx = speciesFilterCombo->findText(current);
@@ -328,3 +391,23 @@ void MainWindow::updateStats() {
     QString("Unique plants: %1 | Total quantity: %2 | Total value: %3 RON")
         .arg(totalPlants).arg(totalQty).arg(totalVal, 0, 'f', 2));
 }
+
+// Shows a failed save in red until a later save succeeds, and pending changes
+// while the background writer catches up
+void MainWindow::updateSaveStatus() {
+    PersistenceStats stats = controller->getPersistenceStats();
+    bool failed = !stats.lastSaveError.empty();
+    // Keep the welcome message until there is something to report
+    if (!failed && stats.pendingMutations == 0 && !saveStatusShown) return;
+    saveStatusShown = true;
+
+    statusLabel->setStyleSheet(failed
+        ? "color: #a12020; font-size: 16px; font-weight: bold; background: #fde2e2; border-radius: 8px; padding: 4px 12px;"
+        : "color: #227a45; font-size: 16px; font-weight: bold; background: #e3fbe0; border-radius: 8px; padding: 4px 12px;");
+    if (failed)
+        statusLabel->setText(QString("⚠ Changes are not being saved: %1").arg(QString::fromStdString(stats.lastSaveError)));
+    else if (stats.pendingMutations > 0)
+        statusLabel->setText(QString("💾 Saving %1 change(s)...").arg(static_cast<qulonglong>(stats.pendingMutations)));
+    else
+        statusLabel->setText("✔ All changes saved");
+}
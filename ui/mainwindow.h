@@ -10,6 +10,7 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QCloseEvent>
 
 #include "../Controller/plant_controller.h"
 
@@ -20,7 +21,7 @@ class MainWindow : public QMainWindow {
 public:
     explicit MainWindow(QWidget *parent = nullptr); // Constructor
     ~MainWindow(); // Destructor
-    void setupRepoSelection(); // Sets up the repository selection screen (CSV/JSON)
+    void setupRepoSelection(); // Sets up the repository selection screen (CSV/JSON/Binary)
     void startApp(); // Called after repo type is chosen to start the main application UI
 
 private:
@@ -28,10 +29,11 @@ private:
     QTableWidget *tableWidget;  // Displays the plant list in a table
     QLineEdit *nameEdit, *speciesEdit, *quantityEdit, *priceEdit; // Text fields for plant name, species, quantity & price
     QLineEdit *searchEdit; // Text field for quick search
+    QLineEdit *queryEdit; // Text field for queries such as: species = "Fern" and qty >= 5
 
     QComboBox *filterCombo; // Dropdown for stock status filter
     QComboBox *speciesFilterCombo; // Dropdown for species filter
-    QComboBox *repoTypeCombo;  // Dropdown to select repository type (CSV/JSON)
+    QComboBox *repoTypeCombo;  // Dropdown to select repository type (CSV/JSON/Binary)
 
     QPushButton *addButton; // Add a new plant
     QPushButton *updateButton; // Update the selected plant
@@ -40,19 +42,26 @@ private:
     QPushButton *redoButton; // Redo last undone operation
     QPushButton *filterButton;  // Apply filters
     QPushButton *clearFilterButton; // Clear all filters
+    QPushButton *queryButton; // Run the query
     QPushButton *startButton; // Start application after repo selection
 
     QLabel *statusLabel, *statsLabel; // Label for general status messages & for displaying statistics
 
     bool appStarted = false;
+    bool saveStatusShown = false; // The status label shows the background save state
 
     std::unique_ptr<PlantController> controller;
 
     void setupUI(); // Internal helper to set up the main UI widgets and layout
     void loadTable(const std::vector<Plant>& plants); // Populates the table with the provided list of plants
+    void loadAllPlants(); // Populates the table with all plants of the controller
+    void addTableRow(const Plant &p); // Appends one plant to the table
     void clearInputs(); // Clears all input fields
     void showError(const QString &msg); // Shows an error message dialog
 
+protected:
+    void closeEvent(QCloseEvent *event) override; // Writes pending changes before the window closes
+
 private slots:
     void onAdd();
     void onUpdate();
@@ -62,6 +71,8 @@ private slots:
     void onTableSelect();
     void onFilter();
     void onClearFilter();
+    void onQuery();
     void updateSpeciesCombo();
     void updateStats();
+    void updateSaveStatus(); // Shows pending or failed background saves in the status label
 };